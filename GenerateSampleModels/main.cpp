@@ -1,6 +1,7 @@
 #include <iostream>
 #include "HoloVizioModel.h"
 #include "MultiViewModel.h"
+#include "SceneModel.h"
 #include "geometry.h"
 
 
@@ -12,6 +13,8 @@ void GenerateDefaultHoloVizioModel()
 	HoloVizioModel holovizioModel;
 	holovizioModel.name = "MyHoloVizio";
 	holovizioModel.num_projectors = 21;
+	holovizioModel.num_projectors_x = 21;
+	holovizioModel.num_projectors_y = 1;
 	holovizioModel.image_size_x = 1000;
 	holovizioModel.image_size_y = 600;
 	//holovizioModel.angular_scattering = 0.1f;
@@ -55,6 +58,8 @@ void GenerateDefaultMultiViewModel()
 	MultiViewModel multiviewModel;
 	multiviewModel.name = "MyMultiView";
 	multiviewModel.num_cameras = 21;
+	multiviewModel.num_cameras_x = 21;
+	multiviewModel.num_cameras_y = 1;
 	multiviewModel.image_size_x = 1000;
 	multiviewModel.image_size_y = 600;
 	multiviewModel.screen_size_x = 1000.0f;
@@ -81,6 +86,114 @@ void GenerateDefaultMultiViewModel()
 }
 
 
+void GenerateDefaultMultiViewGridModel()
+{
+	MultiViewModel multiviewModel;
+	multiviewModel.name = "MyMultiViewGrid";
+	multiviewModel.num_cameras_x = 21;
+	multiviewModel.num_cameras_y = 5;
+	multiviewModel.num_cameras = multiviewModel.num_cameras_x * multiviewModel.num_cameras_y;
+	multiviewModel.image_size_x = 1000;
+	multiviewModel.image_size_y = 600;
+	multiviewModel.screen_size_x = 1000.0f;
+	multiviewModel.screen_size_y = 600.0f;
+	multiviewModel.cameras_pos_x.resize( multiviewModel.num_cameras );
+	multiviewModel.cameras_pos_y.resize( multiviewModel.num_cameras );
+	multiviewModel.cameras_pos_z.resize( multiviewModel.num_cameras );
+	{
+		// Generate uniformly distributed grid of views (full parallax), row by row.
+		const int numViewsX = multiviewModel.num_cameras_x;
+		const int numViewsY = multiviewModel.num_cameras_y;
+		const float viewMinX = -2000.0f;
+		const float viewMaxX = 2000.0f;
+		const float viewMinY = -500.0f;
+		const float viewMaxY = 500.0f;
+		const float viewZ = observerDist;
+		for ( int viewIdY = 0; viewIdY < numViewsY; ++viewIdY )
+		{
+			const float ratioY = static_cast<float>(viewIdY) / static_cast<float>(numViewsY-1);
+			for ( int viewIdX = 0; viewIdX < numViewsX; ++viewIdX )
+			{
+				const float ratioX = static_cast<float>(viewIdX) / static_cast<float>(numViewsX-1);
+				const int viewId = viewIdX + viewIdY*numViewsX;
+				multiviewModel.cameras_pos_x.at( viewId ) = viewMinX + ratioX*(viewMaxX-viewMinX);
+				multiviewModel.cameras_pos_y.at( viewId ) = viewMinY + ratioY*(viewMaxY-viewMinY);
+				multiviewModel.cameras_pos_z.at( viewId ) = viewZ;
+			}
+		}
+	}
+	multiviewModel.Serialize( "../../data/sample_multiviewmodel_grid.json" );
+}
+
+
+
+void GenerateDefaultScene()
+{
+	// Same scene, as the fallback one in RenderingNaive.
+	SceneModel sceneModel;
+	sceneModel.name = "MyScene";
+	sceneModel.materials.resize( 6 );
+	sceneModel.materials[0].name = "ivory";
+	sceneModel.materials[0].refractive_index = 1.0f;
+	sceneModel.materials[0].albedo = Vec4f( 0.6f, 0.3f, 0.1f, 0.0f );
+	sceneModel.materials[0].diffuse_color = Vec3f( 0.4f, 0.4f, 0.3f );
+	sceneModel.materials[0].specular_exponent = 50.0f;
+	sceneModel.materials[1].name = "glass";
+	sceneModel.materials[1].refractive_index = 1.5f;
+	sceneModel.materials[1].albedo = Vec4f( 0.0f, 0.5f, 0.1f, 0.8f );
+	sceneModel.materials[1].diffuse_color = Vec3f( 0.6f, 0.7f, 0.8f );
+	sceneModel.materials[1].specular_exponent = 125.0f;
+	sceneModel.materials[2].name = "red_rubber";
+	sceneModel.materials[2].refractive_index = 1.0f;
+	sceneModel.materials[2].albedo = Vec4f( 0.9f, 0.1f, 0.0f, 0.0f );
+	sceneModel.materials[2].diffuse_color = Vec3f( 0.3f, 0.1f, 0.1f );
+	sceneModel.materials[2].specular_exponent = 10.0f;
+	sceneModel.materials[3].name = "mirror";
+	sceneModel.materials[3].refractive_index = 1.0f;
+	sceneModel.materials[3].albedo = Vec4f( 0.0f, 10.0f, 0.8f, 0.0f );
+	sceneModel.materials[3].diffuse_color = Vec3f( 1.0f, 1.0f, 1.0f );
+	sceneModel.materials[3].specular_exponent = 1425.0f;
+	sceneModel.materials[4].name = "checker_light";
+	sceneModel.materials[4].diffuse_color = Vec3f( 0.3f, 0.3f, 0.3f );
+	sceneModel.materials[5].name = "checker_dark";
+	sceneModel.materials[5].diffuse_color = Vec3f( 0.3f, 0.2f, 0.1f );
+
+	const Vec3f spheresCenter[] = { Vec3f( -180.0f, -80.0f, -40.0f ), Vec3f( -100.0f, -100.0f, 120.0f ), Vec3f( 0.0f, -60.0f, -120.0f ), Vec3f( 300.0f, 120.0f, -200.0f ) };
+	const float spheresRadius[] = { 80.0f, 80.0f, 120.0f, 160.0f };
+	sceneModel.spheres.resize( 4 );
+	for ( int sphereId = 0; sphereId < 4; ++sphereId )
+	{
+		sceneModel.spheres[sphereId].center = spheresCenter[sphereId];
+		sceneModel.spheres[sphereId].radius = spheresRadius[sphereId];
+		sceneModel.spheres[sphereId].material_id = sphereId;
+	}
+	// Red rubber sphere rolls back and forth, for animations; still images show it in place.
+	sceneModel.spheres[2].keyframes.resize( 3 );
+	sceneModel.spheres[2].keyframes[1].frame = 12;
+	sceneModel.spheres[2].keyframes[1].offset = Vec3f( 0.0f, 0.0f, -300.0f );
+	sceneModel.spheres[2].keyframes[2].frame = 24;
+
+	// Checkerboard floor; offsets keep cell indices positive, except the row of cells across z = 0, which is twice as wide.
+	sceneModel.quads.resize( 1 );
+	sceneModel.quads[0].center = Vec3f( 0.0f, -200.0f, 0.0f );
+	sceneModel.quads[0].half_size = Vec2f( 1000.0f, 1000.0f );
+	sceneModel.quads[0].material_id = 4;
+	sceneModel.quads[0].checker_material_id = 5;
+	sceneModel.quads[0].checker_cell_size = 200.0f;
+	sceneModel.quads[0].checker_offset = Vec2f( 1000.0f, 0.0f );
+
+	const Vec3f lightsPosition[] = { Vec3f( -1000.0f, 1000.0f, 1000.0f ), Vec3f( 1500.0f, 2500.0f, -1200.0f ), Vec3f( 1500.0f, 1000.0f, 1500.0f ) };
+	const float lightsIntensity[] = { 1.5f, 1.8f, 1.7f };
+	sceneModel.lights.resize( 3 );
+	for ( int lightId = 0; lightId < 3; ++lightId )
+	{
+		sceneModel.lights[lightId].position = lightsPosition[lightId];
+		sceneModel.lights[lightId].intensity = lightsIntensity[lightId];
+	}
+	sceneModel.Serialize( "../../data/sample_scene.json" );
+}
+
+
 
 int main( int argc, char** argv )
 {
@@ -90,6 +203,10 @@ int main( int argc, char** argv )
 
 	GenerateDefaultMultiViewModel();
 
+	GenerateDefaultMultiViewGridModel();
+
+	GenerateDefaultScene();
+
 	std::cout << "Program ended..." << std::endl;
 	return 0;
 }
\ No newline at end of file
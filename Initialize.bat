@@ -3,6 +3,15 @@ mkdir output
 cd output
 mkdir rt_holovizio
 mkdir rt_multiview
+mkdir rt_holovizio_samples
+mkdir rt_multiview_samples
+mkdir rt_holovizio_frames
+mkdir rt_multiview_frames
+mkdir rt_holovizio_work
+mkdir rt_multiview_work
+mkdir rt_dense_work
 mkdir interp_holovizio
 mkdir interp_multiview
-mkdir perceived
\ No newline at end of file
+mkdir perceived
+mkdir optimized_holovizio
+mkdir perceived_optimized
\ No newline at end of file
@@ -19,6 +19,7 @@
 
 const int num_projectors_contributes_halved = 4;
 const float weight_epsilon = 0.0001f;
+const float pi = 3.14159265358979f;
 
 const float gaussian_half_decay = 1.11741f;
 const float gaussian_half_decay_sqr = gaussian_half_decay*gaussian_half_decay;
@@ -64,18 +65,14 @@ bool LightFieldInterpolation::Convert_MultiView_to_HoloVizio( const Image3D& mul
 {
 	const int num_cameras = multiViewModel.num_cameras;
 	const int num_projectors = holoVizioModel.num_projectors;
-	const int width = multiViewModel.image_size_x;
-	const int height = multiViewModel.image_size_y;
+	const int width = holoVizioModel.image_size_x;
+	const int height = holoVizioModel.image_size_y;
 
 	if ( num_cameras == 0 || num_projectors == 0 )
 		return false;
 	if ( width == 0 || height == 0 )
 		return false;
-	if ( holoVizioModel.image_size_x != width || holoVizioModel.image_size_y != height )
-		return false;
-	if ( holoVizioModel.screen_size_x != multiViewModel.screen_size_x || holoVizioModel.screen_size_y != multiViewModel.screen_size_y )
-		return false;
-	if ( multiViewImage.Width() != width || multiViewImage.Height() != height || multiViewImage.Depth() != num_cameras )
+	if ( multiViewImage.Width() != multiViewModel.image_size_x || multiViewImage.Height() != multiViewModel.image_size_y || multiViewImage.Depth() != num_cameras )
 		return false;
 
 	bool success = true;
@@ -96,19 +93,12 @@ bool LightFieldInterpolation::Convert_HoloVizio_to_MultiView( const Image3D& hol
 	const int num_projectors = holoVizioModel.num_projectors;
 	const int width = multiViewModel.image_size_x;
 	const int height = multiViewModel.image_size_y;
-	const Vec2f screenSize( multiViewModel.screen_size_x, multiViewModel.screen_size_y );
-	const Vec2f screenStart = -screenSize * 0.5f;
-	const float observerDistance = holoVizioModel.observer_distance;
 
 	if ( num_cameras == 0 || num_projectors == 0 )
 		return false;
 	if ( width == 0 || height == 0 )
 		return false;
-	if ( holoVizioModel.image_size_x != width || holoVizioModel.image_size_y != height )
-		return false;
-	if ( holoVizioModel.screen_size_x != screenSize.x || holoVizioModel.screen_size_y != screenSize.y )
-		return false;
-	if ( holoVizioImage.Width() != width || holoVizioImage.Height() != height || holoVizioImage.Depth() != num_projectors )
+	if ( holoVizioImage.Width() != holoVizioModel.image_size_x || holoVizioImage.Height() != holoVizioModel.image_size_y || holoVizioImage.Depth() != num_projectors )
 		return false;
 
 	bool success = true;
@@ -123,40 +113,82 @@ bool LightFieldInterpolation::Convert_HoloVizio_to_MultiView( const Image3D& hol
 
 
 
+bool LightFieldInterpolation::Convert_MultiView_to_MultiView( const Image3D& multiViewImage, const MultiViewModel& targetModel, Image3D& targetImage )
+{
+	const int num_cameras = multiViewModel.num_cameras;
+	const int num_target_cameras = targetModel.num_cameras;
+	const int width = targetModel.image_size_x;
+	const int height = targetModel.image_size_y;
+
+	if ( num_cameras == 0 || num_target_cameras == 0 )
+		return false;
+	if ( width == 0 || height == 0 )
+		return false;
+	if ( multiViewImage.Width() != multiViewModel.image_size_x || multiViewImage.Height() != multiViewModel.image_size_y || multiViewImage.Depth() != num_cameras )
+		return false;
+
+	bool success = true;
+	targetImage.Resize( width, height, num_target_cameras );
+	for ( int cameraId = 0; cameraId < num_target_cameras; ++cameraId )
+	{
+		const Vec3f cameraPos( targetModel.cameras_pos_x[cameraId], targetModel.cameras_pos_y[cameraId], targetModel.cameras_pos_z[cameraId] );
+		success = success && Interpolate_MultiView_to_Camera( multiViewImage, targetModel, targetImage.Layer(cameraId), cameraPos );
+	}
+	return success;
+}
+
+
+
 bool LightFieldInterpolation::Interpolate_MultiView_to_Projector( const Image3D& multiViewImage, Image2D& projectorImage, const Vec3f& projectorPos )
+{
+	const Vec2f screenSize( holoVizioModel.screen_size_x, holoVizioModel.screen_size_y );
+	return InterpolateMultiView( multiViewImage, holoVizioModel.image_size_x, holoVizioModel.image_size_y, screenSize, projectorPos, projectorImage );
+}
+
+
+
+bool LightFieldInterpolation::Interpolate_MultiView_to_Camera( const Image3D& multiViewImage, const MultiViewModel& cameraModel, Image2D& cameraImage, const Vec3f& cameraPos )
+{
+	const Vec2f screenSize( cameraModel.screen_size_x, cameraModel.screen_size_y );
+	return InterpolateMultiView( multiViewImage, cameraModel.image_size_x, cameraModel.image_size_y, screenSize, cameraPos, cameraImage );
+}
+
+
+
+bool LightFieldInterpolation::InterpolateMultiView( const Image3D& multiViewImage, const int width, const int height, const Vec2f& screenSize, const Vec3f& viewPos, Image2D& viewImage )
 {
 	const int num_cameras = multiViewModel.num_cameras;
-	const int width = multiViewModel.image_size_x;
-	const int height = multiViewModel.image_size_y;
-	const Vec2f screenSize( multiViewModel.screen_size_x, multiViewModel.screen_size_y );
+	const int num_cameras_x = multiViewModel.NumCamerasX();
+	const int num_cameras_y = multiViewModel.NumCamerasY();
+	// View image is resampled from camera images, if resolutions or screen sizes differ.
 	const Vec2f screenStart = -screenSize * 0.5f;
 
-	if ( num_cameras == 0 )
+	if ( num_cameras == 0 || num_cameras_x*num_cameras_y != num_cameras )
 		return false;
 	if ( width == 0 || height == 0 )
 		return false;
-	if ( multiViewImage.Width() != width || multiViewImage.Height() != height || multiViewImage.Depth() != num_cameras )
+	if ( multiViewImage.Width() != multiViewModel.image_size_x || multiViewImage.Height() != multiViewModel.image_size_y || multiViewImage.Depth() != num_cameras )
+		return false;
+	if ( multiViewModel.image_size_x == 0 || multiViewModel.image_size_y == 0 )
 		return false;
 
-	projectorImage.Resize( width, height );
-
+	// Interpolated camera column (row) index depends only on the screen column (row), so taps are precomputed.
+	std::vector<ViewTaps> columnTaps( width );
 	for ( int x = 0; x < width; ++x )
 	{
-		for ( int y = 0; y < height; ++y )
-		{
-			const Vec3f screenPos = Vec3f(
-				screenStart.x + screenSize.x*(static_cast<float>(x) + 0.5f) / width,
-				screenStart.y + screenSize.y*(static_cast<float>(y) + 0.5f) / height,
-				0.0f );
-			const float interpolatedCameraIndex = InterpolatedCameraIndex( screenPos, projectorPos );
-			const int leftCameraId = std::min<int>(std::max<int>( static_cast<int>(interpolatedCameraIndex), 0 ), num_cameras-2 );
-			const float weight = std::min<float>(std::max<float>( interpolatedCameraIndex - static_cast<float>(leftCameraId), 0.0f), 1.0f );
-			const Vec3f leftCameraValue = multiViewImage.at(x,y,leftCameraId+0);
-			const Vec3f rightCameraValue = multiViewImage.at(x,y,leftCameraId+1);
-			const Vec3f interpolatedValue = leftCameraValue*(1.0f-weight) + rightCameraValue*weight;
-			projectorImage.at(x,y) = interpolatedValue;
-		}
+		const Vec3f screenPos = Vec3f( screenStart.x + screenSize.x*(static_cast<float>(x) + 0.5f) / width, 0.0f, 0.0f );
+		ComputeViewTaps( angularKernel, InterpolatedCameraIndex( screenPos, viewPos, 0 ), num_cameras_x, columnTaps[x] );
 	}
+	std::vector<ViewTaps> rowTaps( height );
+	for ( int y = 0; y < height; ++y )
+	{
+		const Vec3f screenPos = Vec3f( 0.0f, screenStart.y + screenSize.y*(static_cast<float>(height-y-1) + 0.5f) / height, 0.0f );
+		ComputeViewTaps( angularKernel, InterpolatedCameraIndex( screenPos, viewPos, 1 ), num_cameras_y, rowTaps[y] );
+	}
+	ResampleTaps columnResampleTaps, rowResampleTaps;
+	ComputeResampleTaps( spatialFilter, width, screenSize.x, multiViewModel.image_size_x, multiViewModel.screen_size_x, columnResampleTaps );
+	ComputeResampleTaps( spatialFilter, height, screenSize.y, multiViewModel.image_size_y, multiViewModel.screen_size_y, rowResampleTaps );
+	InterpolateViews( multiViewImage, num_cameras_x, columnTaps, rowTaps, columnResampleTaps, rowResampleTaps, viewImage );
 	return true;
 }
 
@@ -165,38 +197,40 @@ bool LightFieldInterpolation::Interpolate_MultiView_to_Projector( const Image3D&
 bool LightFieldInterpolation::Interpolate_HoloVizio_to_Camera( const Image3D& holoVizioImage, Image2D& cameraImage, const Vec3f& cameraPos )
 {
 	const int num_projectors = holoVizioModel.num_projectors;
-	const int width = holoVizioModel.image_size_x;
-	const int height = holoVizioModel.image_size_y;
-	const Vec2f screenSize( holoVizioModel.screen_size_x, holoVizioModel.screen_size_y );
+	const int num_projectors_x = holoVizioModel.NumProjectorsX();
+	const int num_projectors_y = holoVizioModel.NumProjectorsY();
+	// Camera image is resampled from projector images, if resolutions or screen sizes differ.
+	const int width = multiViewModel.image_size_x;
+	const int height = multiViewModel.image_size_y;
+	const Vec2f screenSize( multiViewModel.screen_size_x, multiViewModel.screen_size_y );
 	const Vec2f screenStart = -screenSize * 0.5f;
 
-	if ( num_projectors == 0 )
+	if ( num_projectors == 0 || num_projectors_x*num_projectors_y != num_projectors )
 		return false;
 	if ( width == 0 || height == 0 )
 		return false;
-	if ( holoVizioImage.Width() != width || holoVizioImage.Height() != height || holoVizioImage.Depth() != num_projectors )
+	if ( holoVizioImage.Width() != holoVizioModel.image_size_x || holoVizioImage.Height() != holoVizioModel.image_size_y || holoVizioImage.Depth() != num_projectors )
+		return false;
+	if ( holoVizioModel.image_size_x == 0 || holoVizioModel.image_size_y == 0 )
 		return false;
 
-	cameraImage.Resize( width, height );
-
+	// Interpolated projector column (row) index depends only on the screen column (row), so taps are precomputed.
+	std::vector<ViewTaps> columnTaps( width );
 	for ( int x = 0; x < width; ++x )
 	{
-		for ( int y = 0; y < height; ++y )
-		{
-			const Vec3f screenPos = Vec3f(
-				screenStart.x + screenSize.x*(static_cast<float>(x) + 0.5f) / width,
-				screenStart.y + screenSize.y*(static_cast<float>(y) + 0.5f) / height,
-				0.0f );
-			const float interpolatedProjectorIndex = InterpolatedProjectorIndex( screenPos, cameraPos );
-			const int leftProjId = std::min<int>(std::max<int>( static_cast<int>(interpolatedProjectorIndex), 0 ), num_projectors-2 );
-			const float weight = std::min<float>(std::max<float>( interpolatedProjectorIndex - static_cast<float>(leftProjId), 0.0f), 1.0f );
-			const Vec3f leftProjValue = holoVizioImage.at(x,y,leftProjId+0);
-			const Vec3f rightProjValue = holoVizioImage.at(x,y,leftProjId+1);
-			const Vec3f interpolatedValue = leftProjValue*(1.0f-weight) + rightProjValue*weight;
-			cameraImage.at(x,y) = interpolatedValue;
-		}
+		const Vec3f screenPos = Vec3f( screenStart.x + screenSize.x*(static_cast<float>(x) + 0.5f) / width, 0.0f, 0.0f );
+		ComputeViewTaps( angularKernel, InterpolatedProjectorIndex( screenPos, cameraPos, 0 ), num_projectors_x, columnTaps[x] );
 	}
-
+	std::vector<ViewTaps> rowTaps( height );
+	for ( int y = 0; y < height; ++y )
+	{
+		const Vec3f screenPos = Vec3f( 0.0f, screenStart.y + screenSize.y*(static_cast<float>(height-y-1) + 0.5f) / height, 0.0f );
+		ComputeViewTaps( angularKernel, InterpolatedProjectorIndex( screenPos, cameraPos, 1 ), num_projectors_y, rowTaps[y] );
+	}
+	ResampleTaps columnResampleTaps, rowResampleTaps;
+	ComputeResampleTaps( spatialFilter, width, screenSize.x, holoVizioModel.image_size_x, holoVizioModel.screen_size_x, columnResampleTaps );
+	ComputeResampleTaps( spatialFilter, height, screenSize.y, holoVizioModel.image_size_y, holoVizioModel.screen_size_y, rowResampleTaps );
+	InterpolateViews( holoVizioImage, num_projectors_x, columnTaps, rowTaps, columnResampleTaps, rowResampleTaps, cameraImage );
 	return true;
 }
 
@@ -205,12 +239,14 @@ bool LightFieldInterpolation::Interpolate_HoloVizio_to_Camera( const Image3D& ho
 bool LightFieldInterpolation::Visualize_HoloVizio_to_Camera( const Image3D& holoVizioImage, Image2D& cameraImage, const Vec3f& cameraPos, const bool normalize )
 {
 	const int num_projectors = holoVizioModel.num_projectors;
+	const int num_projectors_x = holoVizioModel.NumProjectorsX();
+	const int num_projectors_y = holoVizioModel.NumProjectorsY();
 	const int width = holoVizioModel.image_size_x;
 	const int height = holoVizioModel.image_size_y;
 	const Vec2f screenSize( holoVizioModel.screen_size_x, holoVizioModel.screen_size_y );
 	const Vec2f screenStart = -screenSize * 0.5f;
 
-	if ( num_projectors == 0 )
+	if ( num_projectors == 0 || num_projectors_x*num_projectors_y != num_projectors )
 		return false;
 	if ( width == 0 || height == 0 )
 		return false;
@@ -219,52 +255,48 @@ bool LightFieldInterpolation::Visualize_HoloVizio_to_Camera( const Image3D& holo
 
 	cameraImage.Resize( width, height );
 
+	// Display model depends only on horizontal position at the screen, so weights are evaluated once per column.
+	std::vector<int> columnStart( 1, 0 );
+	std::vector<int> columnProjIds;
+	std::vector<float> columnWeights;
+	std::vector<int> projIds;
+	std::vector<float> weights;
 	for ( int x = 0; x < width; ++x )
 	{
-		for ( int y = 0; y < height; ++y )
+		const Vec3f screenPos = Vec3f( screenStart.x + screenSize.x*(static_cast<float>(x) + 0.5f) / width, 0.0f, 0.0f );
+		PerceivedProjectorWeights( screenPos, cameraPos, normalize, projIds, weights );
+		columnProjIds.insert( columnProjIds.end(), projIds.begin(), projIds.end() );
+		columnWeights.insert( columnWeights.end(), weights.begin(), weights.end() );
+		columnStart.push_back( static_cast<int>( columnProjIds.size() ) );
+	}
+	// Rows of projectors grid are blended linearly.
+	std::vector<ViewTaps> rowTaps( height );
+	for ( int y = 0; y < height; ++y )
+	{
+		const Vec3f screenPos = Vec3f( 0.0f, screenStart.y + screenSize.y*(static_cast<float>(height-y-1) + 0.5f) / height, 0.0f );
+		ComputeViewTaps( AngularKernel::Linear, InterpolatedProjectorIndex( screenPos, cameraPos, 1 ), num_projectors_y, rowTaps[y] );
+	}
+	const int numRowTaps = num_projectors_y > 1 ? 2 : 1;
+
+#pragma omp parallel for
+	for ( int y = 0; y < height; ++y )
+	{
+		Vec3f* outputRow = cameraImage.Data() + static_cast<size_t>(y)*width;
+		for ( int x = 0; x < width; ++x )
 		{
-			const Vec3f screenPos = Vec3f(
-				screenStart.x + screenSize.x*(static_cast<float>(x) + 0.5f) / width,
-				screenStart.y + screenSize.y*(static_cast<float>(y) + 0.5f) / height,
-				0.0f );
-			const float interpolatedProjectorIndex = InterpolatedProjectorIndex( screenPos, cameraPos );
-			const int leftProjId = std::min<int>(std::max<int>( static_cast<int>(interpolatedProjectorIndex), 0 ), num_projectors-2 );
-			const int rightProjId = leftProjId + 1;
-			Vec3f interpolatedValue = Vec3f(0.0f,0.0f,0.0f);
-			float sumOfWeights = 0.0f;
-			const int projIdMin = std::max<int>( leftProjId - num_projectors_contributes_halved + 1, 0 );
-			const int projIdMax = std::min<int>( leftProjId + num_projectors_contributes_halved, num_projectors - 1 );
-			for ( int projId = projIdMin; projId <= projIdMax; ++projId )
+			Vec3f perceivedValue = Vec3f(0.0f,0.0f,0.0f);
+			for ( int rowTap = 0; rowTap < numRowTaps; ++rowTap )
 			{
-				const Vec3f projectorPos( holoVizioModel.projectors_pos_x[projId], holoVizioModel.projectors_pos_y[projId], holoVizioModel.projectors_pos_z[projId] );
-				const float weight = ProjectorWeight( projectorPos, screenPos, cameraPos );
-				if ( weight > weight_epsilon )
+				const int rowOffset = rowTaps[y].ids[rowTap] * num_projectors_x;
+				Vec3f interpolatedValue = Vec3f(0.0f,0.0f,0.0f);
+				for ( int i = columnStart[x]; i < columnStart[x+1]; ++i )
 				{
-					const Vec3f color = holoVizioImage.at(x,y,projId);
-					interpolatedValue = interpolatedValue + color*weight;
-					sumOfWeights += weight;
+					const Vec3f color = holoVizioImage.Layer(rowOffset+columnProjIds[i]).Data()[ static_cast<size_t>(y)*width + x ];
+					interpolatedValue = interpolatedValue + color*columnWeights[i];
 				}
+				perceivedValue = perceivedValue + interpolatedValue*rowTaps[y].weights[rowTap];
 			}
-			if ( normalize && sumOfWeights > weight_epsilon )
-			{
-#if 0
-				interpolatedValue = interpolatedValue * (1.0f/sumOfWeights);
-#else
-				const float leftMaximalWeightsSum = MaximalProjectorWeightsSum( screenPos, leftProjId, projIdMin, projIdMax );
-				const float rightMaximalWeightsSum = MaximalProjectorWeightsSum( screenPos, rightProjId, projIdMin, projIdMax );
-				const float cameraTan = (cameraPos.x - screenPos.x) / (cameraPos.z - screenPos.z);
-				const float leftProjTan = (holoVizioModel.projectors_pos_x[leftProjId] - screenPos.x) / (holoVizioModel.projectors_pos_z[leftProjId] - screenPos.z);
-				const float rightProjTan = (holoVizioModel.projectors_pos_x[rightProjId] - screenPos.x) / (holoVizioModel.projectors_pos_z[rightProjId] - screenPos.z);
-				const float cameraAngle = std::atan( cameraTan );
-				const float leftProjAngle = std::atan( leftProjTan );
-				const float rightProjAngle = std::atan( rightProjTan );
-				const float leftRightRatio = std::min<float>(std::max<float>( (cameraAngle-leftProjAngle)/(rightProjAngle-leftProjAngle), 0.0f), 1.0f);
-				const float curMaximalWeightsSum = (1.0f-leftRightRatio)*leftMaximalWeightsSum + leftRightRatio*rightMaximalWeightsSum;
-				const float normalizationValue = curMaximalWeightsSum;
-				interpolatedValue = interpolatedValue * (1.0f/normalizationValue);
-#endif
-			}
-			cameraImage.at(x,y) = interpolatedValue;
+			outputRow[x] = perceivedValue;
 		}
 	}
 
@@ -273,13 +305,63 @@ bool LightFieldInterpolation::Visualize_HoloVizio_to_Camera( const Image3D& holo
 
 
 
+void LightFieldInterpolation::PerceivedProjectorWeights( const Vec3f& screenPos, const Vec3f& cameraPos, const bool normalize, std::vector<int>& projIds, std::vector<float>& weights )
+{
+	// Horizontal scattering only, so the first row of projectors is enough.
+	const int num_projectors = holoVizioModel.NumProjectorsX();
+	projIds.clear();
+	weights.clear();
+	if ( num_projectors < 2 )
+		return;
+
+	const float interpolatedProjectorIndex = InterpolatedProjectorIndex( screenPos, cameraPos );
+	const int leftProjId = std::min<int>(std::max<int>( static_cast<int>(interpolatedProjectorIndex), 0 ), num_projectors-2 );
+	const int rightProjId = leftProjId + 1;
+	float sumOfWeights = 0.0f;
+	const int projIdMin = std::max<int>( leftProjId - num_projectors_contributes_halved + 1, 0 );
+	const int projIdMax = std::min<int>( leftProjId + num_projectors_contributes_halved, num_projectors - 1 );
+	for ( int projId = projIdMin; projId <= projIdMax; ++projId )
+	{
+		const Vec3f projectorPos( holoVizioModel.projectors_pos_x[projId], holoVizioModel.projectors_pos_y[projId], holoVizioModel.projectors_pos_z[projId] );
+		const float weight = ProjectorWeight( projectorPos, screenPos, cameraPos );
+		if ( weight > weight_epsilon )
+		{
+			projIds.push_back( projId );
+			weights.push_back( weight );
+			sumOfWeights += weight;
+		}
+	}
+	if ( normalize && sumOfWeights > weight_epsilon )
+	{
+#if 0
+		const float normalizationValue = sumOfWeights;
+#else
+		const float leftMaximalWeightsSum = MaximalProjectorWeightsSum( screenPos, leftProjId, projIdMin, projIdMax );
+		const float rightMaximalWeightsSum = MaximalProjectorWeightsSum( screenPos, rightProjId, projIdMin, projIdMax );
+		const float cameraTan = (cameraPos.x - screenPos.x) / (cameraPos.z - screenPos.z);
+		const float leftProjTan = (holoVizioModel.projectors_pos_x[leftProjId] - screenPos.x) / (holoVizioModel.projectors_pos_z[leftProjId] - screenPos.z);
+		const float rightProjTan = (holoVizioModel.projectors_pos_x[rightProjId] - screenPos.x) / (holoVizioModel.projectors_pos_z[rightProjId] - screenPos.z);
+		const float cameraAngle = std::atan( cameraTan );
+		const float leftProjAngle = std::atan( leftProjTan );
+		const float rightProjAngle = std::atan( rightProjTan );
+		const float leftRightRatio = std::min<float>(std::max<float>( (cameraAngle-leftProjAngle)/(rightProjAngle-leftProjAngle), 0.0f), 1.0f);
+		const float curMaximalWeightsSum = (1.0f-leftRightRatio)*leftMaximalWeightsSum + leftRightRatio*rightMaximalWeightsSum;
+		const float normalizationValue = curMaximalWeightsSum;
+#endif
+		for ( size_t i = 0; i < weights.size(); ++i )
+			weights[i] *= 1.0f/normalizationValue;
+	}
+}
+
+
+
 float LightFieldInterpolation::ProjectorWeight( const Vec3f& projectorPos, const Vec3f& screenPos, const Vec3f& cameraPos )
 {
 	const float projectorTan = (projectorPos.x - screenPos.x) / (projectorPos.z - screenPos.z);
 	const float cameraTan = (cameraPos.x - screenPos.x) / (cameraPos.z - screenPos.z);
 	const float projectorAngle = atan( projectorTan );
 	const float cameraAngle = atan( cameraTan );
-	const float angleDiff = abs( projectorAngle - cameraAngle );
+	const float angleDiff = std::abs( projectorAngle - cameraAngle );
 	const float angularScatteringSqr = holoVizioModel.angular_scattering*holoVizioModel.angular_scattering;
 	const float gaussianArgSqr = angleDiff*angleDiff;
 	const float gaussianSigmaSqr = angularScatteringSqr/gaussian_half_decay_sqr;
@@ -289,23 +371,28 @@ float LightFieldInterpolation::ProjectorWeight( const Vec3f& projectorPos, const
 
 
 
-float LightFieldInterpolation::InterpolatedCameraIndex( const Vec3f& screenPos, const Vec3f& projectorPos )
+float LightFieldInterpolation::InterpolatedCameraIndex( const Vec3f& screenPos, const Vec3f& projectorPos, const int axis )
 {
-	const int num_cameras = multiViewModel.num_cameras;
+	// Cameras along the axis: first row of the grid for x-axis, first column for y-axis.
+	const int num_cameras = axis == 0 ? multiViewModel.NumCamerasX() : multiViewModel.NumCamerasY();
+	const int stride = axis == 0 ? 1 : multiViewModel.NumCamerasX();
+	const std::vector<float>& cameras_pos = axis == 0 ? multiViewModel.cameras_pos_x : multiViewModel.cameras_pos_y;
+	if ( num_cameras < 2 )
+		return 0.0f;
 	// Calculate the angle that we are looking for.
-	const float targetTan = (screenPos.x - projectorPos.x) / (screenPos.z - projectorPos.z);
+	const float targetTan = (screenPos[axis] - projectorPos[axis]) / (screenPos.z - projectorPos.z);
 	// Use binary-like search to find two closest angles.
 	int leftCameraId = 0;
 	int rightCameraId = num_cameras - 1;
-	float leftCameraTan = (screenPos.x - multiViewModel.cameras_pos_x[leftCameraId]) / (screenPos.z - multiViewModel.cameras_pos_z[leftCameraId]);
-	float rightCameraTan = (screenPos.x - multiViewModel.cameras_pos_x[rightCameraId]) / (screenPos.z - multiViewModel.cameras_pos_z[rightCameraId]);
+	float leftCameraTan = (screenPos[axis] - cameras_pos[leftCameraId*stride]) / (screenPos.z - multiViewModel.cameras_pos_z[leftCameraId*stride]);
+	float rightCameraTan = (screenPos[axis] - cameras_pos[rightCameraId*stride]) / (screenPos.z - multiViewModel.cameras_pos_z[rightCameraId*stride]);
 	// leftCameraTan must be lesser than rightCameraTan.
 	if ( leftCameraTan > rightCameraTan )
 		return 0.0f;
 	for ( int iter = 0; iter < 50 && (rightCameraId - leftCameraId)>1; ++iter )
 	{
 		const int testCameraId = (leftCameraId + rightCameraId) / 2;
-		const float testCameraTan = (screenPos.x - multiViewModel.cameras_pos_x[testCameraId]) / (screenPos.z - multiViewModel.cameras_pos_z[testCameraId]);
+		const float testCameraTan = (screenPos[axis] - cameras_pos[testCameraId*stride]) / (screenPos.z - multiViewModel.cameras_pos_z[testCameraId*stride]);
 		// We must increase leftCameraTan, but keep it smaller than targetTan.
 		// We must decrease rightCameraTan, but keep it bigger than targetTan.
 		if ( testCameraTan > targetTan )
@@ -330,23 +417,28 @@ float LightFieldInterpolation::InterpolatedCameraIndex( const Vec3f& screenPos,
 
 
 
-float LightFieldInterpolation::InterpolatedProjectorIndex( const Vec3f& screenPos, const Vec3f& cameraPos )
+float LightFieldInterpolation::InterpolatedProjectorIndex( const Vec3f& screenPos, const Vec3f& cameraPos, const int axis )
 {
-	const int num_projectors = holoVizioModel.num_projectors;
+	// Projectors along the axis: first row of the grid for x-axis, first column for y-axis.
+	const int num_projectors = axis == 0 ? holoVizioModel.NumProjectorsX() : holoVizioModel.NumProjectorsY();
+	const int stride = axis == 0 ? 1 : holoVizioModel.NumProjectorsX();
+	const std::vector<float>& projectors_pos = axis == 0 ? holoVizioModel.projectors_pos_x : holoVizioModel.projectors_pos_y;
+	if ( num_projectors < 2 )
+		return 0.0f;
 	// Calculate the angle that we are looking for.
-	const float targetTan = (screenPos.x - cameraPos.x) / (screenPos.z - cameraPos.z);
+	const float targetTan = (screenPos[axis] - cameraPos[axis]) / (screenPos.z - cameraPos.z);
 	// Use binary-like search to find two closest angles.
 	int leftProjId = 0;
 	int rightProjId = num_projectors - 1;
-	float leftProjTan = (screenPos.x - holoVizioModel.projectors_pos_x[leftProjId]) / (screenPos.z - holoVizioModel.projectors_pos_z[leftProjId]);
-	float rightProjTan = (screenPos.x - holoVizioModel.projectors_pos_x[rightProjId]) / (screenPos.z - holoVizioModel.projectors_pos_z[rightProjId]);
+	float leftProjTan = (screenPos[axis] - projectors_pos[leftProjId*stride]) / (screenPos.z - holoVizioModel.projectors_pos_z[leftProjId*stride]);
+	float rightProjTan = (screenPos[axis] - projectors_pos[rightProjId*stride]) / (screenPos.z - holoVizioModel.projectors_pos_z[rightProjId*stride]);
 	// leftProjTan must be bigger than rightCameraTan.
 	if ( leftProjTan < rightProjTan )
 		return 0.0f;
 	for ( int iter = 0; iter < 50 && (rightProjId - leftProjId)>1; ++iter )
 	{
 		const int testProjId = (leftProjId + rightProjId) / 2;
-		const float testProjTan = (screenPos.x - holoVizioModel.projectors_pos_x[testProjId]) / (screenPos.z - holoVizioModel.projectors_pos_z[testProjId]);
+		const float testProjTan = (screenPos[axis] - projectors_pos[testProjId*stride]) / (screenPos.z - holoVizioModel.projectors_pos_z[testProjId*stride]);
 		// We must decrease leftProjTan, but keep it bigger than targetTan.
 		// We must increase rightProjTan, but keep it smaller than targetTan.
 		if ( testProjTan < targetTan )
@@ -380,4 +472,231 @@ float LightFieldInterpolation::MaximalProjectorWeightsSum( const Vec3f& screenPo
 		sumOfWeights += weight;
 	}
 	return sumOfWeights;
-}
\ No newline at end of file
+}
+
+
+
+int LightFieldInterpolation::NumViewTaps( const AngularKernel kernel )
+{
+	switch ( kernel )
+	{
+	case AngularKernel::Cubic: return 4;
+	case AngularKernel::Lanczos: return 6;
+	default: return 2;
+	}
+}
+
+
+
+void LightFieldInterpolation::ComputeViewTaps( const AngularKernel kernel, const float interpolatedIndex, const int numViews, ViewTaps& taps )
+{
+	// Left view and fractional part are clamped exactly as for the linear interpolation.
+	const int leftViewId = std::min<int>(std::max<int>( static_cast<int>(interpolatedIndex), 0 ), std::max<int>( numViews-2, 0 ) );
+	const float t = std::min<float>(std::max<float>( interpolatedIndex - static_cast<float>(leftViewId), 0.0f), 1.0f );
+	const int numTaps = NumViewTaps( kernel );
+	const int firstTapOffset = 1 - numTaps/2;
+	for ( int tap = 0; tap < max_view_taps; ++tap )
+	{
+		taps.ids[tap] = std::min<int>( std::max<int>( leftViewId + firstTapOffset + tap, 0 ), numViews-1 );
+		taps.weights[tap] = 0.0f;
+	}
+	if ( numViews == 1 )
+	{
+		taps.weights[0] = 1.0f;
+		return;
+	}
+	switch ( kernel )
+	{
+	case AngularKernel::Linear:
+		taps.weights[0] = 1.0f - t;
+		taps.weights[1] = t;
+		break;
+	case AngularKernel::Cubic:
+	{
+		const float t2 = t*t;
+		const float t3 = t2*t;
+		taps.weights[0] = 0.5f*( -t3 + 2.0f*t2 - t );
+		taps.weights[1] = 0.5f*( 3.0f*t3 - 5.0f*t2 + 2.0f );
+		taps.weights[2] = 0.5f*( -3.0f*t3 + 4.0f*t2 + t );
+		taps.weights[3] = 0.5f*( t3 - t2 );
+		break;
+	}
+	case AngularKernel::Lanczos:
+	{
+		const float a = static_cast<float>( numTaps/2 );
+		float sumOfWeights = 0.0f;
+		for ( int tap = 0; tap < numTaps; ++tap )
+		{
+			const float d = static_cast<float>( firstTapOffset + tap ) - t;
+			float weight = 1.0f;
+			if ( std::abs( d ) > 1e-6f )
+			{
+				const float pd = pi * d;
+				weight = a * std::sin( pd ) * std::sin( pd/a ) / (pd*pd);
+			}
+			taps.weights[tap] = weight;
+			sumOfWeights += weight;
+		}
+		for ( int tap = 0; tap < numTaps; ++tap )
+			taps.weights[tap] /= sumOfWeights;
+		break;
+	}
+	}
+}
+
+
+
+void LightFieldInterpolation::ComputeResampleTaps( const SpatialFilter filter, const int outputSize, const float outputScreenSize, const int inputSize, const float inputScreenSize, ResampleTaps& taps )
+{
+	const float lanczos_radius = 3.0f;
+	taps.start.assign( 1, 0 );
+	taps.ids.clear();
+	taps.weights.clear();
+	// Input pixels per output pixel; the filter is widened when downsampling.
+	const float scale = (outputScreenSize / outputSize) / (inputScreenSize / inputSize);
+	const float filterScale = std::max<float>( scale, 1.0f );
+	for ( int i = 0; i < outputSize; ++i )
+	{
+		// Both screens are centered, so pixel centers are matched by their position at the screen.
+		const float screenPos = -0.5f*outputScreenSize + outputScreenSize*(static_cast<float>(i) + 0.5f) / outputSize;
+		const float inputPos = (screenPos + 0.5f*inputScreenSize) / inputScreenSize * inputSize - 0.5f;
+		const float inputPosRounded = std::floor( inputPos + 0.5f );
+		if ( std::abs( inputPos - inputPosRounded ) < 1e-4f && scale <= 1.0f + 1e-4f )
+		{
+			// Output pixel coincides with input one (e.g., equal resolutions).
+			taps.ids.push_back( std::min<int>( std::max<int>( static_cast<int>( inputPosRounded ), 0 ), inputSize-1 ) );
+			taps.weights.push_back( 1.0f );
+		}
+		else if ( filter == SpatialFilter::Bilinear )
+		{
+			const float inputPosFloor = std::floor( inputPos );
+			const float t = inputPos - inputPosFloor;
+			const int id = static_cast<int>( inputPosFloor );
+			taps.ids.push_back( std::min<int>( std::max<int>( id, 0 ), inputSize-1 ) );
+			taps.weights.push_back( 1.0f - t );
+			taps.ids.push_back( std::min<int>( std::max<int>( id+1, 0 ), inputSize-1 ) );
+			taps.weights.push_back( t );
+		}
+		else
+		{
+			const float radius = lanczos_radius * filterScale;
+			const int idMin = static_cast<int>( std::floor( inputPos - radius ) ) + 1;
+			const int idMax = static_cast<int>( std::floor( inputPos + radius ) );
+			const size_t firstTap = taps.weights.size();
+			float sumOfWeights = 0.0f;
+			for ( int id = idMin; id <= idMax; ++id )
+			{
+				const float d = (static_cast<float>( id ) - inputPos) / filterScale;
+				float weight = 1.0f;
+				if ( std::abs( d ) > 1e-6f )
+				{
+					const float pd = pi * d;
+					weight = lanczos_radius * std::sin( pd ) * std::sin( pd/lanczos_radius ) / (pd*pd);
+				}
+				taps.ids.push_back( std::min<int>( std::max<int>( id, 0 ), inputSize-1 ) );
+				taps.weights.push_back( weight );
+				sumOfWeights += weight;
+			}
+			for ( size_t tap = firstTap; tap < taps.weights.size(); ++tap )
+				taps.weights[tap] /= sumOfWeights;
+		}
+		taps.start.push_back( static_cast<int>( taps.ids.size() ) );
+	}
+}
+
+
+
+// Horizontal pass: angular interpolation between views and horizontal resampling of one input row.
+template<int NumTaps>
+static void InterpolateViewsRow( const Vec3f* const* viewRows, const ViewTaps* columnTaps, const ResampleTaps& columnResampleTaps, float* outputRow, const int width )
+{
+	for ( int x = 0; x < width; ++x )
+	{
+		const ViewTaps& taps = columnTaps[x];
+		const int resampleStart = columnResampleTaps.start[x];
+		const int resampleEnd = columnResampleTaps.start[x+1];
+		float r = 0.0f, g = 0.0f, b = 0.0f;
+		for ( int tap = 0; tap < NumTaps; ++tap )
+		{
+			const Vec3f* viewRow = viewRows[ taps.ids[tap] ];
+			for ( int resampleTap = resampleStart; resampleTap < resampleEnd; ++resampleTap )
+			{
+				const Vec3f& color = viewRow[ columnResampleTaps.ids[resampleTap] ];
+				const float weight = taps.weights[tap] * columnResampleTaps.weights[resampleTap];
+				r += color.x * weight;
+				g += color.y * weight;
+				b += color.z * weight;
+			}
+		}
+		outputRow[3*x+0] = r;
+		outputRow[3*x+1] = g;
+		outputRow[3*x+2] = b;
+	}
+}
+
+
+
+void LightFieldInterpolation::InterpolateViews( const Image3D& viewsImage, const int gridSizeX, const std::vector<ViewTaps>& columnTaps, const std::vector<ViewTaps>& rowTaps,
+	const ResampleTaps& columnResampleTaps, const ResampleTaps& rowResampleTaps, Image2D& outputImage ) const
+{
+	const int rows_per_chunk = 32;
+
+	const int inputWidth = static_cast<int>( viewsImage.Width() );
+	const int gridSizeY = static_cast<int>( viewsImage.Depth() ) / gridSizeX;
+	const int width = static_cast<int>( columnTaps.size() );
+	const int height = static_cast<int>( rowTaps.size() );
+	const int numColumnTaps = NumViewTaps( angularKernel );
+	const int numRowTaps = gridSizeY > 1 ? numColumnTaps : 1;
+	const int numChunks = (height + rows_per_chunk - 1) / rows_per_chunk;
+
+	// Ring of horizontally processed input rows must hold all input rows of one output row.
+	int ringSize = 1;
+	for ( int y = 0; y < height; ++y )
+		ringSize = std::max<int>( ringSize, rowResampleTaps.ids[ rowResampleTaps.start[y+1]-1 ] - rowResampleTaps.ids[ rowResampleTaps.start[y] ] + 1 );
+
+	outputImage.Resize( width, height );
+	// Separable pass over chunks of output rows. Every input row of every grid row is processed horizontally
+	// (angular interpolation and horizontal resampling) once per chunk and kept in the ring, the vertical pass
+	// then blends contiguous float rows. Only views of the tapped grid rows are streamed, so they stay in cache together.
+#pragma omp parallel for schedule(dynamic)
+	for ( int chunk = 0; chunk < numChunks; ++chunk )
+	{
+		std::vector<const Vec3f*> viewRows( gridSizeX );
+		std::vector<std::vector<float>> ringRows( gridSizeY*ringSize, std::vector<float>() );
+		std::vector<int> ringInputRows( gridSizeY*ringSize, -1 );
+		std::vector<float> outputRow( width*3 );
+		for ( int y = chunk*rows_per_chunk; y < std::min<int>( (chunk+1)*rows_per_chunk, height ); ++y )
+		{
+			std::fill( outputRow.begin(), outputRow.end(), 0.0f );
+			for ( int rowTap = 0; rowTap < numRowTaps; ++rowTap )
+			{
+				const int gridRow = rowTaps[y].ids[rowTap];
+				for ( int resampleTap = rowResampleTaps.start[y]; resampleTap < rowResampleTaps.start[y+1]; ++resampleTap )
+				{
+					const int inputRow = rowResampleTaps.ids[resampleTap];
+					const int ringId = gridRow*ringSize + inputRow % ringSize;
+					std::vector<float>& ringRow = ringRows[ringId];
+					if ( ringInputRows[ringId] != inputRow )
+					{
+						for ( int gridColumn = 0; gridColumn < gridSizeX; ++gridColumn )
+							viewRows[gridColumn] = viewsImage.Layer( gridColumn + gridRow*gridSizeX ).Data() + static_cast<size_t>(inputRow)*inputWidth;
+						ringRow.resize( width*3 );
+						switch ( numColumnTaps )
+						{
+						case 4: InterpolateViewsRow<4>( viewRows.data(), columnTaps.data(), columnResampleTaps, ringRow.data(), width ); break;
+						case 6: InterpolateViewsRow<6>( viewRows.data(), columnTaps.data(), columnResampleTaps, ringRow.data(), width ); break;
+						default: InterpolateViewsRow<2>( viewRows.data(), columnTaps.data(), columnResampleTaps, ringRow.data(), width ); break;
+						}
+						ringInputRows[ringId] = inputRow;
+					}
+					const float weight = rowTaps[y].weights[rowTap] * rowResampleTaps.weights[resampleTap];
+					const float* input = ringRow.data();
+					float* output = outputRow.data();
+					for ( int i = 0; i < width*3; ++i )
+						output[i] += input[i] * weight;
+				}
+			}
+			std::copy( outputRow.begin(), outputRow.end(), &outputImage.Data()[ static_cast<size_t>(y)*width ][0] );
+		}
+	}
+}
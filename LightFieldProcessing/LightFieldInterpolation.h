@@ -16,10 +16,44 @@
 
 #include "geometry.h"
 
+#include <vector>
+
 class Image2D;
 class Image3D;
 
 
+// Kernel for interpolation between neighbouring views (cameras or projectors).
+enum class AngularKernel
+{
+	Linear,  // 2 taps.
+	Cubic,   // 4 taps, Catmull-Rom spline.
+	Lanczos, // 6 taps, Lanczos-3 window.
+};
+
+// Filter for spatial resampling between different image resolutions and screen sizes.
+enum class SpatialFilter
+{
+	Bilinear, // 2x2 taps.
+	Lanczos,  // 6x6 taps (more when downsampling), Lanczos-3 window.
+};
+
+const int max_view_taps = 6;
+
+struct ViewTaps
+{
+	int ids[max_view_taps];
+	float weights[max_view_taps];
+};
+
+// Resampling taps for all pixels along one axis. Taps of pixel i are [start[i], start[i+1]).
+struct ResampleTaps
+{
+	std::vector<int> start;
+	std::vector<int> ids;
+	std::vector<float> weights;
+};
+
+
 class LightFieldInterpolation
 {
 public:
@@ -29,25 +63,45 @@ public:
 
 	void SetHoloVizioModel( const HoloVizioModel& holoVizioModel );
 	void SetMultiViewModel( const MultiViewModel& multiViewModel );
+	void SetAngularKernel( const AngularKernel angularKernel ) { this->angularKernel = angularKernel; }
+	void SetSpatialFilter( const SpatialFilter spatialFilter ) { this->spatialFilter = spatialFilter; }
 
 	bool Convert_MultiView_to_HoloVizio( const Image3D& multiViewImage, Image3D& holoVizioImage );
 	bool Convert_HoloVizio_to_MultiView( const Image3D& holoVizioImage, Image3D& multiViewImage );
+	// Views of the target model are interpolated from views of the MultiView model (e.g., of a dense light field).
+	bool Convert_MultiView_to_MultiView( const Image3D& multiViewImage, const MultiViewModel& targetModel, Image3D& targetImage );
 
 	bool Interpolate_MultiView_to_Projector( const Image3D& multiViewImage, Image2D& projectorImage, const Vec3f& projectorPos );
+	bool Interpolate_MultiView_to_Camera( const Image3D& multiViewImage, const MultiViewModel& cameraModel, Image2D& cameraImage, const Vec3f& cameraPos );
 	bool Interpolate_HoloVizio_to_Camera( const Image3D& holoVizioImage, Image2D& cameraImage, const Vec3f& cameraPos );
 
 	//bool Visualize_HoloVizio_to_MultiView( const std::vector<Image2D>& holoVizioImage, std::vector<Image2D>& multiViewImage );
 	bool Visualize_HoloVizio_to_Camera( const Image3D& holoVizioImage, Image2D& cameraImage, const Vec3f& cameraPos, const bool normalize = true );
 	float ProjectorWeight( const Vec3f& projectorPos, const Vec3f& screenPos, const Vec3f& cameraPos );
+	// Weights of projectors, which contribute to the color perceived from cameraPos at screenPos.
+	// Perceived color is sum of projector colors multiplied by these weights (i.e., display model is linear).
+	void PerceivedProjectorWeights( const Vec3f& screenPos, const Vec3f& cameraPos, const bool normalize, std::vector<int>& projIds, std::vector<float>& weights );
 
 private:
-	float InterpolatedCameraIndex( const Vec3f& screenPos, const Vec3f& projectorPos );
-	float InterpolatedProjectorIndex( const Vec3f& screenPos, const Vec3f& cameraPos );
+	// View of width x height pixels covering screenSize; its rays pass through viewPos (camera or projector).
+	bool InterpolateMultiView( const Image3D& multiViewImage, const int width, const int height, const Vec2f& screenSize, const Vec3f& viewPos, Image2D& viewImage );
+	// Index is fractional position in the grid along the axis (0 - x, 1 - y).
+	float InterpolatedCameraIndex( const Vec3f& screenPos, const Vec3f& projectorPos, const int axis = 0 );
+	float InterpolatedProjectorIndex( const Vec3f& screenPos, const Vec3f& cameraPos, const int axis = 0 );
 	float MaximalProjectorWeightsSum( const Vec3f& screenPos, const int projIdCentral, const int projIdMin, const int projIdMax );
+	static int NumViewTaps( const AngularKernel kernel );
+	static void ComputeViewTaps( const AngularKernel kernel, const float interpolatedIndex, const int numViews, ViewTaps& taps );
+	// Axis of outputSize pixels covering outputScreenSize millimeters is resampled from axis of inputSize pixels covering inputScreenSize.
+	static void ComputeResampleTaps( const SpatialFilter filter, const int outputSize, const float outputScreenSize, const int inputSize, const float inputScreenSize, ResampleTaps& taps );
+	// Views form a grid of gridSizeX columns. View and resample taps are indexed by output image column (row).
+	void InterpolateViews( const Image3D& viewsImage, const int gridSizeX, const std::vector<ViewTaps>& columnTaps, const std::vector<ViewTaps>& rowTaps,
+		const ResampleTaps& columnResampleTaps, const ResampleTaps& rowResampleTaps, Image2D& outputImage ) const;
 
 private:
 	HoloVizioModel holoVizioModel;
 	MultiViewModel multiViewModel;
+	AngularKernel angularKernel = AngularKernel::Linear;
+	SpatialFilter spatialFilter = SpatialFilter::Bilinear;
 };
 
 #endif // LIGHTFIELDPROCESSING_LIGHTFIELDINTERPOLATION_H
\ No newline at end of file
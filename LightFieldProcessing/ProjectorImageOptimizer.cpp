@@ -0,0 +1,384 @@
+/*
+* LightFieldDisplayModel - LightFieldProcessing - ProjectorImageOptimizer
+*
+* Inverse display rendering: finds projector images, which minimize the perceived error for a set of observer positions.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ProjectorImageOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "Image2D.h"
+#include "Image3D.h"
+
+
+const int default_max_iterations = 20;
+const float default_time_budget = 0.0f;
+const float default_tolerance = 1e-3f;
+
+
+
+static double DotProduct( const std::vector<float>& lhs, const std::vector<float>& rhs )
+{
+	const int size = static_cast<int>( lhs.size() );
+	double sum = 0.0;
+#pragma omp parallel for reduction(+:sum)
+	for ( int i = 0; i < size; ++i )
+		sum += static_cast<double>( lhs[i] ) * rhs[i];
+	return sum;
+}
+
+
+
+// output += input*factor
+static void AddScaled( std::vector<float>& output, const std::vector<float>& input, const float factor )
+{
+	const int size = static_cast<int>( output.size() );
+#pragma omp parallel for
+	for ( int i = 0; i < size; ++i )
+		output[i] += input[i] * factor;
+}
+
+
+
+static void Image3DToVector( const Image3D& image, std::vector<float>& vector )
+{
+	const size_t layerSize = image.Width() * image.Height();
+	vector.resize( layerSize * image.Depth() * 3 );
+	for ( size_t z = 0; z < image.Depth(); ++z )
+	{
+		const float* source = &image.Layer( static_cast<int>(z) ).Data()[0][0];
+		std::copy( source, source + layerSize*3, vector.begin() + z*layerSize*3 );
+	}
+}
+
+
+
+static void VectorToImage3D( const std::vector<float>& vector, Image3D& image )
+{
+	const size_t layerSize = image.Width() * image.Height();
+	for ( size_t z = 0; z < image.Depth(); ++z )
+	{
+		float* target = &image.Layer( static_cast<int>(z) ).Data()[0][0];
+		std::copy( vector.begin() + z*layerSize*3, vector.begin() + (z+1)*layerSize*3, target );
+	}
+}
+
+
+
+ProjectorImageOptimizer::ProjectorImageOptimizer()
+	:maxIterations( default_max_iterations )
+	,timeBudget( default_time_budget )
+	,tolerance( default_tolerance )
+	,nonNegative( false )
+	,operatorReady( false )
+{
+}
+
+
+
+ProjectorImageOptimizer::ProjectorImageOptimizer( const HoloVizioModel& holoVizioModel, const MultiViewModel& multiViewModel )
+	:holoVizioModel( holoVizioModel )
+	,multiViewModel( multiViewModel )
+	,lfInterpolation( holoVizioModel, multiViewModel )
+	,maxIterations( default_max_iterations )
+	,timeBudget( default_time_budget )
+	,tolerance( default_tolerance )
+	,nonNegative( false )
+	,operatorReady( false )
+{
+}
+
+
+
+ProjectorImageOptimizer::~ProjectorImageOptimizer()
+{
+}
+
+
+
+void ProjectorImageOptimizer::SetHoloVizioModel( const HoloVizioModel& holoVizioModel )
+{
+	this->holoVizioModel = holoVizioModel;
+	this->lfInterpolation.SetHoloVizioModel( holoVizioModel );
+	this->operatorReady = false;
+}
+
+
+
+void ProjectorImageOptimizer::SetMultiViewModel( const MultiViewModel& multiViewModel )
+{
+	this->multiViewModel = multiViewModel;
+	this->lfInterpolation.SetMultiViewModel( multiViewModel );
+	this->operatorReady = false;
+}
+
+
+
+bool ProjectorImageOptimizer::Optimize( const Image3D& multiViewImage, Image3D& holoVizioImage, const bool warmStart )
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point startTime = Clock::now();
+
+	const int num_cameras = multiViewModel.num_cameras;
+	const int num_projectors = holoVizioModel.num_projectors;
+	const int width = holoVizioModel.image_size_x;
+	const int height = holoVizioModel.image_size_y;
+
+	convergenceLog.clear();
+
+	if ( !PrepareOperator() )
+		return false;
+	const int multiViewWidth = static_cast<int>( multiViewImage.Width() );
+	const int multiViewHeight = static_cast<int>( multiViewImage.Height() );
+	const int multiViewDepth = static_cast<int>( multiViewImage.Depth() );
+	if ( multiViewWidth != width || multiViewHeight != height || multiViewDepth != num_cameras )
+		return false;
+
+	// +++++ Initial guess. +++++
+	const int holoVizioWidth = static_cast<int>( holoVizioImage.Width() );
+	const int holoVizioHeight = static_cast<int>( holoVizioImage.Height() );
+	const int holoVizioDepth = static_cast<int>( holoVizioImage.Depth() );
+	const bool canWarmStart = warmStart && holoVizioWidth == width && holoVizioHeight == height && holoVizioDepth == num_projectors;
+	if ( !canWarmStart )
+	{
+		if ( !lfInterpolation.Convert_MultiView_to_HoloVizio( multiViewImage, holoVizioImage ) )
+			return false;
+	}
+	std::vector<float> x, b;
+	Image3DToVector( holoVizioImage, x );
+	Image3DToVector( multiViewImage, b );
+	const int size = static_cast<int>( x.size() );
+	if ( nonNegative )
+	{
+		// Warm start or Lanczos interpolation may be negative; iterations start from a feasible guess.
+#pragma omp parallel for
+		for ( int i = 0; i < size; ++i )
+			x[i] = std::max<float>( x[i], 0.0f );
+	}
+	// ----- Initial guess. -----
+
+	// +++++ Iterations. +++++
+	std::vector<float> r, s, p, q;
+	ApplyOperator( x, r );
+	for ( size_t i = 0; i < r.size(); ++i )
+		r[i] = b[i] - r[i];
+	ApplyOperatorTransposed( r, s );
+	p = s;
+
+	const double normB = std::max<double>( std::sqrt( DotProduct( b, b ) ), 1e-12 );
+	double gamma = DotProduct( s, s );
+	double residual = std::sqrt( DotProduct( r, r ) ) / normB;
+
+	for ( int iteration = 0; ; ++iteration )
+	{
+		const float seconds = std::chrono::duration<float>( Clock::now() - startTime ).count();
+		OptimizationLogEntry logEntry;
+		logEntry.iteration = iteration;
+		logEntry.residual = static_cast<float>( residual );
+		logEntry.seconds = seconds;
+		convergenceLog.push_back( logEntry );
+
+		if ( iteration >= maxIterations || residual < tolerance || gamma <= 0.0 )
+			break;
+		if ( timeBudget > 0.0f && seconds >= timeBudget )
+			break;
+
+		ApplyOperator( p, q );
+		const double qq = DotProduct( q, q );
+		if ( qq <= 0.0 )
+			break;
+		const float alpha = static_cast<float>( gamma / qq );
+		AddScaled( x, p, alpha );
+		if ( nonNegative )
+		{
+			// Projected Landweber step: projectors can not emit negative light.
+			// Projection breaks conjugacy, so residual is recomputed and search direction is the gradient.
+#pragma omp parallel for
+			for ( int i = 0; i < size; ++i )
+				x[i] = std::max<float>( x[i], 0.0f );
+			ApplyOperator( x, r );
+#pragma omp parallel for
+			for ( int i = 0; i < static_cast<int>( r.size() ); ++i )
+				r[i] = b[i] - r[i];
+			ApplyOperatorTransposed( r, s );
+			gamma = DotProduct( s, s );
+			p = s;
+		}
+		else
+		{
+			// CGLS step.
+			AddScaled( r, q, -alpha );
+			ApplyOperatorTransposed( r, s );
+			const double gammaNew = DotProduct( s, s );
+			const float beta = static_cast<float>( gammaNew / gamma );
+			gamma = gammaNew;
+#pragma omp parallel for
+			for ( int i = 0; i < size; ++i )
+				p[i] = s[i] + p[i]*beta;
+		}
+		residual = std::sqrt( DotProduct( r, r ) ) / normB;
+	}
+	// ----- Iterations. -----
+
+	VectorToImage3D( x, holoVizioImage );
+	return true;
+}
+
+
+
+bool ProjectorImageOptimizer::PrepareOperator()
+{
+	if ( operatorReady )
+		return true;
+
+	const int num_cameras = multiViewModel.num_cameras;
+	const int num_projectors = holoVizioModel.num_projectors;
+	const int width = holoVizioModel.image_size_x;
+	const Vec2f screenSize( holoVizioModel.screen_size_x, holoVizioModel.screen_size_y );
+	const Vec2f screenStart = -screenSize * 0.5f;
+
+	if ( num_cameras == 0 || num_projectors < 2 )
+		return false;
+	// Display model scatters light horizontally only, so projectors must form a single row.
+	if ( holoVizioModel.NumProjectorsY() != 1 )
+		return false;
+	if ( width == 0 || holoVizioModel.image_size_y == 0 )
+		return false;
+	// Perceived pixels are taken at projector pixels, so unlike conversions no spatial resampling is possible.
+	if ( multiViewModel.image_size_x != width || multiViewModel.image_size_y != holoVizioModel.image_size_y )
+		return false;
+	if ( multiViewModel.screen_size_x != screenSize.x || multiViewModel.screen_size_y != screenSize.y )
+		return false;
+
+	// +++++ Operator rows. +++++
+	rowStart.assign( 1, 0 );
+	rowProjIds.clear();
+	rowWeights.clear();
+	std::vector<int> projIds;
+	std::vector<float> weights;
+	for ( int x = 0; x < width; ++x )
+	{
+		const Vec3f screenPos = Vec3f( screenStart.x + screenSize.x*(static_cast<float>(x) + 0.5f) / width, 0.0f, 0.0f );
+		for ( int cameraId = 0; cameraId < num_cameras; ++cameraId )
+		{
+			const Vec3f cameraPos( multiViewModel.cameras_pos_x[cameraId], multiViewModel.cameras_pos_y[cameraId], multiViewModel.cameras_pos_z[cameraId] );
+			lfInterpolation.PerceivedProjectorWeights( screenPos, cameraPos, true, projIds, weights );
+			rowProjIds.insert( rowProjIds.end(), projIds.begin(), projIds.end() );
+			rowWeights.insert( rowWeights.end(), weights.begin(), weights.end() );
+			rowStart.push_back( static_cast<int>( rowProjIds.size() ) );
+		}
+	}
+	// ----- Operator rows. -----
+
+	// +++++ Transposed operator rows. +++++
+	rowStartTransposed.assign( width*num_projectors + 1, 0 );
+	for ( int x = 0; x < width; ++x )
+	{
+		for ( int row = x*num_cameras; row < (x+1)*num_cameras; ++row )
+		{
+			for ( int i = rowStart[row]; i < rowStart[row+1]; ++i )
+				++rowStartTransposed[ x*num_projectors + rowProjIds[i] + 1 ];
+		}
+	}
+	for ( size_t i = 1; i < rowStartTransposed.size(); ++i )
+		rowStartTransposed[i] += rowStartTransposed[i-1];
+	rowCameraIds.resize( rowProjIds.size() );
+	rowWeightsTransposed.resize( rowWeights.size() );
+	std::vector<int> fill( rowStartTransposed.begin(), rowStartTransposed.end()-1 );
+	for ( int x = 0; x < width; ++x )
+	{
+		for ( int cameraId = 0; cameraId < num_cameras; ++cameraId )
+		{
+			const int row = x*num_cameras + cameraId;
+			for ( int i = rowStart[row]; i < rowStart[row+1]; ++i )
+			{
+				const int target = fill[ x*num_projectors + rowProjIds[i] ]++;
+				rowCameraIds[target] = cameraId;
+				rowWeightsTransposed[target] = rowWeights[i];
+			}
+		}
+	}
+	// ----- Transposed operator rows. -----
+
+	operatorReady = true;
+	return true;
+}
+
+
+
+void ProjectorImageOptimizer::ApplyOperator( const std::vector<float>& projectors, std::vector<float>& cameras ) const
+{
+	const int num_cameras = multiViewModel.num_cameras;
+	const int width = holoVizioModel.image_size_x;
+	const int height = holoVizioModel.image_size_y;
+	const size_t layerSize = static_cast<size_t>( width ) * height * 3;
+
+	cameras.resize( layerSize * num_cameras );
+#pragma omp parallel for
+	for ( int cameraRow = 0; cameraRow < num_cameras*height; ++cameraRow )
+	{
+		const int cameraId = cameraRow / height;
+		const int y = cameraRow % height;
+		float* output = &cameras[ cameraId*layerSize + static_cast<size_t>(y)*width*3 ];
+		const float* input = &projectors[ static_cast<size_t>(y)*width*3 ];
+		for ( int x = 0; x < width; ++x )
+		{
+			const int row = x*num_cameras + cameraId;
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			for ( int i = rowStart[row]; i < rowStart[row+1]; ++i )
+			{
+				const float* color = input + rowProjIds[i]*layerSize + x*3;
+				const float weight = rowWeights[i];
+				sum[0] += color[0] * weight;
+				sum[1] += color[1] * weight;
+				sum[2] += color[2] * weight;
+			}
+			output[x*3+0] = sum[0];
+			output[x*3+1] = sum[1];
+			output[x*3+2] = sum[2];
+		}
+	}
+}
+
+
+
+void ProjectorImageOptimizer::ApplyOperatorTransposed( const std::vector<float>& cameras, std::vector<float>& projectors ) const
+{
+	const int num_projectors = holoVizioModel.num_projectors;
+	const int width = holoVizioModel.image_size_x;
+	const int height = holoVizioModel.image_size_y;
+	const size_t layerSize = static_cast<size_t>( width ) * height * 3;
+
+	projectors.resize( layerSize * num_projectors );
+#pragma omp parallel for
+	for ( int projectorRow = 0; projectorRow < num_projectors*height; ++projectorRow )
+	{
+		const int projId = projectorRow / height;
+		const int y = projectorRow % height;
+		float* output = &projectors[ projId*layerSize + static_cast<size_t>(y)*width*3 ];
+		const float* input = &cameras[ static_cast<size_t>(y)*width*3 ];
+		for ( int x = 0; x < width; ++x )
+		{
+			const int row = x*num_projectors + projId;
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			for ( int i = rowStartTransposed[row]; i < rowStartTransposed[row+1]; ++i )
+			{
+				const float* color = input + rowCameraIds[i]*layerSize + x*3;
+				const float weight = rowWeightsTransposed[i];
+				sum[0] += color[0] * weight;
+				sum[1] += color[1] * weight;
+				sum[2] += color[2] * weight;
+			}
+			output[x*3+0] = sum[0];
+			output[x*3+1] = sum[1];
+			output[x*3+2] = sum[2];
+		}
+	}
+}
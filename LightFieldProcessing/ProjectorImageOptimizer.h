@@ -0,0 +1,87 @@
+/*
+* LightFieldDisplayModel - LightFieldProcessing - ProjectorImageOptimizer
+*
+* Inverse display rendering: finds projector images, which minimize the perceived error for a set of observer positions.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef LIGHTFIELDPROCESSING_PROJECTORIMAGEOPTIMIZER_H
+#define LIGHTFIELDPROCESSING_PROJECTORIMAGEOPTIMIZER_H
+
+#include "HoloVizioModel.h"
+#include "MultiViewModel.h"
+
+#include "LightFieldInterpolation.h"
+
+#include <vector>
+
+class Image3D;
+
+
+struct OptimizationLogEntry
+{
+	int iteration = 0;
+	float residual = 0.0f; // Relative perceived error, i.e. |A*x-b|/|b|.
+	float seconds = 0.0f; // Time since the start of optimization.
+};
+
+
+// Display model (see LightFieldInterpolation::Visualize_HoloVizio_to_Camera) is a linear operator A,
+// which maps projector images x to images b perceived at the MultiView camera positions.
+// Optimizer solves least squares problem min|A*x-b| with conjugate gradient method (CGLS),
+// or with projected Landweber iterations if the solution is constrained to be non-negative.
+// Operator is sparse and depends only on the screen column, so it is precomputed once per model pair.
+
+class ProjectorImageOptimizer
+{
+public:
+	ProjectorImageOptimizer();
+	ProjectorImageOptimizer( const HoloVizioModel& holoVizioModel, const MultiViewModel& multiViewModel );
+	~ProjectorImageOptimizer();
+
+	void SetHoloVizioModel( const HoloVizioModel& holoVizioModel );
+	void SetMultiViewModel( const MultiViewModel& multiViewModel );
+
+	void SetMaxIterations( const int maxIterations ) { this->maxIterations = maxIterations; }
+	void SetTimeBudget( const float seconds ) { this->timeBudget = seconds; } // Non-positive value means no limit.
+	void SetTolerance( const float tolerance ) { this->tolerance = tolerance; }
+	void SetNonNegative( const bool nonNegative ) { this->nonNegative = nonNegative; } // Slower convergence, but no negative light.
+
+	// If warmStart is set and holoVizioImage already has proper size, it is used as initial guess
+	// (e.g., solution for the previous frame). Otherwise interpolated projector images are used.
+	bool Optimize( const Image3D& multiViewImage, Image3D& holoVizioImage, const bool warmStart = true );
+
+	const std::vector<OptimizationLogEntry>& ConvergenceLog() const { return convergenceLog; }
+
+private:
+	bool PrepareOperator();
+	void ApplyOperator( const std::vector<float>& projectors, std::vector<float>& cameras ) const;
+	void ApplyOperatorTransposed( const std::vector<float>& cameras, std::vector<float>& projectors ) const;
+
+private:
+	HoloVizioModel holoVizioModel;
+	MultiViewModel multiViewModel;
+	LightFieldInterpolation lfInterpolation;
+
+	int maxIterations;
+	float timeBudget;
+	float tolerance;
+	bool nonNegative;
+
+	// Sparse operator in CSR-like layout. Row (x,cameraId) lists projectors seen by camera at column x,
+	// transposed row (x,projId) lists cameras, which see projector at column x.
+	bool operatorReady;
+	std::vector<int> rowStart;
+	std::vector<int> rowProjIds;
+	std::vector<float> rowWeights;
+	std::vector<int> rowStartTransposed;
+	std::vector<int> rowCameraIds;
+	std::vector<float> rowWeightsTransposed;
+
+	std::vector<OptimizationLogEntry> convergenceLog;
+};
+
+#endif // LIGHTFIELDPROCESSING_PROJECTORIMAGEOPTIMIZER_H
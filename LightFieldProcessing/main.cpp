@@ -14,11 +14,15 @@
 
 #include "Image2D.h"
 #include "Image3D.h"
+#include "ImageMetrics.h"
 
 #include "LightFieldInterpolation.h"
+#include "ProjectorImageOptimizer.h"
 
 
 const bool normalizeDisplayColor = true;
+const int optimizationMaxIterations = 20;
+const AngularKernel angularKernel = AngularKernel::Linear; // Cubic or Lanczos keep more parallax for sparse rigs.
 
 
 
@@ -43,32 +47,55 @@ int main( int argc, char** argv )
 	// ----- Load HoloVizio and MultiView models. -----
 
 	// +++++ Get basic info and check if it makes sence. +++++
-	const int width = multiViewModel.screen_size_x;
-	const int height = multiViewModel.screen_size_y;
+	const int width = multiViewModel.image_size_x;
+	const int height = multiViewModel.image_size_y;
 	const int num_cameras = multiViewModel.num_cameras;
 	const int num_projectors = holoVizioModel.num_projectors;
-	const float observerDistance = holoVizioModel.observer_distance;
-	const Vec2f screenHalfSize = Vec2f( holoVizioModel.screen_size_x, holoVizioModel.screen_size_y ) * 0.5f;
 
-	if ( holoVizioModel.screen_size_x != width || holoVizioModel.screen_size_y != height )
-	{
-		std::cout << "Image size for HoloVizio and MultiView models must be equal. I quit." << std::endl;
-		return 1;
-	}
+	// Conversions resample images, but display simulation and optimization work at projector pixels.
+	const bool sameImageSizes = holoVizioModel.image_size_x == width && holoVizioModel.image_size_y == height &&
+		holoVizioModel.screen_size_x == multiViewModel.screen_size_x && holoVizioModel.screen_size_y == multiViewModel.screen_size_y;
+	if ( !sameImageSizes )
+		std::cout << "Image or screen sizes of HoloVizio and MultiView models differ, display simulation and optimization are skipped." << std::endl;
 	// ----- Get basic info and check if it makes sence. -----
 
 	Image3D multiViewImage;
 	Image3D holoVizioImage;
 	LightFieldInterpolation lfInterpolation( holoVizioModel, multiViewModel );
+	lfInterpolation.SetAngularKernel( angularKernel );
+
+	// +++++ Setup quality metrics. +++++
+	// Ray traced images serve as reference for all conversions.
+	Image3D referenceMultiViewImage;
+	Image3D referenceHoloVizioImage;
+	referenceMultiViewImage.Load( "../../output/rt_multiview/", num_cameras );
+	referenceHoloVizioImage.Load( "../../output/rt_holovizio/", num_projectors );
+	ImageMetrics imageMetrics;
+	ImageRegion centerRegion;
+	centerRegion.name = "center";
+	centerRegion.x_min = 0.25f;
+	centerRegion.y_min = 0.25f;
+	centerRegion.x_max = 0.75f;
+	centerRegion.y_max = 0.75f;
+	imageMetrics.AddRegion( centerRegion );
+	// ----- Setup quality metrics. -----
 
 	// +++++ Interpolate from HoloVizio image to MultiView image. +++++
 	std::cout << "Interpolating from HoloVizio image to MultiView image..." << std::endl;
 	multiViewImage.Clear();
 	holoVizioImage.Clear();
 	holoVizioImage.Load( "../../output/rt_holovizio/", num_projectors );
-	lfInterpolation.Convert_HoloVizio_to_MultiView( holoVizioImage, multiViewImage );
-	multiViewImage.Save( "../../output/interp_multiview/" );
-	std::cout << "Interpolating from HoloVizio image to MultiView image done." << std::endl;
+	if ( lfInterpolation.Convert_HoloVizio_to_MultiView( holoVizioImage, multiViewImage ) )
+	{
+		multiViewImage.Save( "../../output/interp_multiview/" );
+		success = imageMetrics.Compare( "interp_multiview", multiViewImage, referenceMultiViewImage ) && success;
+		std::cout << "Interpolating from HoloVizio image to MultiView image done." << std::endl;
+	}
+	else
+	{
+		std::cout << "Could not interpolate from HoloVizio image to MultiView image." << std::endl;
+		success = false;
+	}
 	// ----- Interpolate from HoloVizio image to MultiView image. -----
 
 	// +++++ Interpolate from MultiView image to HoloVizio image. +++++
@@ -76,29 +103,102 @@ int main( int argc, char** argv )
 	multiViewImage.Clear();
 	holoVizioImage.Clear();
 	multiViewImage.Load( "../../output/rt_multiview/", num_cameras );
-	lfInterpolation.Convert_MultiView_to_HoloVizio( multiViewImage, holoVizioImage );
-	holoVizioImage.Save( "../../output/interp_holovizio/" );
-	std::cout << "Interpolating from MultiView image to HoloVizio image done." << std::endl;
+	if ( lfInterpolation.Convert_MultiView_to_HoloVizio( multiViewImage, holoVizioImage ) )
+	{
+		holoVizioImage.Save( "../../output/interp_holovizio/" );
+		success = imageMetrics.Compare( "interp_holovizio", holoVizioImage, referenceHoloVizioImage ) && success;
+		std::cout << "Interpolating from MultiView image to HoloVizio image done." << std::endl;
+	}
+	else
+	{
+		std::cout << "Could not interpolate from MultiView image to HoloVizio image." << std::endl;
+		success = false;
+	}
 	// ----- Interpolate from MultiView image to HoloVizio image. -----
 
 	// +++++ Simulate HoloVizio display for MultiView camera positions. +++++
-	std::cout << "Simulating HoloVizio display for MultiView camera positions..." << std::endl;
-	multiViewImage.Clear();
-	holoVizioImage.Clear();
-	holoVizioImage.Load( "../../output/rt_holovizio/", num_projectors );
-	multiViewImage.Resize( width, height, num_cameras );
-	for ( int cameraId = 0; cameraId < num_cameras; ++cameraId )
+	if ( sameImageSizes )
 	{
-		const Vec3f cameraPos(
-			multiViewModel.cameras_pos_x.at(cameraId),
-			multiViewModel.cameras_pos_y.at(cameraId),
-			multiViewModel.cameras_pos_z.at(cameraId) );
-		success = success && lfInterpolation.Visualize_HoloVizio_to_Camera( holoVizioImage, multiViewImage.Layer(cameraId), cameraPos, normalizeDisplayColor );
+		std::cout << "Simulating HoloVizio display for MultiView camera positions..." << std::endl;
+		multiViewImage.Clear();
+		holoVizioImage.Clear();
+		holoVizioImage.Load( "../../output/rt_holovizio/", num_projectors );
+		multiViewImage.Resize( width, height, num_cameras );
+		bool visualized = true;
+		for ( int cameraId = 0; cameraId < num_cameras && visualized; ++cameraId )
+		{
+			const Vec3f cameraPos(
+				multiViewModel.cameras_pos_x.at(cameraId),
+				multiViewModel.cameras_pos_y.at(cameraId),
+				multiViewModel.cameras_pos_z.at(cameraId) );
+			visualized = lfInterpolation.Visualize_HoloVizio_to_Camera( holoVizioImage, multiViewImage.Layer(cameraId), cameraPos, normalizeDisplayColor );
+		}
+		if ( visualized )
+		{
+			multiViewImage.Save( "../../output/perceived/" );
+			success = imageMetrics.Compare( "perceived", multiViewImage, referenceMultiViewImage ) && success;
+			std::cout << "Simulating HoloVizio display for MultiView camera positions done." << std::endl;
+		}
+		else
+		{
+			std::cout << "Could not simulate HoloVizio display for MultiView camera positions." << std::endl;
+			success = false;
+		}
 	}
-	multiViewImage.Save( "../../output/perceived/" );
-	std::cout << "Simulating HoloVizio display for MultiView camera positions done." << std::endl;
 	// ----- Simulate HoloVizio display for MultiView camera positions. -----
 
+	// +++++ Optimize HoloVizio images for MultiView camera positions. +++++
+	if ( sameImageSizes )
+	{
+		std::cout << "Optimizing HoloVizio images for MultiView camera positions..." << std::endl;
+		multiViewImage.Clear();
+		holoVizioImage.Clear();
+		multiViewImage.Load( "../../output/rt_multiview/", num_cameras );
+		ProjectorImageOptimizer optimizer( holoVizioModel, multiViewModel );
+		optimizer.SetMaxIterations( optimizationMaxIterations );
+		optimizer.SetNonNegative( true );
+		bool optimized = optimizer.Optimize( multiViewImage, holoVizioImage );
+		for ( const OptimizationLogEntry& logEntry : optimizer.ConvergenceLog() )
+		{
+			std::cout << "Iteration " << logEntry.iteration << ": relative error " << logEntry.residual << ", " << logEntry.seconds << " s" << std::endl;
+		}
+		if ( optimized )
+			holoVizioImage.Save( "../../output/optimized_holovizio/" );
+		for ( int cameraId = 0; cameraId < num_cameras && optimized; ++cameraId )
+		{
+			const Vec3f cameraPos(
+				multiViewModel.cameras_pos_x.at(cameraId),
+				multiViewModel.cameras_pos_y.at(cameraId),
+				multiViewModel.cameras_pos_z.at(cameraId) );
+			optimized = lfInterpolation.Visualize_HoloVizio_to_Camera( holoVizioImage, multiViewImage.Layer(cameraId), cameraPos, normalizeDisplayColor );
+		}
+		if ( optimized )
+		{
+			multiViewImage.Save( "../../output/perceived_optimized/" );
+			success = imageMetrics.Compare( "perceived_optimized", multiViewImage, referenceMultiViewImage ) && success;
+			std::cout << "Optimizing HoloVizio images for MultiView camera positions done." << std::endl;
+		}
+		else
+		{
+			std::cout << "Could not optimize HoloVizio images for MultiView camera positions." << std::endl;
+			success = false;
+		}
+	}
+	// ----- Optimize HoloVizio images for MultiView camera positions. -----
+
+	// +++++ Save quality metrics. +++++
+	for ( const nlohmann::json& comparison : imageMetrics.Report()["comparisons"] )
+	{
+		std::cout << "Quality of " << comparison["name"].get<std::string>() << ": PSNR " << comparison["total"]["psnr"].get<float>() << " dB, SSIM " << comparison["total"]["ssim"].get<float>() << std::endl;
+	}
+	imageMetrics.SaveReport( "../../output/metrics.json" );
+	// ----- Save quality metrics. -----
+
+	if ( !success )
+	{
+		std::cout << "Some images could not be generated or compared with references." << std::endl;
+		return 1;
+	}
 	std::cout << "Program ended..." << std::endl;
 	return 0;
 }
\ No newline at end of file
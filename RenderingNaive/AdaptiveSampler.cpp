@@ -0,0 +1,115 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - AdaptiveSampler
+*
+* Chooses pixels for adaptive anti-aliasing and the number of samples for them, within a sample budget.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "AdaptiveSampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+
+const float default_contrast_threshold = 0.05f;
+const float default_sample_budget = 1.0f;
+const int max_strata = 4; // 4 x 4 samples for the most contrast pixels, 2 x 2 for the rest.
+const float max_strata_contrast = 4.0f; // Relative to the threshold.
+
+
+
+AdaptiveSampler::AdaptiveSampler()
+	:contrastThreshold( default_contrast_threshold )
+	,sampleBudget( default_sample_budget )
+{
+
+}
+
+
+
+bool AdaptiveSampler::SetContrastThreshold( const float contrastThreshold )
+{
+	if ( contrastThreshold <= 0.0f )
+		return false;
+	this->contrastThreshold = contrastThreshold;
+	return true;
+}
+
+
+
+bool AdaptiveSampler::SetSampleBudget( const float sampleBudget )
+{
+	if ( sampleBudget < 0.0f )
+		return false;
+	this->sampleBudget = sampleBudget;
+	return true;
+}
+
+
+
+size_t AdaptiveSampler::Plan( const Image2D& image, std::vector<unsigned char>& pixelStrata ) const
+{
+	const int width = static_cast<int>( image.Width() );
+	const int height = static_cast<int>( image.Height() );
+	const Vec3f* data = image.Data();
+	pixelStrata.assign( static_cast<size_t>( width )*height, 1 );
+
+	// +++++ Contrast of pixels with their neighbours. +++++
+	std::vector<std::pair<float, int>> candidates; // Contrast and pixel index.
+	for ( int y = 0; y < height; ++y )
+	{
+		for ( int x = 0; x < width; ++x )
+		{
+			const Vec3f& center = data[ static_cast<size_t>( y )*width + x ];
+			float contrast = 0.0f;
+			for ( int ny = std::max( y-1, 0 ); ny <= std::min( y+1, height-1 ); ++ny )
+			{
+				for ( int nx = std::max( x-1, 0 ); nx <= std::min( x+1, width-1 ); ++nx )
+				{
+					const Vec3f& neighbour = data[ static_cast<size_t>( ny )*width + nx ];
+					for ( int c = 0; c < 3; ++c )
+						contrast = std::max( contrast, std::abs( std::min( std::max( center[c], 0.0f ), 1.0f ) - std::min( std::max( neighbour[c], 0.0f ), 1.0f ) ) );
+				}
+			}
+			if ( contrast > contrastThreshold )
+				candidates.push_back( std::make_pair( contrast, y*width + x ) );
+		}
+	}
+	// ----- Contrast of pixels with their neighbours. -----
+
+	// +++++ Spend the budget on the most contrast pixels first. +++++
+	std::sort( candidates.begin(), candidates.end(), []( const std::pair<float, int>& a, const std::pair<float, int>& b ) { return a.first > b.first || (a.first == b.first && a.second < b.second); } );
+	double budget = static_cast<double>( sampleBudget ) * width * height;
+	size_t numSamples = 0;
+	for ( const std::pair<float, int>& candidate : candidates )
+	{
+		int strata = candidate.first > max_strata_contrast * contrastThreshold ? max_strata : 2;
+		if ( strata*strata > budget )
+			strata = 2;
+		if ( strata*strata > budget )
+			break;
+		budget -= strata*strata;
+		numSamples += strata*strata;
+		pixelStrata[ candidate.second ] = static_cast<unsigned char>( strata );
+	}
+	// ----- Spend the budget on the most contrast pixels first. -----
+
+	return numSamples;
+}
+
+
+
+void AdaptiveSampler::SampleCountImage( const std::vector<unsigned char>& pixelStrata, const int width, const int height, Image2D& image )
+{
+	image.Resize( width, height );
+	const float scale = 1.0f / (max_strata*max_strata);
+	for ( size_t i = 0; i < pixelStrata.size() && i < static_cast<size_t>( width )*height; ++i )
+	{
+		const float count = static_cast<float>( pixelStrata[i]*pixelStrata[i] ) * scale;
+		image.Data()[i] = Vec3f( count, count, count );
+	}
+}
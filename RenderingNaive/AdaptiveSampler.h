@@ -0,0 +1,43 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - AdaptiveSampler
+*
+* Chooses pixels for adaptive anti-aliasing and the number of samples for them, within a sample budget.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_ADAPTIVESAMPLER_H
+#define RENDERINGNAIVE_ADAPTIVESAMPLER_H
+
+#include <vector>
+
+#include "Image2D.h"
+
+
+// Image is first rendered with one sample per pixel (at the pixel center). Contrast of a pixel is the maximal difference
+// with its 8 neighbours (per channel, after clamping to [0, 1] as on the display). Pixels of high contrast are rendered
+// again with n x n jittered samples (stratified, one sample per cell of n x n grid), the most contrast ones first,
+// while the budget of additional samples allows. Number of strata n is stored per pixel, 1 means the pixel is not refined.
+
+class AdaptiveSampler
+{
+public:
+	AdaptiveSampler();
+
+	bool SetContrastThreshold( const float contrastThreshold );
+	bool SetSampleBudget( const float sampleBudget ); // Additional samples per image, relative to the number of pixels.
+
+	// Fills number of strata per pixel from the image, rendered with one sample per pixel. Returns number of additional samples.
+	size_t Plan( const Image2D& image, std::vector<unsigned char>& pixelStrata ) const;
+
+	// Debug image of the sampling cost: number of samples per pixel, divided by the maximal possible number.
+	static void SampleCountImage( const std::vector<unsigned char>& pixelStrata, const int width, const int height, Image2D& image );
+
+private:
+	float contrastThreshold;
+	float sampleBudget;
+};
+
+#endif // RENDERINGNAIVE_ADAPTIVESAMPLER_H
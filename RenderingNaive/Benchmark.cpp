@@ -0,0 +1,479 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - Benchmark
+*
+* Ray tracing throughput for scenes of different complexity (spheres, boxes, triangle meshes and their instances).
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "FrameSequenceRenderer.h"
+#include "MeshLoader.h"
+#include "RayTracer.h"
+#include "SceneAnimation.h"
+#include "SceneLoader.h"
+#include "SceneModel.h"
+#include "TileScheduler.h"
+
+
+const int benchmark_width = 1000;
+const int benchmark_height = 600;
+const int benchmark_repetitions = 3;
+const Vec2f benchmark_screen_half_size( 500.0f, 300.0f );
+const Vec3f benchmark_camera_pos( 0.0f, 0.0f, 1500.0f );
+const int benchmark_ray_sort_batch = 4096;
+const float benchmark_light_radius = 800.0f;
+const int benchmark_light_samples = 4;
+const int benchmark_animated_spheres = 10;
+const int benchmark_animation_frames = 8;
+
+
+// Checkerboard floor below the scene, the same as in the sample scene.
+void AddCheckerboardFloor( RayTracer& rayTracer )
+{
+	Quad floor( Vec3f( 0.0f, -200.0f, 0.0f ), Vec3f( 1.0f, 0.0f, 0.0f ), Vec3f( 0.0f, 0.0f, 1.0f ), Vec2f( 1000.0f, 1000.0f ),
+		rayTracer.AddMaterial( Material( 1.0f, Vec4f( 1.0f, 0.0f, 0.0f, 0.0f ), Vec3f( 0.3f, 0.3f, 0.3f ), 0.0f ) ) );
+	floor.checker_material_id = rayTracer.AddMaterial( Material( 1.0f, Vec4f( 1.0f, 0.0f, 0.0f, 0.0f ), Vec3f( 0.3f, 0.2f, 0.1f ), 0.0f ) );
+	floor.checker_cell_size = 200.0f;
+	floor.checker_offset = Vec2f( 1000.0f, 0.0f );
+	rayTracer.AddQuad( floor );
+}
+
+
+
+// Random spheres fill the volume behind the screen with roughly the same density of projected area.
+void SetupRandomScene( RayTracer& rayTracer, const int numSpheres )
+{
+	std::mt19937 generator( 12345 );
+	std::uniform_real_distribution<float> distributionX( -500.0f, 500.0f );
+	std::uniform_real_distribution<float> distributionY( -300.0f, 300.0f );
+	std::uniform_real_distribution<float> distributionZ( -1000.0f, 0.0f );
+	std::uniform_real_distribution<float> distributionColor( 0.1f, 0.9f );
+	const float radius = 200.0f / std::cbrt( static_cast<float>( numSpheres ) );
+
+	rayTracer.RemoveAllGeometry();
+	rayTracer.RemoveAllLights();
+	for ( int i = 0; i < numSpheres; ++i )
+	{
+		const Vec3f center( distributionX( generator ), distributionY( generator ), distributionZ( generator ) );
+		const Vec3f color( distributionColor( generator ), distributionColor( generator ), distributionColor( generator ) );
+		rayTracer.AddSphere( Sphere( center, radius, rayTracer.AddMaterial( Material( 1.0f, Vec4f( 0.6f, 0.3f, 0.1f, 0.0f ), color, 50.0f ) ) ) );
+	}
+	AddCheckerboardFloor( rayTracer );
+}
+
+
+
+// Random boxes, like random spheres of SetupRandomScene.
+void SetupRandomBoxes( RayTracer& rayTracer, const int numBoxes )
+{
+	std::mt19937 generator( 12345 );
+	std::uniform_real_distribution<float> distributionX( -500.0f, 500.0f );
+	std::uniform_real_distribution<float> distributionY( -300.0f, 300.0f );
+	std::uniform_real_distribution<float> distributionZ( -1000.0f, 0.0f );
+	std::uniform_real_distribution<float> distributionColor( 0.1f, 0.9f );
+	const float halfSize = 160.0f / std::cbrt( static_cast<float>( numBoxes ) );
+
+	rayTracer.RemoveAllGeometry();
+	rayTracer.RemoveAllLights();
+	for ( int i = 0; i < numBoxes; ++i )
+	{
+		const Vec3f center( distributionX( generator ), distributionY( generator ), distributionZ( generator ) );
+		const Vec3f color( distributionColor( generator ), distributionColor( generator ), distributionColor( generator ) );
+		const Vec3f extent( halfSize, halfSize, halfSize );
+		rayTracer.AddBox( Box( center - extent, center + extent, rayTracer.AddMaterial( Material( 1.0f, Vec4f( 0.6f, 0.3f, 0.1f, 0.0f ), color, 50.0f ) ) ) );
+	}
+	AddCheckerboardFloor( rayTracer );
+}
+
+
+
+// Latitude-longitude tessellation of a sphere with 2*numSegments*numSegments/2 triangles.
+TriangleMesh TessellatedSphere( const int numSegments, const Vec3f& center, const float radius )
+{
+	const float pi = 3.14159265358979f;
+	const int numRings = numSegments / 2;
+	TriangleMesh mesh;
+	for ( int ring = 0; ring <= numRings; ++ring )
+	{
+		const float theta = pi * ring / numRings;
+		for ( int segment = 0; segment <= numSegments; ++segment )
+		{
+			const float phi = 2.0f * pi * segment / numSegments;
+			const Vec3f normal( std::sin( theta )*std::cos( phi ), std::cos( theta ), -std::sin( theta )*std::sin( phi ) );
+			mesh.vertices.push_back( center + normal*radius );
+			mesh.normals.push_back( normal );
+		}
+	}
+	for ( int ring = 0; ring < numRings; ++ring )
+	{
+		for ( int segment = 0; segment < numSegments; ++segment )
+		{
+			const int v00 = ring*(numSegments+1) + segment;
+			const int v10 = v00 + numSegments + 1;
+			mesh.triangles.push_back( Vec3i( v00, v10, v00+1 ) );
+			mesh.triangles.push_back( Vec3i( v00+1, v10, v10+1 ) );
+		}
+	}
+	return mesh;
+}
+
+
+
+void SetupTessellatedSphere( RayTracer& rayTracer, const int numSegments )
+{
+	rayTracer.RemoveAllGeometry();
+	rayTracer.RemoveAllLights();
+	rayTracer.AddMesh( TessellatedSphere( numSegments, Vec3f( 0.0f, 0.0f, -300.0f ), 300.0f ),
+		rayTracer.AddMaterial( Material( 1.0f, Vec4f( 0.6f, 0.3f, 0.1f, 0.0f ), Vec3f( 0.4f, 0.4f, 0.3f ), 50.0f ) ) );
+	AddCheckerboardFloor( rayTracer );
+}
+
+
+
+// Grid of numCopies x numCopies instances of one tessellated sphere, stretched and rotated differently; the mesh is stored once.
+void SetupInstancedSpheres( RayTracer& rayTracer, const int numSegments, const int numCopies )
+{
+	rayTracer.RemoveAllGeometry();
+	rayTracer.RemoveAllLights();
+	const int meshId = rayTracer.AddSharedMesh( TessellatedSphere( numSegments, Vec3f( 0.0f, 0.0f, 0.0f ), 1.0f ) );
+	const int materialId = rayTracer.AddMaterial( Material( 1.0f, Vec4f( 0.6f, 0.3f, 0.1f, 0.0f ), Vec3f( 0.4f, 0.4f, 0.3f ), 50.0f ) );
+	const float spacing = 1000.0f / numCopies;
+	for ( int y = 0; y < numCopies; ++y )
+	{
+		for ( int x = 0; x < numCopies; ++x )
+		{
+			const float angle = 0.3f * (x + y*numCopies);
+			const float radius = 0.4f * spacing;
+			const Vec3f axisX( std::cos( angle )*radius, 0.0f, -std::sin( angle )*radius );
+			const Vec3f axisY( 0.0f, 0.6f*radius, 0.0f );
+			const Vec3f axisZ( std::sin( angle )*radius, 0.0f, std::cos( angle )*radius );
+			const Vec3f position( -500.0f + spacing*(x + 0.5f), -300.0f + 0.6f*spacing*(y + 0.5f), -300.0f - 0.5f*spacing*y );
+			rayTracer.AddInstance( Instance( meshId, materialId, position, axisX, axisY, axisZ ) );
+		}
+	}
+	AddCheckerboardFloor( rayTracer );
+}
+
+
+
+// Renders the image in the wavefront mode, tile by tile as the main program does; returns seconds.
+double RenderWavefront( RayTracer& rayTracer, const int raySortBatch, Image2D& image )
+{
+	typedef std::chrono::steady_clock Clock;
+	std::vector<RenderView> views( 1 );
+	views[0].image = &image;
+	views[0].position = benchmark_camera_pos;
+	views[0].screen_half_size = benchmark_screen_half_size;
+	TileScheduler tileScheduler;
+	tileScheduler.SetProgressReport( false );
+	rayTracer.SetWavefront( true );
+	rayTracer.SetRaySortBatch( raySortBatch );
+	rayTracer.ResetDepthStatistics();
+	const Clock::time_point startTime = Clock::now();
+	tileScheduler.Render( rayTracer, views );
+	const double seconds = std::chrono::duration<double>( Clock::now() - startTime ).count();
+	rayTracer.SetWavefront( false );
+	return seconds;
+}
+
+
+
+float MaxDifference( const Image2D& image, const Image2D& otherImage )
+{
+	float difference = 0.0f;
+	for ( size_t k = 0; k < static_cast<size_t>( image.Width() ) * image.Height(); ++k )
+	{
+		for ( size_t channel = 0; channel < 3; ++channel )
+			difference = std::max( difference, std::fabs( image.Data()[k][channel] - otherImage.Data()[k][channel] ) );
+	}
+	return difference;
+}
+
+
+
+void RunBenchmark( RayTracer& rayTracer, const std::string& sceneName )
+{
+	typedef std::chrono::steady_clock Clock;
+	Image2D image( benchmark_width, benchmark_height );
+
+	// +++++ Build acceleration structure. +++++
+	Clock::time_point startTime = Clock::now();
+	rayTracer.UpdateAccelerationStructure();
+	const double buildSeconds = std::chrono::duration<double>( Clock::now() - startTime ).count();
+	// ----- Build acceleration structure. -----
+
+	// +++++ Primary rays only. +++++
+	// With zero ray depth every pixel casts exactly one ray (secondary rays are cut before intersection).
+	rayTracer.SetMaxRayDepth( 0 );
+	double primarySeconds[2];
+	for ( int packetTracing = 0; packetTracing < 2; ++packetTracing )
+	{
+		rayTracer.SetPacketTracing( packetTracing != 0 );
+		startTime = Clock::now();
+		for ( int repetition = 0; repetition < benchmark_repetitions; ++repetition )
+			rayTracer.RenderPinhole( image, benchmark_camera_pos, benchmark_screen_half_size );
+		primarySeconds[packetTracing] = std::chrono::duration<double>( Clock::now() - startTime ).count() / benchmark_repetitions;
+	}
+	// ----- Primary rays only. -----
+
+	// +++++ Full shading. +++++
+	rayTracer.AddLight( Light( Vec3f( -1000.0f, 1000.0f, 1000.0f ), 1.5f ) );
+	rayTracer.SetMaxRayDepth( 4 );
+	startTime = Clock::now();
+	rayTracer.RenderPinhole( image, benchmark_camera_pos, benchmark_screen_half_size );
+	const double shadedSeconds = std::chrono::duration<double>( Clock::now() - startTime ).count();
+	// ----- Full shading. -----
+
+	// +++++ Full shading, wavefront without and with sorting of secondary rays, checked against the recursive image. +++++
+	Image2D wavefrontImage( benchmark_width, benchmark_height );
+	double wavefrontSeconds[2];
+	float wavefrontError[2];
+	std::vector<WavefrontDepthStatistics> depthStatistics[2];
+	for ( int sorting = 0; sorting < 2; ++sorting )
+	{
+		wavefrontSeconds[sorting] = RenderWavefront( rayTracer, sorting != 0 ? benchmark_ray_sort_batch : 0, wavefrontImage );
+		wavefrontError[sorting] = MaxDifference( wavefrontImage, image );
+		depthStatistics[sorting] = rayTracer.DepthStatistics();
+	}
+	rayTracer.SetRaySortBatch( 0 );
+	// ----- Full shading, wavefront without and with sorting of secondary rays, checked against the recursive image. -----
+
+	const double numRays = static_cast<double>( benchmark_width ) * benchmark_height;
+	std::cout << sceneName
+		<< ", BVH build: " << buildSeconds*1000.0 << " ms"
+		<< ", primary rays: " << numRays / primarySeconds[0] / 1e6 << " Mrays/s (single), " << numRays / primarySeconds[1] / 1e6 << " Mrays/s (packets)"
+		<< ", shaded image: " << shadedSeconds*1000.0 << " ms"
+		<< ", wavefront: " << wavefrontSeconds[0]*1000.0 << " ms (max difference " << wavefrontError[0] << ")"
+		<< ", sorted wavefront: " << wavefrontSeconds[1]*1000.0 << " ms (max difference " << wavefrontError[1] << ")" << std::endl;
+	// Intersection throughput per depth shows how much the sorting restores coherence (and cache hits) of secondary rays.
+	for ( size_t depth = 0; depth < depthStatistics[0].size() && depthStatistics[0][depth].rays > 0; ++depth )
+	{
+		const WavefrontDepthStatistics& unsorted = depthStatistics[0][depth];
+		const WavefrontDepthStatistics& sorted = depthStatistics[1][depth];
+		std::cout << "  depth " << depth << ": " << unsorted.rays << " rays, "
+			<< unsorted.rays / unsorted.intersect_seconds / 1e6 << " Mrays/s (unsorted), "
+			<< sorted.rays / sorted.intersect_seconds / 1e6 << " Mrays/s (sorted, sorting " << sorted.sort_seconds*1000.0 << " ms)" << std::endl;
+	}
+}
+
+
+
+// Wall of lights in front of the scene (like an LED wall), with the same total intensity for any number of lights.
+void SetupLightWall( RayTracer& rayTracer, const int numLightsX, const int numLightsY, const float radius )
+{
+	rayTracer.RemoveAllLights();
+	const float intensity = 16.0f * 1.5f / (numLightsX * numLightsY);
+	for ( int y = 0; y < numLightsY; ++y )
+	{
+		for ( int x = 0; x < numLightsX; ++x )
+		{
+			const Vec3f position( -500.0f + 1000.0f * (x + 0.5f) / numLightsX, -300.0f + 600.0f * (y + 0.5f) / numLightsY, 200.0f );
+			rayTracer.AddLight( Light( position, intensity, radius ) );
+		}
+	}
+}
+
+
+
+// Shading cost of many lights: all lights of unlimited radius, lights of limited radius culled by the light grid,
+// and a fixed number of sampled lights among the culled ones. Image is smaller than in RunBenchmark, since all lights are slow.
+void RunLightsBenchmark( RayTracer& rayTracer )
+{
+	typedef std::chrono::steady_clock Clock;
+	Image2D image( benchmark_width / 4, benchmark_height / 4 );
+	const int lightWalls[][2] = { { 4, 4 }, { 16, 16 } };
+	rayTracer.SetMaxRayDepth( 4 );
+	for ( const auto& lightWall : lightWalls )
+	{
+		double seconds[3];
+		for ( int mode = 0; mode < 3; ++mode )
+		{
+			SetupLightWall( rayTracer, lightWall[0], lightWall[1], mode == 0 ? 0.0f : benchmark_light_radius );
+			rayTracer.SetLightSamples( mode == 2 ? benchmark_light_samples : 0 );
+			rayTracer.UpdateAccelerationStructure();
+			const Clock::time_point startTime = Clock::now();
+			rayTracer.RenderPinhole( image, benchmark_camera_pos, benchmark_screen_half_size );
+			seconds[mode] = std::chrono::duration<double>( Clock::now() - startTime ).count();
+		}
+		rayTracer.SetLightSamples( 0 );
+		std::cout << "Lights: " << lightWall[0] * lightWall[1]
+			<< ", shaded image: " << seconds[0]*1000.0 << " ms (all lights), " << seconds[1]*1000.0 << " ms (culled lights), "
+			<< seconds[2]*1000.0 << " ms (" << benchmark_light_samples << " sampled lights)" << std::endl;
+	}
+}
+
+
+
+// Random spheres of SetupRandomScene as a scene model, where a few spheres move along their keyframes. Materials reflect
+// no rays, so pixels end at their primary hits, and tiles away from moving spheres and their shadows can be reused.
+void SetupAnimatedScene( SceneModel& sceneModel, const int numSpheres, const int numMoving )
+{
+	std::mt19937 generator( 12345 );
+	std::uniform_real_distribution<float> distributionX( -500.0f, 500.0f );
+	std::uniform_real_distribution<float> distributionY( -300.0f, 300.0f );
+	std::uniform_real_distribution<float> distributionZ( -1000.0f, 0.0f );
+	const float radius = 200.0f / std::cbrt( static_cast<float>( numSpheres ) );
+
+	sceneModel.Clear();
+	sceneModel.materials.resize( 4 );
+	sceneModel.materials[0].name = "matte";
+	sceneModel.materials[0].albedo = Vec4f( 0.9f, 0.1f, 0.0f, 0.0f );
+	sceneModel.materials[0].diffuse_color = Vec3f( 0.3f, 0.1f, 0.1f );
+	sceneModel.materials[0].specular_exponent = 10.0f;
+	sceneModel.materials[1].name = "satin";
+	sceneModel.materials[1].albedo = Vec4f( 0.6f, 0.3f, 0.0f, 0.0f );
+	sceneModel.materials[1].diffuse_color = Vec3f( 0.4f, 0.4f, 0.3f );
+	sceneModel.materials[1].specular_exponent = 50.0f;
+	sceneModel.materials[2].name = "checker_light";
+	sceneModel.materials[2].diffuse_color = Vec3f( 0.3f, 0.3f, 0.3f );
+	sceneModel.materials[3].name = "checker_dark";
+	sceneModel.materials[3].diffuse_color = Vec3f( 0.3f, 0.2f, 0.1f );
+	sceneModel.spheres.resize( numSpheres );
+	for ( int i = 0; i < numSpheres; ++i )
+	{
+		sceneModel.spheres[i].center = Vec3f( distributionX( generator ), distributionY( generator ), distributionZ( generator ) );
+		sceneModel.spheres[i].radius = radius;
+		sceneModel.spheres[i].material_id = i % 2;
+	}
+	// Moving spheres are spread over the scene and rise by a few radii.
+	for ( int i = 0; i < numMoving; ++i )
+	{
+		std::vector<SceneKeyframe>& keyframes = sceneModel.spheres[ static_cast<size_t>( i ) * numSpheres / numMoving ].keyframes;
+		keyframes.resize( 2 );
+		keyframes[1].frame = benchmark_animation_frames - 1;
+		keyframes[1].offset = Vec3f( 0.0f, 4.0f * radius, 0.0f );
+	}
+	sceneModel.quads.resize( 1 );
+	sceneModel.quads[0].center = Vec3f( 0.0f, -200.0f, 0.0f );
+	sceneModel.quads[0].half_size = Vec2f( 1000.0f, 1000.0f );
+	sceneModel.quads[0].material_id = 2;
+	sceneModel.quads[0].checker_material_id = 3;
+	sceneModel.quads[0].checker_cell_size = 200.0f;
+	sceneModel.quads[0].checker_offset = Vec2f( 1000.0f, 0.0f );
+	sceneModel.lights.resize( 1 );
+	sceneModel.lights[0].position = Vec3f( -1000.0f, 1000.0f, 1000.0f );
+	sceneModel.lights[0].intensity = 1.5f;
+}
+
+
+
+// Frames of an animation with reuse of unchanged tiles, checked against the same frames rendered in full,
+// and the refit of the scene BVH after the moves of a frame against the build of the whole BVH.
+void RunAnimationBenchmark( RayTracer& rayTracer, const int numSpheres )
+{
+	typedef std::chrono::steady_clock Clock;
+	SceneModel sceneModel;
+	SetupAnimatedScene( sceneModel, numSpheres, benchmark_animated_spheres );
+	SceneAnimation animation;
+	animation.Setup( sceneModel );
+	rayTracer.RemoveAllGeometry();
+	rayTracer.RemoveAllLights();
+	SceneLoader::Setup( sceneModel, std::string(), rayTracer );
+	rayTracer.SetMaxRayDepth( 4 );
+
+	Clock::time_point startTime = Clock::now();
+	rayTracer.UpdateAccelerationStructure();
+	const double buildSeconds = std::chrono::duration<double>( Clock::now() - startTime ).count();
+
+	Image2D image( benchmark_width, benchmark_height ), fullImage( benchmark_width, benchmark_height );
+	std::vector<RenderView> views( 1 ), fullViews( 1 );
+	views[0].image = &image;
+	views[0].position = benchmark_camera_pos;
+	views[0].screen_half_size = benchmark_screen_half_size;
+	fullViews[0] = views[0];
+	fullViews[0].image = &fullImage;
+	FrameSequenceRenderer frameRenderer, fullRenderer;
+	fullRenderer.SetTileReuse( false );
+	double refitSeconds = 0.0, frameSeconds = 0.0, fullSeconds = 0.0;
+	int reusedTiles = 0, numTiles = 0;
+	float difference = 0.0f;
+	for ( int frame = 0; frame < benchmark_animation_frames; ++frame )
+	{
+		// The full renderer applies the same frame again, so it finds nothing to move.
+		startTime = Clock::now();
+		animation.Apply( frame, rayTracer );
+		rayTracer.UpdateAccelerationStructure();
+		refitSeconds += std::chrono::duration<double>( Clock::now() - startTime ).count();
+		frameRenderer.RenderFrame( rayTracer, animation, frame, views );
+		fullRenderer.RenderFrame( rayTracer, animation, frame, fullViews );
+		// The first frame is rendered in full by both.
+		if ( frame > 0 )
+		{
+			frameSeconds += frameRenderer.Seconds();
+			fullSeconds += fullRenderer.Seconds();
+			reusedTiles += frameRenderer.ReusedTiles();
+			numTiles += frameRenderer.NumTiles();
+		}
+		difference = std::max( difference, MaxDifference( image, fullImage ) );
+	}
+
+	const int numMovingFrames = benchmark_animation_frames - 1;
+	std::cout << "Animation: " << benchmark_animated_spheres << " of " << numSpheres << " spheres moving"
+		<< ", BVH build: " << buildSeconds*1000.0 << " ms, refit: " << refitSeconds / benchmark_animation_frames * 1000.0 << " ms"
+		<< ", frame: " << frameSeconds / numMovingFrames * 1000.0 << " ms (" << 100.0 * reusedTiles / std::max( numTiles, 1 ) << "% tiles reused)"
+		<< ", full frame: " << fullSeconds / numMovingFrames * 1000.0 << " ms (max difference " << difference << ")" << std::endl;
+}
+
+
+
+// Optional argument is a mesh file (OBJ or PLY) to benchmark in addition to generated scenes.
+int main( int argc, char** argv )
+{
+	std::cout << "Program started..." << std::endl << std::endl;
+
+	const int sceneSizes[] = { 10, 1000, 100000 };
+
+	RayTracer rayTracer;
+	for ( const int numSpheres : sceneSizes )
+	{
+		SetupRandomScene( rayTracer, numSpheres );
+		RunBenchmark( rayTracer, "Spheres: " + std::to_string( numSpheres ) );
+	}
+
+	SetupRandomScene( rayTracer, 1000 );
+	RunLightsBenchmark( rayTracer );
+
+	RunAnimationBenchmark( rayTracer, 100000 );
+
+	SetupRandomBoxes( rayTracer, 1000 );
+	RunBenchmark( rayTracer, "Boxes: 1000" );
+
+	SetupTessellatedSphere( rayTracer, 1000 );
+	RunBenchmark( rayTracer, "Triangles: 1000000" );
+
+	SetupInstancedSpheres( rayTracer, 200, 10 );
+	RunBenchmark( rayTracer, "Instances: 100 x 20000 triangles (one stored mesh)" );
+
+	if ( argc > 1 )
+	{
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point startTime = Clock::now();
+		TriangleMesh mesh;
+		if ( MeshLoader::Load( argv[1], mesh ) )
+		{
+			const double loadSeconds = std::chrono::duration<double>( Clock::now() - startTime ).count();
+			std::cout << "Loaded " << argv[1] << " in " << loadSeconds*1000.0 << " ms" << std::endl;
+			rayTracer.RemoveAllGeometry();
+			rayTracer.RemoveAllLights();
+			rayTracer.AddMesh( mesh, rayTracer.AddMaterial( Material( 1.0f, Vec4f( 0.6f, 0.3f, 0.1f, 0.0f ), Vec3f( 0.4f, 0.4f, 0.3f ), 50.0f ) ) );
+			AddCheckerboardFloor( rayTracer );
+			RunBenchmark( rayTracer, "Triangles: " + std::to_string( mesh.triangles.size() ) );
+		}
+		else
+		{
+			std::cout << "Could not load mesh " << argv[1] << "." << std::endl;
+		}
+	}
+
+	std::cout << std::endl << "Program ended..." << std::endl;
+	return 0;
+}
@@ -0,0 +1,86 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - BinaryStream
+*
+* Raw binary reading, writing and hashing of plain values and vectors of plain values (for caches on the same machine).
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_BINARYSTREAM_H
+#define RENDERINGNAIVE_BINARYSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+
+template<typename ValueType>
+inline bool WriteBinary( std::ostream& stream, const ValueType& value )
+{
+	stream.write( reinterpret_cast<const char*>( &value ), sizeof( ValueType ) );
+	return !!stream;
+}
+
+template<typename ValueType>
+inline bool ReadBinary( std::istream& stream, ValueType& value )
+{
+	stream.read( reinterpret_cast<char*>( &value ), sizeof( ValueType ) );
+	return !!stream;
+}
+
+// Vectors are stored as 64-bit size followed by elements.
+template<typename ValueType>
+inline bool WriteBinaryVector( std::ostream& stream, const std::vector<ValueType>& values )
+{
+	const uint64_t size = values.size();
+	WriteBinary( stream, size );
+	if ( size > 0 )
+		stream.write( reinterpret_cast<const char*>( values.data() ), size * sizeof( ValueType ) );
+	return !!stream;
+}
+
+template<typename ValueType>
+inline bool ReadBinaryVector( std::istream& stream, std::vector<ValueType>& values )
+{
+	uint64_t size = 0;
+	if ( !ReadBinary( stream, size ) )
+		return false;
+	// Check the size against the rest of the stream, so a corrupted file does not cause a huge allocation.
+	const std::streampos position = stream.tellg();
+	stream.seekg( 0, std::ios::end );
+	const std::streamoff remaining = stream.tellg() - position;
+	stream.seekg( position );
+	if ( position < 0 || size > static_cast<uint64_t>( remaining ) / sizeof( ValueType ) )
+	{
+		stream.setstate( std::ios::failbit );
+		return false;
+	}
+	values.resize( static_cast<size_t>( size ) );
+	if ( size > 0 )
+		stream.read( reinterpret_cast<char*>( values.data() ), size * sizeof( ValueType ) );
+	return !!stream;
+}
+
+// FNV-1a hash of raw bytes of plain values, continued from the given hash (e.g., for keys of caches).
+const uint64_t binary_hash_seed = 14695981039346656037ull;
+
+template<typename ValueType>
+inline uint64_t HashBinary( uint64_t hash, const ValueType* values, const size_t count )
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>( values );
+	for ( size_t i = 0; i < count * sizeof( ValueType ); i++ )
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+template<typename ValueType>
+inline uint64_t HashBinary( const uint64_t hash, const ValueType& value )
+{
+	return HashBinary( hash, &value, 1 );
+}
+
+#endif // RENDERINGNAIVE_BINARYSTREAM_H
@@ -0,0 +1,292 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - Bvh
+*
+* Bounding volume hierarchy (SAH-built, flattened into a node array) for ray queries.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "Bvh.h"
+
+#include <numeric>
+
+#include "BinaryStream.h"
+
+
+// Binned surface area heuristic: cost = traversal_cost + sum( area(child)/area(node) * count(child) ) in primitive tests.
+const int sah_num_bins = 16;
+const float sah_traversal_cost = 1.0f;
+const int max_leaf_size = 4; // Larger leaves are split whenever possible.
+const int max_leaf_size_sah = 16; // Leaves up to this size are kept, if splitting them is not profitable.
+const int max_build_depth = 64; // Must not exceed traversal stack size.
+
+
+
+void Aabb::Grow( const Vec3f& point )
+{
+	min_corner = Vec3f( std::min( min_corner.x, point.x ), std::min( min_corner.y, point.y ), std::min( min_corner.z, point.z ) );
+	max_corner = Vec3f( std::max( max_corner.x, point.x ), std::max( max_corner.y, point.y ), std::max( max_corner.z, point.z ) );
+}
+
+
+
+void Aabb::Grow( const Aabb& box )
+{
+	Grow( box.min_corner );
+	Grow( box.max_corner );
+}
+
+
+
+float Aabb::SurfaceArea() const
+{
+	if ( IsEmpty() )
+		return 0.0f;
+	const Vec3f extent = max_corner - min_corner;
+	return 2.0f * (extent.x*extent.y + extent.y*extent.z + extent.z*extent.x);
+}
+
+
+
+Bvh::Bvh()
+{
+
+}
+
+
+
+Bvh::~Bvh()
+{
+
+}
+
+
+
+void Bvh::Clear()
+{
+	nodes.clear();
+	primitiveIds.clear();
+	nodeParents.clear();
+	primitiveLeaves.clear();
+	refitMarks.clear();
+}
+
+
+
+void Bvh::Build( const std::vector<Aabb>& primitiveBounds )
+{
+	Clear();
+	const int numPrimitives = static_cast<int>( primitiveBounds.size() );
+	if ( numPrimitives == 0 )
+		return;
+
+	primitiveIds.resize( numPrimitives );
+	std::iota( primitiveIds.begin(), primitiveIds.end(), 0 );
+	std::vector<Vec3f> centroids( numPrimitives );
+	for ( int i = 0; i < numPrimitives; ++i )
+		centroids[i] = primitiveBounds[i].Center();
+
+	nodes.reserve( 2*numPrimitives );
+	BuildNode( primitiveBounds, centroids, 0, numPrimitives, 0 );
+	nodes.shrink_to_fit();
+}
+
+
+
+Aabb Bvh::Bounds() const
+{
+	if ( nodes.empty() )
+		return Aabb();
+	return Aabb( nodes[0].bounds_min, nodes[0].bounds_max );
+}
+
+
+
+bool Bvh::Write( std::ostream& stream ) const
+{
+	return WriteBinaryVector( stream, nodes ) && WriteBinaryVector( stream, primitiveIds );
+}
+
+
+
+bool Bvh::Read( std::istream& stream )
+{
+	Clear();
+	if ( !ReadBinaryVector( stream, nodes ) || !ReadBinaryVector( stream, primitiveIds ) )
+	{
+		Clear();
+		return false;
+	}
+	// References must stay inside arrays, and nodes must form a tree no deeper than a built one,
+	// so that traversal stacks can not overflow for any input. Children follow their parents,
+	// so depths are known in a single forward pass.
+	const int numNodes = static_cast<int>( nodes.size() );
+	const int numPrimitiveIds = static_cast<int>( primitiveIds.size() );
+	std::vector<int> depths( numNodes, -1 );
+	if ( numNodes > 0 )
+		depths[0] = 0;
+	for ( int nodeId = 0; nodeId < numNodes; ++nodeId )
+	{
+		const BvhNode& node = nodes[nodeId];
+		bool valid = depths[nodeId] >= 0;
+		if ( node.count > 0 )
+			valid = valid && node.right_or_first >= 0 && node.right_or_first <= numPrimitiveIds - node.count;
+		else
+		{
+			// Every node but the root is a child of exactly one node.
+			valid = valid && node.right_or_first > nodeId + 1 && node.right_or_first < numNodes && depths[nodeId] < max_build_depth &&
+				depths[nodeId + 1] < 0 && depths[node.right_or_first] < 0;
+			if ( valid )
+			{
+				depths[nodeId + 1] = depths[nodeId] + 1;
+				depths[node.right_or_first] = depths[nodeId] + 1;
+			}
+		}
+		if ( !valid )
+		{
+			Clear();
+			return false;
+		}
+	}
+	// Primitive ids must be a permutation, so every primitive is in exactly one leaf.
+	std::vector<bool> seen( numPrimitiveIds, false );
+	for ( const int primitiveId : primitiveIds )
+	{
+		if ( primitiveId < 0 || primitiveId >= numPrimitiveIds || seen[primitiveId] )
+		{
+			Clear();
+			return false;
+		}
+		seen[primitiveId] = true;
+	}
+	return true;
+}
+
+
+
+void Bvh::BuildRefitLinks()
+{
+	const int numNodes = static_cast<int>( nodes.size() );
+	nodeParents.assign( numNodes, -1 );
+	primitiveLeaves.assign( primitiveIds.size(), -1 );
+	refitMarks.assign( numNodes, 0 );
+	for ( int nodeId = 0; nodeId < numNodes; ++nodeId )
+	{
+		const BvhNode& node = nodes[nodeId];
+		if ( node.count > 0 )
+		{
+			for ( int i = node.right_or_first; i < node.right_or_first + node.count; ++i )
+				primitiveLeaves[ primitiveIds[i] ] = nodeId;
+		}
+		else
+		{
+			nodeParents[nodeId + 1] = nodeId;
+			nodeParents[node.right_or_first] = nodeId;
+		}
+	}
+}
+
+
+
+int Bvh::BuildNode( const std::vector<Aabb>& primitiveBounds, const std::vector<Vec3f>& centroids, const int first, const int count, const int depth )
+{
+	const int nodeId = static_cast<int>( nodes.size() );
+	nodes.push_back( BvhNode() );
+
+	Aabb bounds, centroidBounds;
+	for ( int i = first; i < first + count; ++i )
+	{
+		bounds.Grow( primitiveBounds[ primitiveIds[i] ] );
+		centroidBounds.Grow( centroids[ primitiveIds[i] ] );
+	}
+	nodes[nodeId].bounds_min = bounds.min_corner;
+	nodes[nodeId].bounds_max = bounds.max_corner;
+	nodes[nodeId].right_or_first = first;
+	nodes[nodeId].count = count;
+
+	if ( count <= max_leaf_size || depth >= max_build_depth )
+		return nodeId;
+
+	// +++++ Find the best split among bin boundaries of all axes. +++++
+	const Vec3f centroidExtent = centroidBounds.max_corner - centroidBounds.min_corner;
+	const float parentArea = bounds.SurfaceArea();
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = static_cast<float>( count );
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		if ( centroidExtent[axis] <= 0.0f )
+			continue;
+		const float binScale = sah_num_bins / centroidExtent[axis];
+		Aabb binBounds[sah_num_bins];
+		int binCounts[sah_num_bins] = {};
+		for ( int i = first; i < first + count; ++i )
+		{
+			const int bin = std::min( static_cast<int>( (centroids[ primitiveIds[i] ][axis] - centroidBounds.min_corner[axis]) * binScale ), sah_num_bins-1 );
+			binBounds[bin].Grow( primitiveBounds[ primitiveIds[i] ] );
+			++binCounts[bin];
+		}
+		// Sweep from the right to collect costs of the right parts, then from the left.
+		float rightAreas[sah_num_bins];
+		int rightCounts[sah_num_bins];
+		Aabb rightBounds;
+		int rightCount = 0;
+		for ( int bin = sah_num_bins-1; bin > 0; --bin )
+		{
+			rightBounds.Grow( binBounds[bin] );
+			rightCount += binCounts[bin];
+			rightAreas[bin] = rightBounds.SurfaceArea();
+			rightCounts[bin] = rightCount;
+		}
+		Aabb leftBounds;
+		int leftCount = 0;
+		for ( int split = 1; split < sah_num_bins; ++split )
+		{
+			leftBounds.Grow( binBounds[split-1] );
+			leftCount += binCounts[split-1];
+			if ( leftCount == 0 || rightCounts[split] == 0 )
+				continue;
+			const float cost = sah_traversal_cost + (leftBounds.SurfaceArea()*leftCount + rightAreas[split]*rightCounts[split]) / parentArea;
+			if ( cost < bestCost )
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+	// ----- Find the best split among bin boundaries of all axes. -----
+
+	int leftCount = 0;
+	if ( bestAxis >= 0 )
+	{
+		const float binScale = sah_num_bins / centroidExtent[bestAxis];
+		const float minCorner = centroidBounds.min_corner[bestAxis];
+		int* middle = std::partition( &primitiveIds[first], &primitiveIds[first] + count, [&]( const int primitiveId ) {
+			return std::min( static_cast<int>( (centroids[primitiveId][bestAxis] - minCorner) * binScale ), sah_num_bins-1 ) < bestSplit;
+		} );
+		leftCount = static_cast<int>( middle - &primitiveIds[first] );
+	}
+	else
+	{
+		if ( count <= max_leaf_size_sah )
+			return nodeId;
+		// Splitting is not profitable, but the leaf is too large (e.g., coincident centroids): split by the median.
+		int axis = 0;
+		for ( int i = 1; i < 3; ++i )
+			if ( centroidExtent[i] > centroidExtent[axis] )
+				axis = i;
+		leftCount = count / 2;
+		std::nth_element( &primitiveIds[first], &primitiveIds[first] + leftCount, &primitiveIds[first] + count, [&]( const int a, const int b ) {
+			return centroids[a][axis] < centroids[b][axis];
+		} );
+	}
+
+	BuildNode( primitiveBounds, centroids, first, leftCount, depth+1 );
+	const int rightId = BuildNode( primitiveBounds, centroids, first + leftCount, count - leftCount, depth+1 );
+	nodes[nodeId].right_or_first = rightId;
+	nodes[nodeId].count = 0;
+	return nodeId;
+}
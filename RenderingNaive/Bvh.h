@@ -0,0 +1,368 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - Bvh
+*
+* Bounding volume hierarchy (SAH-built, flattened into a node array) for ray queries.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_BVH_H
+#define RENDERINGNAIVE_BVH_H
+
+#include "geometry.h"
+
+#include "RayStatistics.h"
+
+#include <algorithm>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+
+// Axis aligned bounding box. Default box is empty.
+struct Aabb
+{
+	Vec3f min_corner;
+	Vec3f max_corner;
+
+	Aabb() noexcept
+		: min_corner( std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() )
+		, max_corner( -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() ) {}
+	Aabb( const Vec3f& minCorner, const Vec3f& maxCorner ) noexcept : min_corner( minCorner ), max_corner( maxCorner ) {}
+
+	void Grow( const Vec3f& point );
+	void Grow( const Aabb& box );
+	bool IsEmpty() const { return min_corner.x > max_corner.x || min_corner.y > max_corner.y || min_corner.z > max_corner.z; }
+	Vec3f Center() const { return (min_corner + max_corner) * 0.5f; }
+	float SurfaceArea() const;
+};
+
+
+// Node is 32 bytes. Left child of an inner node immediately follows the node in the array.
+struct BvhNode
+{
+	Vec3f bounds_min;
+	int right_or_first; // Inner node: index of the right child. Leaf: index of the first primitive in the primitive id list.
+	Vec3f bounds_max;
+	int count; // Number of primitives in the leaf, 0 for inner nodes.
+};
+
+
+const int ray_packet_size = 8;
+const int ray_packet_min_active = 2; // Subtrees hit by fewer rays are traversed ray by ray.
+
+// Coherent rays in SoA layout, so every lane operation is a plain loop over ray_packet_size floats (auto-vectorized).
+// Inactive lanes have negative distance.
+struct RayPacket
+{
+	float origin_x[ray_packet_size];
+	float origin_y[ray_packet_size];
+	float origin_z[ray_packet_size];
+	float direction_x[ray_packet_size];
+	float direction_y[ray_packet_size];
+	float direction_z[ray_packet_size];
+	float inverse_direction_x[ray_packet_size];
+	float inverse_direction_y[ray_packet_size];
+	float inverse_direction_z[ray_packet_size];
+	float distance[ray_packet_size]; // Closest hit so far.
+};
+
+
+// Hierarchy is built over boxes of abstract primitives, so it is independent of the primitive type.
+// Primitive intersection is provided by the caller during traversal.
+
+class Bvh
+{
+public:
+	Bvh();
+	~Bvh();
+
+	void Clear();
+	void Build( const std::vector<Aabb>& primitiveBounds );
+
+	bool IsEmpty() const { return nodes.empty(); }
+	Aabb Bounds() const;
+	const std::vector<BvhNode>& Nodes() const { return nodes; }
+	const std::vector<int>& PrimitiveIds() const { return primitiveIds; }
+
+	// Binary cache of the built hierarchy. Reading fails for malformed trees, and for primitive ids, which are not a permutation
+	// of 0..n-1; the caller checks that n is the number of its primitives.
+	bool Write( std::ostream& stream ) const;
+	bool Read( std::istream& stream );
+
+	// Calls intersectPrimitive( primitiveId, distance ) for primitives, whose boxes are hit closer than distance.
+	// Callback returns true and decreases distance, if primitive is hit closer. If anyHit is set, traversal stops at the first hit.
+	// Returns true if any primitive was hit.
+	template<typename IntersectPrimitive>
+	bool Traverse( const Vec3f& origin, const Vec3f& direction, float& distance, IntersectPrimitive intersectPrimitive, const bool anyHit = false ) const;
+
+	// Traverses all lanes of the packet together and calls intersectPrimitive( primitiveId, activeLanes ) for leaf primitives,
+	// where activeLanes[lane] is set for rays, which hit the leaf box closer than their distance. Callback decreases distances of hit lanes.
+	// Once only a single ray is left in a subtree, it is continued with the single ray traversal.
+	template<typename IntersectPrimitive>
+	void TraversePacket( RayPacket& packet, IntersectPrimitive intersectPrimitive ) const;
+
+	// Updates bounds of the nodes above the moved primitives, where primitiveBounds( primitiveId ) returns the current bounds
+	// of any primitive. Topology is kept, so the cost depends on the number of moved primitives and the depth, not on the size
+	// of the hierarchy; its quality degrades with large motions, until the next Build.
+	template<typename PrimitiveBounds>
+	void Refit( const std::vector<int>& movedPrimitives, PrimitiveBounds primitiveBounds );
+
+private:
+	template<typename IntersectPrimitive>
+	bool TraverseSubtree( const int rootId, const Vec3f& origin, const Vec3f& direction, float& distance, IntersectPrimitive intersectPrimitive, const bool anyHit ) const;
+
+	int BuildNode( const std::vector<Aabb>& primitiveBounds, const std::vector<Vec3f>& centroids, const int first, const int count, const int depth );
+	// Parents of nodes and leaves of primitives for Refit; they are built at the first refit after Build or Read.
+	void BuildRefitLinks();
+
+	// Returns entry distance, or infinity if the box is missed or is farther than maxDistance.
+	static float IntersectNode( const BvhNode& node, const Vec3f& origin, const Vec3f& inverseDirection, const float maxDistance );
+
+private:
+	std::vector<BvhNode> nodes;
+	std::vector<int> primitiveIds;
+
+	std::vector<int> nodeParents; // -1 for the root.
+	std::vector<int> primitiveLeaves;
+	std::vector<char> refitMarks; // Cleared after every refit.
+};
+
+
+
+inline float Bvh::IntersectNode( const BvhNode& node, const Vec3f& origin, const Vec3f& inverseDirection, const float maxDistance )
+{
+	const float tx1 = (node.bounds_min.x - origin.x) * inverseDirection.x;
+	const float tx2 = (node.bounds_max.x - origin.x) * inverseDirection.x;
+	const float ty1 = (node.bounds_min.y - origin.y) * inverseDirection.y;
+	const float ty2 = (node.bounds_max.y - origin.y) * inverseDirection.y;
+	const float tz1 = (node.bounds_min.z - origin.z) * inverseDirection.z;
+	const float tz2 = (node.bounds_max.z - origin.z) * inverseDirection.z;
+	const float tEnter = std::max( std::max( std::min( tx1, tx2 ), std::min( ty1, ty2 ) ), std::max( std::min( tz1, tz2 ), 0.0f ) );
+	const float tExit = std::min( std::min( std::max( tx1, tx2 ), std::max( ty1, ty2 ) ), std::min( std::max( tz1, tz2 ), maxDistance ) );
+	return tEnter <= tExit ? tEnter : std::numeric_limits<float>::infinity();
+}
+
+
+
+template<typename IntersectPrimitive>
+bool Bvh::Traverse( const Vec3f& origin, const Vec3f& direction, float& distance, IntersectPrimitive intersectPrimitive, const bool anyHit ) const
+{
+	if ( nodes.empty() )
+		return false;
+	return TraverseSubtree( 0, origin, direction, distance, intersectPrimitive, anyHit );
+}
+
+
+
+template<typename IntersectPrimitive>
+bool Bvh::TraverseSubtree( const int rootId, const Vec3f& origin, const Vec3f& direction, float& distance, IntersectPrimitive intersectPrimitive, const bool anyHit ) const
+{
+	const int max_stack_size = 128;
+
+	const Vec3f inverseDirection( 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z );
+	if ( IntersectNode( nodes[rootId], origin, inverseDirection, distance ) == std::numeric_limits<float>::infinity() )
+		return false;
+
+	// Postponed far children with their entry distances, so they are skipped if a closer hit is found meanwhile.
+	int stackNodes[max_stack_size];
+	float stackDistances[max_stack_size];
+	int stackSize = 0;
+	int nodeId = rootId;
+	bool hit = false;
+	while ( true )
+	{
+		RAY_STATISTICS_ADD( bvh_nodes, 1 );
+		const BvhNode& node = nodes[nodeId];
+		if ( node.count > 0 )
+		{
+			for ( int i = node.right_or_first; i < node.right_or_first + node.count; ++i )
+			{
+				if ( intersectPrimitive( primitiveIds[i], distance ) )
+				{
+					hit = true;
+					if ( anyHit )
+						return true;
+				}
+			}
+		}
+		else
+		{
+			int nearId = nodeId + 1;
+			int farId = node.right_or_first;
+			float nearDistance = IntersectNode( nodes[nearId], origin, inverseDirection, distance );
+			float farDistance = IntersectNode( nodes[farId], origin, inverseDirection, distance );
+			if ( farDistance < nearDistance )
+			{
+				std::swap( nearId, farId );
+				std::swap( nearDistance, farDistance );
+			}
+			if ( nearDistance != std::numeric_limits<float>::infinity() )
+			{
+				if ( farDistance != std::numeric_limits<float>::infinity() )
+				{
+					stackNodes[stackSize] = farId;
+					stackDistances[stackSize] = farDistance;
+					++stackSize;
+				}
+				nodeId = nearId;
+				continue;
+			}
+		}
+
+		// Pop the next node, which may still contain a closer hit.
+		nodeId = -1;
+		while ( stackSize > 0 && nodeId < 0 )
+		{
+			--stackSize;
+			if ( stackDistances[stackSize] < distance )
+				nodeId = stackNodes[stackSize];
+		}
+		if ( nodeId < 0 )
+			break;
+	}
+	return hit;
+}
+
+
+
+template<typename IntersectPrimitive>
+void Bvh::TraversePacket( RayPacket& packet, IntersectPrimitive intersectPrimitive ) const
+{
+	const int max_stack_size = 128;
+
+	if ( nodes.empty() )
+		return;
+
+	int stackNodes[max_stack_size];
+	int stackSize = 0;
+	stackNodes[stackSize++] = 0;
+	int activeLanes[ray_packet_size];
+	while ( stackSize > 0 )
+	{
+		const int nodeId = stackNodes[--stackSize];
+		const BvhNode& node = nodes[nodeId];
+		RAY_STATISTICS_ADD( bvh_nodes, 1 );
+
+		// +++++ Test node box for all lanes. +++++
+		int numActive = 0;
+		int lastActive = 0;
+		for ( int lane = 0; lane < ray_packet_size; ++lane )
+		{
+			const float tx1 = (node.bounds_min.x - packet.origin_x[lane]) * packet.inverse_direction_x[lane];
+			const float tx2 = (node.bounds_max.x - packet.origin_x[lane]) * packet.inverse_direction_x[lane];
+			const float ty1 = (node.bounds_min.y - packet.origin_y[lane]) * packet.inverse_direction_y[lane];
+			const float ty2 = (node.bounds_max.y - packet.origin_y[lane]) * packet.inverse_direction_y[lane];
+			const float tz1 = (node.bounds_min.z - packet.origin_z[lane]) * packet.inverse_direction_z[lane];
+			const float tz2 = (node.bounds_max.z - packet.origin_z[lane]) * packet.inverse_direction_z[lane];
+			const float tEnter = std::max( std::max( std::min( tx1, tx2 ), std::min( ty1, ty2 ) ), std::max( std::min( tz1, tz2 ), 0.0f ) );
+			const float tExit = std::min( std::min( std::max( tx1, tx2 ), std::max( ty1, ty2 ) ), std::min( std::max( tz1, tz2 ), packet.distance[lane] ) );
+			activeLanes[lane] = tEnter <= tExit ? 1 : 0;
+		}
+		for ( int lane = 0; lane < ray_packet_size; ++lane )
+		{
+			if ( activeLanes[lane] )
+			{
+				++numActive;
+				lastActive = lane;
+			}
+		}
+		// ----- Test node box for all lanes. -----
+
+		if ( numActive == 0 )
+			continue;
+		if ( numActive < ray_packet_min_active )
+		{
+			// Rays diverged: packet overhead does not pay off for a few rays.
+			int singleLane[ray_packet_size];
+			for ( int lane = 0; lane < ray_packet_size; ++lane )
+			{
+				if ( !activeLanes[lane] )
+					continue;
+				for ( int other = 0; other < ray_packet_size; ++other )
+					singleLane[other] = other == lane ? 1 : 0;
+				const Vec3f origin( packet.origin_x[lane], packet.origin_y[lane], packet.origin_z[lane] );
+				const Vec3f direction( packet.direction_x[lane], packet.direction_y[lane], packet.direction_z[lane] );
+				TraverseSubtree( nodeId, origin, direction, packet.distance[lane], [&]( const int primitiveId, float& distance ) {
+					const float previousDistance = distance;
+					intersectPrimitive( primitiveId, singleLane );
+					return distance < previousDistance;
+				}, false );
+			}
+			continue;
+		}
+
+		if ( node.count > 0 )
+		{
+			for ( int i = node.right_or_first; i < node.right_or_first + node.count; ++i )
+				intersectPrimitive( primitiveIds[i], activeLanes );
+			continue;
+		}
+
+		// Visit first the child, which is closer along the direction of an active ray.
+		int nearId = nodeId + 1;
+		int farId = node.right_or_first;
+		const BvhNode& nearNode = nodes[nearId];
+		const BvhNode& farNode = nodes[farId];
+		const float nearProjection =
+			(nearNode.bounds_min.x + nearNode.bounds_max.x) * packet.direction_x[lastActive] +
+			(nearNode.bounds_min.y + nearNode.bounds_max.y) * packet.direction_y[lastActive] +
+			(nearNode.bounds_min.z + nearNode.bounds_max.z) * packet.direction_z[lastActive];
+		const float farProjection =
+			(farNode.bounds_min.x + farNode.bounds_max.x) * packet.direction_x[lastActive] +
+			(farNode.bounds_min.y + farNode.bounds_max.y) * packet.direction_y[lastActive] +
+			(farNode.bounds_min.z + farNode.bounds_max.z) * packet.direction_z[lastActive];
+		if ( farProjection < nearProjection )
+			std::swap( nearId, farId );
+		stackNodes[stackSize++] = farId;
+		stackNodes[stackSize++] = nearId;
+	}
+}
+
+
+template<typename PrimitiveBounds>
+void Bvh::Refit( const std::vector<int>& movedPrimitives, PrimitiveBounds primitiveBounds )
+{
+	if ( nodes.empty() || movedPrimitives.empty() )
+		return;
+	if ( nodeParents.size() != nodes.size() )
+		BuildRefitLinks();
+
+	// Paths from leaves of moved primitives to the root, every node once.
+	std::vector<int> refitNodes;
+	for ( const int primitiveId : movedPrimitives )
+	{
+		for ( int nodeId = primitiveLeaves[primitiveId]; nodeId >= 0 && !refitMarks[nodeId]; nodeId = nodeParents[nodeId] )
+		{
+			refitMarks[nodeId] = 1;
+			refitNodes.push_back( nodeId );
+		}
+	}
+
+	// Children follow their parents in the array, so nodes in decreasing order have their children refitted first.
+	std::sort( refitNodes.begin(), refitNodes.end(), std::greater<int>() );
+	for ( const int nodeId : refitNodes )
+	{
+		BvhNode& node = nodes[nodeId];
+		Aabb bounds;
+		if ( node.count > 0 )
+		{
+			for ( int i = node.right_or_first; i < node.right_or_first + node.count; ++i )
+				bounds.Grow( primitiveBounds( primitiveIds[i] ) );
+		}
+		else
+		{
+			bounds.Grow( Aabb( nodes[nodeId + 1].bounds_min, nodes[nodeId + 1].bounds_max ) );
+			bounds.Grow( Aabb( nodes[node.right_or_first].bounds_min, nodes[node.right_or_first].bounds_max ) );
+		}
+		node.bounds_min = bounds.min_corner;
+		node.bounds_max = bounds.max_corner;
+		refitMarks[nodeId] = 0;
+	}
+}
+
+#endif // RENDERINGNAIVE_BVH_H
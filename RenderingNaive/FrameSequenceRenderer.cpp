@@ -0,0 +1,124 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - FrameSequenceRenderer
+*
+* Renders frames of an animated scene one after another, reusing tiles, which the motion has not changed.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "FrameSequenceRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "SceneAnimation.h"
+#include "TileScheduler.h"
+
+
+const int default_frame_tile_size = 16; // Smaller than tiles of still images, so reused regions follow moving objects closely.
+
+
+
+FrameSequenceRenderer::FrameSequenceRenderer()
+	:tileSize( default_frame_tile_size )
+	,viewGrouping( false )
+	,tileReuse( true )
+	,numTiles( 0 )
+	,reusedTiles( 0 )
+	,seconds( 0.0f )
+{
+
+}
+
+
+
+bool FrameSequenceRenderer::SetTileSize( const int tileSize )
+{
+	if ( tileSize <= 0 )
+		return false;
+	this->tileSize = tileSize;
+	Reset();
+	return true;
+}
+
+
+
+void FrameSequenceRenderer::Reset()
+{
+	primaryHits.clear();
+	pixelReuse.clear();
+}
+
+
+
+bool FrameSequenceRenderer::RenderFrame( RayTracer& rayTracer, const SceneAnimation& animation, const int frame, const std::vector<RenderView>& views )
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point startTime = Clock::now();
+
+	const bool success = animation.Apply( frame, rayTracer );
+	rayTracer.UpdateAccelerationStructure();
+	std::vector<Aabb> changedBounds;
+	bool fullFrame = !rayTracer.TakeChangedBounds( changedBounds ) || !tileReuse || primaryHits.size() != views.size();
+	for ( size_t viewId = 0; viewId < views.size() && !fullFrame; ++viewId )
+		fullFrame = primaryHits[viewId].size() != static_cast<size_t>( views[viewId].image->Width() ) * views[viewId].image->Height();
+	if ( fullFrame )
+	{
+		primaryHits.resize( views.size() );
+		pixelReuse.resize( views.size() );
+		for ( size_t viewId = 0; viewId < views.size(); ++viewId )
+		{
+			const size_t numPixels = static_cast<size_t>( views[viewId].image->Width() ) * views[viewId].image->Height();
+			primaryHits[viewId].assign( numPixels, PrimitiveHit() );
+			pixelReuse[viewId].assign( numPixels, 0 );
+		}
+	}
+
+	// +++++ Flag tiles, which no change can reach, with the same tiles as of the scheduler. +++++
+	std::vector<RenderView> frameViews( views );
+	numTiles = 0;
+	reusedTiles = 0;
+	for ( size_t viewId = 0; viewId < frameViews.size(); ++viewId )
+	{
+		RenderView& view = frameViews[viewId];
+		view.pixel_strata = nullptr;
+		view.sample_id = 0;
+		view.primary_hits = primaryHits[viewId].data();
+		view.reuse_primary_hits = false;
+		view.pixel_reuse = pixelReuse[viewId].data();
+
+		const int width = view.image->Width();
+		const int height = view.image->Height();
+		const int numTilesX = (width + tileSize - 1) / tileSize;
+		const int numViewTiles = numTilesX * ((height + tileSize - 1) / tileSize);
+		int viewReusedTiles = 0;
+#pragma omp parallel for reduction( +:viewReusedTiles )
+		for ( int tileId = 0; tileId < numViewTiles; ++tileId )
+		{
+			const int xBegin = tileId % numTilesX * tileSize;
+			const int yBegin = tileId / numTilesX * tileSize;
+			const int xEnd = std::min( xBegin + tileSize, width );
+			const int yEnd = std::min( yBegin + tileSize, height );
+			const unsigned char reuse = !fullFrame && rayTracer.IsTileUnchanged( view, xBegin, yBegin, xEnd, yEnd, changedBounds ) ? 1 : 0;
+			for ( int j = yBegin; j < yEnd; ++j )
+				std::fill( pixelReuse[viewId].begin() + static_cast<size_t>(j)*width + xBegin, pixelReuse[viewId].begin() + static_cast<size_t>(j)*width + xEnd, reuse );
+			viewReusedTiles += reuse;
+		}
+		numTiles += numViewTiles;
+		reusedTiles += viewReusedTiles;
+	}
+	// ----- Flag tiles, which no change can reach, with the same tiles as of the scheduler. -----
+
+	if ( reusedTiles < numTiles )
+	{
+		TileScheduler tileScheduler;
+		tileScheduler.SetTileSize( tileSize );
+		tileScheduler.SetProgressReport( false );
+		tileScheduler.SetViewGrouping( viewGrouping );
+		tileScheduler.Render( rayTracer, frameViews );
+	}
+	seconds = std::chrono::duration<float>( Clock::now() - startTime ).count();
+	return success;
+}
@@ -0,0 +1,60 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - FrameSequenceRenderer
+*
+* Renders frames of an animated scene one after another, reusing tiles, which the motion has not changed.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_FRAMESEQUENCERENDERER_H
+#define RENDERINGNAIVE_FRAMESEQUENCERENDERER_H
+
+#include <vector>
+
+#include "RayTracer.h"
+
+class SceneAnimation;
+
+
+// Frames are rendered into the same images with one sample per pixel, at pixel centers. A frame moves the animated objects,
+// so the scene BVH is refitted, not rebuilt, and renders again only tiles, which the moves may have changed: hits of pixel
+// centers are kept per view, and a tile is reused if all its pixels end at their primary hits with no ray through the changed
+// regions (see RayTracer::IsTileUnchanged). The first frame, and frames after changes of unbounded extent, are rendered in full.
+
+class FrameSequenceRenderer
+{
+public:
+	FrameSequenceRenderer();
+
+	bool SetTileSize( const int tileSize );
+	// Tiles are rendered together for all views (see TileScheduler::SetViewGrouping), off by default.
+	void SetViewGrouping( const bool viewGrouping ) { this->viewGrouping = viewGrouping; }
+	// Unchanged tiles are reused (on by default); otherwise every frame is rendered in full.
+	void SetTileReuse( const bool tileReuse ) { this->tileReuse = tileReuse; }
+	// The next frame is rendered in full, e.g., after other changes of the scene.
+	void Reset();
+
+	// Moves the scene to the frame and renders it. Images of views have to be allocated, and have to keep the previous frame
+	// of the same views (call Reset for other views of the same number and size). Returns false if the animation does not fit the scene.
+	bool RenderFrame( RayTracer& rayTracer, const SceneAnimation& animation, const int frame, const std::vector<RenderView>& views );
+
+	// Statistics of the last frame: tiles of all views, and tiles kept from the previous frame.
+	int NumTiles() const { return numTiles; }
+	int ReusedTiles() const { return reusedTiles; }
+	float Seconds() const { return seconds; }
+
+private:
+	int tileSize;
+	bool viewGrouping;
+	bool tileReuse;
+
+	std::vector<std::vector<PrimitiveHit>> primaryHits; // Hits of pixel centers per view.
+	std::vector<std::vector<unsigned char>> pixelReuse; // Per view, set for all pixels of reused tiles.
+	int numTiles;
+	int reusedTiles;
+	float seconds;
+};
+
+#endif // RENDERINGNAIVE_FRAMESEQUENCERENDERER_H
@@ -0,0 +1,149 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - LightGrid
+*
+* Uniform grid over lights of limited radius, which gives lights that can illuminate a point.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "LightGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "RayTracer.h"
+
+
+const int max_light_grid_resolution = 64; // Per axis.
+const int light_grid_cells_per_light = 8;
+
+
+
+LightGrid::LightGrid()
+	:resolution( 0, 0, 0 )
+	,inverseCellSize( 0.0f, 0.0f, 0.0f )
+	,numCells( 0 )
+	,cellFirst( 2, 0 )
+{
+
+}
+
+
+
+void LightGrid::Build( const std::vector<Light>& lights )
+{
+	// +++++ Split lights by radius and find bounds of spheres of influence. +++++
+	std::vector<int> unlimitedIds, limitedIds;
+	bounds = Aabb();
+	for ( int lightId = 0; lightId < static_cast<int>( lights.size() ); ++lightId )
+	{
+		const Light& light = lights[lightId];
+		if ( light.radius <= 0.0f )
+		{
+			unlimitedIds.push_back( lightId );
+			continue;
+		}
+		limitedIds.push_back( lightId );
+		const Vec3f radius( light.radius, light.radius, light.radius );
+		bounds.Grow( Aabb( light.position - radius, light.position + radius ) );
+	}
+	// ----- Split lights by radius and find bounds of spheres of influence. -----
+
+	// +++++ Choose resolution: cubic cells, a few of them per light. +++++
+	numCells = 0;
+	resolution = Vec3i( 0, 0, 0 );
+	std::vector<std::vector<int>> cellLights;
+	if ( !limitedIds.empty() )
+	{
+		const Vec3f extent = bounds.max_corner - bounds.min_corner;
+		const float maxCells = static_cast<float>( max_light_grid_resolution ) * max_light_grid_resolution * max_light_grid_resolution;
+		const float targetCells = std::min( maxCells, static_cast<float>( light_grid_cells_per_light * limitedIds.size() ) );
+		const float cellSize = std::cbrt( extent.x * extent.y * extent.z / targetCells );
+		numCells = 1;
+		for ( size_t axis = 0; axis < 3; ++axis )
+		{
+			resolution[axis] = std::max( 1, std::min( max_light_grid_resolution, static_cast<int>( std::ceil( extent[axis] / cellSize ) ) ) );
+			inverseCellSize[axis] = resolution[axis] / extent[axis];
+			numCells *= resolution[axis];
+		}
+		cellLights.resize( numCells );
+	}
+	// ----- Choose resolution: cubic cells, a few of them per light. -----
+
+	// +++++ Put lights into cells, which their spheres overlap. +++++
+	for ( const int lightId : limitedIds )
+	{
+		const Light& light = lights[lightId];
+		int first[3], last[3];
+		for ( size_t axis = 0; axis < 3; ++axis )
+		{
+			first[axis] = std::max( 0, static_cast<int>( (light.position[axis] - light.radius - bounds.min_corner[axis]) * inverseCellSize[axis] ) );
+			last[axis] = std::min( resolution[axis] - 1, static_cast<int>( (light.position[axis] + light.radius - bounds.min_corner[axis]) * inverseCellSize[axis] ) );
+		}
+		for ( int z = first[2]; z <= last[2]; ++z )
+		{
+			for ( int y = first[1]; y <= last[1]; ++y )
+			{
+				for ( int x = first[0]; x <= last[0]; ++x )
+				{
+					// Squared distance from the light to the closest point of the cell.
+					const int cell[3] = { x, y, z };
+					float distance2 = 0.0f;
+					for ( size_t axis = 0; axis < 3; ++axis )
+					{
+						const float cellMin = bounds.min_corner[axis] + cell[axis] / inverseCellSize[axis];
+						const float cellMax = bounds.min_corner[axis] + (cell[axis] + 1) / inverseCellSize[axis];
+						const float offset = std::max( std::max( cellMin - light.position[axis], light.position[axis] - cellMax ), 0.0f );
+						distance2 += offset * offset;
+					}
+					if ( distance2 <= light.radius * light.radius )
+						cellLights[(z*resolution.y + y)*resolution.x + x].push_back( lightId );
+				}
+			}
+		}
+	}
+	// ----- Put lights into cells, which their spheres overlap. -----
+
+	// +++++ Flatten lists of cells, and the list of points outside the grid. +++++
+	cellFirst.clear();
+	lightIds.clear();
+	cumulativeIntensity.clear();
+	for ( int cell = 0; cell <= numCells; ++cell )
+	{
+		cellFirst.push_back( static_cast<int>( lightIds.size() ) );
+		lightIds.insert( lightIds.end(), unlimitedIds.begin(), unlimitedIds.end() );
+		if ( cell < numCells )
+			lightIds.insert( lightIds.end(), cellLights[cell].begin(), cellLights[cell].end() );
+		float intensity = 0.0f;
+		for ( size_t i = cellFirst.back(); i < lightIds.size(); ++i )
+		{
+			// Lights of negative intensity are never sampled.
+			intensity += std::max( 0.0f, lights[lightIds[i]].intensity );
+			cumulativeIntensity.push_back( intensity );
+		}
+	}
+	cellFirst.push_back( static_cast<int>( lightIds.size() ) );
+	// ----- Flatten lists of cells, and the list of points outside the grid. -----
+}
+
+
+
+LightCandidates LightGrid::Candidates( const Vec3f& point ) const
+{
+	int cell = numCells;
+	if ( numCells > 0 )
+	{
+		const float x = (point.x - bounds.min_corner.x) * inverseCellSize.x;
+		const float y = (point.y - bounds.min_corner.y) * inverseCellSize.y;
+		const float z = (point.z - bounds.min_corner.z) * inverseCellSize.z;
+		if ( x >= 0.0f && x < resolution.x && y >= 0.0f && y < resolution.y && z >= 0.0f && z < resolution.z )
+			cell = (static_cast<int>( z )*resolution.y + static_cast<int>( y ))*resolution.x + static_cast<int>( x );
+	}
+	LightCandidates candidates;
+	candidates.light_ids = lightIds.data() + cellFirst[cell];
+	candidates.cumulative_intensity = cumulativeIntensity.data() + cellFirst[cell];
+	candidates.count = cellFirst[cell+1] - cellFirst[cell];
+	return candidates;
+}
@@ -0,0 +1,58 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - LightGrid
+*
+* Uniform grid over lights of limited radius, which gives lights that can illuminate a point.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_LIGHTGRID_H
+#define RENDERINGNAIVE_LIGHTGRID_H
+
+#include <vector>
+
+#include "geometry.h"
+
+#include "Bvh.h"
+
+struct Light;
+
+
+// Lights of a grid cell, with cumulative intensities for sampling lights in proportion to their intensities.
+struct LightCandidates
+{
+	const int* light_ids = nullptr;
+	const float* cumulative_intensity = nullptr; // Sum of intensities of this and all previous lights.
+	int count = 0;
+};
+
+
+// Grid covers spheres of influence of lights of limited radius. Every cell lists lights of unlimited radius (in their order),
+// followed by lights of limited radius, whose spheres overlap the cell. Points outside the grid see only lights of unlimited radius.
+// Without lights of limited radius there are no cells, and every point sees all lights.
+
+class LightGrid
+{
+public:
+	LightGrid();
+
+	void Build( const std::vector<Light>& lights );
+
+	LightCandidates Candidates( const Vec3f& point ) const;
+	bool IsCulling() const { return numCells > 0; } // False if all lights have unlimited radius.
+
+private:
+	Aabb bounds;
+	Vec3i resolution;
+	Vec3f inverseCellSize;
+	int numCells;
+
+	// Lights of cell i are [cellFirst[i], cellFirst[i+1]), the last list (after all cells) is for points outside the grid.
+	std::vector<int> cellFirst;
+	std::vector<int> lightIds;
+	std::vector<float> cumulativeIntensity;
+};
+
+#endif // RENDERINGNAIVE_LIGHTGRID_H
@@ -0,0 +1,361 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - MeshLoader
+*
+* Streaming loader of triangle meshes from OBJ and PLY files.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "MeshLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "TriangleMesh.h"
+
+
+const size_t stream_buffer_size = 1 << 20;
+const size_t max_reserved_items = 1 << 24; // Counts of a PLY header are not trusted beyond it; larger meshes grow while they are read.
+
+
+
+// Adds polygon as a fan of triangles.
+static void AddPolygon( const std::vector<int>& polygon, TriangleMesh& mesh )
+{
+	for ( size_t i = 2; i < polygon.size(); ++i )
+		mesh.triangles.push_back( Vec3i( polygon[0], polygon[i-1], polygon[i] ) );
+}
+
+
+
+static bool HasExtension( const std::string& file_path, const std::string& extension )
+{
+	if ( file_path.size() < extension.size() )
+		return false;
+	std::string fileExtension = file_path.substr( file_path.size() - extension.size() );
+	std::transform( fileExtension.begin(), fileExtension.end(), fileExtension.begin(), []( const unsigned char c ) { return static_cast<char>( std::tolower( c ) ); } );
+	return fileExtension == extension;
+}
+
+
+
+bool MeshLoader::Load( const std::string& file_path, TriangleMesh& mesh )
+{
+	if ( HasExtension( file_path, ".obj" ) )
+		return LoadObj( file_path, mesh );
+	if ( HasExtension( file_path, ".ply" ) )
+		return LoadPly( file_path, mesh );
+	return false;
+}
+
+
+
+bool MeshLoader::LoadObj( const std::string& file_path, TriangleMesh& mesh )
+{
+	mesh.Clear();
+	std::ifstream filestream;
+	std::vector<char> buffer( stream_buffer_size );
+	filestream.rdbuf()->pubsetbuf( buffer.data(), buffer.size() );
+	filestream.open( file_path, std::ifstream::in );
+	if ( !filestream.is_open() )
+		return false;
+
+	std::string line;
+	std::vector<int> polygon;
+	bool success = true;
+	while ( success && std::getline( filestream, line ) )
+	{
+		const char* c = line.c_str();
+		while ( *c == ' ' || *c == '\t' )
+			++c;
+		if ( c[0] == 'v' && (c[1] == ' ' || c[1] == '\t') )
+		{
+			char* end = nullptr;
+			Vec3f vertex;
+			vertex.x = std::strtof( c+1, &end );
+			vertex.y = std::strtof( end, &end );
+			vertex.z = std::strtof( end, &end );
+			mesh.vertices.push_back( vertex );
+		}
+		else if ( c[0] == 'f' && (c[1] == ' ' || c[1] == '\t') )
+		{
+			// Face vertex is "v", "v/vt", "v//vn" or "v/vt/vn"; only position index is used.
+			polygon.clear();
+			++c;
+			while ( true )
+			{
+				char* end = nullptr;
+				const long index = std::strtol( c, &end, 10 );
+				if ( end == c )
+					break;
+				// Indices are 1-based, negative indices count from the last vertex.
+				polygon.push_back( index > 0 ? static_cast<int>( index-1 ) : static_cast<int>( mesh.vertices.size() + index ) );
+				c = end;
+				while ( *c != '\0' && *c != ' ' && *c != '\t' )
+					++c;
+			}
+			success = polygon.size() >= 3;
+			AddPolygon( polygon, mesh );
+		}
+	}
+	filestream.close();
+
+	return success && !mesh.triangles.empty() && mesh.IsValid();
+}
+
+
+
+enum class PlyType
+{
+	Unknown, Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64,
+};
+
+// What the property means for the mesh, so names are compared only once while parsing the header.
+enum class PlyRole
+{
+	None, X, Y, Z, NormalX, NormalY, NormalZ, VertexIndices,
+};
+
+// PLY property: scalar, or list of scalars prefixed with count.
+struct PlyProperty
+{
+	PlyType type = PlyType::Unknown;
+	PlyType count_type = PlyType::Unknown; // Unknown for scalars.
+	PlyRole role = PlyRole::None;
+};
+
+struct PlyElement
+{
+	std::string name;
+	size_t count = 0;
+	std::vector<PlyProperty> properties;
+};
+
+
+
+static PlyType ParsePlyType( const std::string& type )
+{
+	if ( type == "char" || type == "int8" ) return PlyType::Int8;
+	if ( type == "uchar" || type == "uint8" ) return PlyType::UInt8;
+	if ( type == "short" || type == "int16" ) return PlyType::Int16;
+	if ( type == "ushort" || type == "uint16" ) return PlyType::UInt16;
+	if ( type == "int" || type == "int32" ) return PlyType::Int32;
+	if ( type == "uint" || type == "uint32" ) return PlyType::UInt32;
+	if ( type == "float" || type == "float32" ) return PlyType::Float32;
+	if ( type == "double" || type == "float64" ) return PlyType::Float64;
+	return PlyType::Unknown;
+}
+
+
+
+static PlyRole ParsePlyRole( const std::string& element, const std::string& name )
+{
+	if ( element == "vertex" )
+	{
+		if ( name == "x" ) return PlyRole::X;
+		if ( name == "y" ) return PlyRole::Y;
+		if ( name == "z" ) return PlyRole::Z;
+		if ( name == "nx" ) return PlyRole::NormalX;
+		if ( name == "ny" ) return PlyRole::NormalY;
+		if ( name == "nz" ) return PlyRole::NormalZ;
+	}
+	if ( element == "face" && (name == "vertex_indices" || name == "vertex_index") )
+		return PlyRole::VertexIndices;
+	return PlyRole::None;
+}
+
+
+
+// Reads values of all formats as double, which represents every PLY type exactly.
+class PlyReader
+{
+public:
+	PlyReader( std::istream& stream, const bool binary, const bool bigEndian ) : stream( stream ), binary( binary ), bigEndian( bigEndian ), linePos( nullptr ) {}
+
+	bool Read( const PlyType type, double& value )
+	{
+		if ( !binary )
+		{
+			// Ascii elements are one per line, but values are taken token by token.
+			while ( true )
+			{
+				if ( linePos != nullptr )
+				{
+					char* end = nullptr;
+					value = std::strtod( linePos, &end );
+					if ( end != linePos )
+					{
+						linePos = end;
+						return true;
+					}
+				}
+				if ( !std::getline( stream, line ) )
+					return false;
+				linePos = line.c_str();
+			}
+		}
+
+		static const int type_sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+		const int size = type_sizes[ static_cast<int>( type ) ];
+		unsigned char bytes[8];
+		if ( size == 0 || !stream.read( reinterpret_cast<char*>( bytes ), size ) )
+			return false;
+		if ( bigEndian )
+			std::reverse( bytes, bytes + size );
+		switch ( type )
+		{
+		case PlyType::Int8: { int8_t v; std::memcpy( &v, bytes, 1 ); value = v; break; }
+		case PlyType::UInt8: { uint8_t v; std::memcpy( &v, bytes, 1 ); value = v; break; }
+		case PlyType::Int16: { int16_t v; std::memcpy( &v, bytes, 2 ); value = v; break; }
+		case PlyType::UInt16: { uint16_t v; std::memcpy( &v, bytes, 2 ); value = v; break; }
+		case PlyType::Int32: { int32_t v; std::memcpy( &v, bytes, 4 ); value = v; break; }
+		case PlyType::UInt32: { uint32_t v; std::memcpy( &v, bytes, 4 ); value = v; break; }
+		case PlyType::Float32: { float v; std::memcpy( &v, bytes, 4 ); value = v; break; }
+		default: { double v; std::memcpy( &v, bytes, 8 ); value = v; break; }
+		}
+		return true;
+	}
+
+private:
+	std::istream& stream;
+	const bool binary;
+	const bool bigEndian;
+	std::string line;
+	const char* linePos;
+};
+
+
+
+bool MeshLoader::LoadPly( const std::string& file_path, TriangleMesh& mesh )
+{
+	mesh.Clear();
+	std::ifstream filestream;
+	std::vector<char> buffer( stream_buffer_size );
+	filestream.rdbuf()->pubsetbuf( buffer.data(), buffer.size() );
+	filestream.open( file_path, std::ifstream::in | std::ifstream::binary );
+	if ( !filestream.is_open() )
+		return false;
+
+	// +++++ Parse header. +++++
+	std::string line;
+	std::vector<PlyElement> elements;
+	std::string format;
+	bool success = std::getline( filestream, line ) && line.compare( 0, 3, "ply" ) == 0;
+	while ( success )
+	{
+		success = !!std::getline( filestream, line );
+		if ( !line.empty() && line.back() == '\r' )
+			line.pop_back();
+		std::istringstream lineStream( line );
+		std::string keyword;
+		lineStream >> keyword;
+		if ( keyword == "end_header" )
+			break;
+		if ( keyword == "format" )
+		{
+			lineStream >> format;
+		}
+		else if ( keyword == "element" )
+		{
+			PlyElement element;
+			lineStream >> element.name >> element.count;
+			elements.push_back( element );
+		}
+		else if ( keyword == "property" && !elements.empty() )
+		{
+			std::string type, countType, name;
+			lineStream >> type;
+			if ( type == "list" )
+				lineStream >> countType >> type;
+			lineStream >> name;
+			PlyProperty property;
+			property.type = ParsePlyType( type );
+			property.count_type = countType.empty() ? PlyType::Unknown : ParsePlyType( countType );
+			property.role = ParsePlyRole( elements.back().name, name );
+			success = property.type != PlyType::Unknown && (countType.empty() || property.count_type != PlyType::Unknown);
+			elements.back().properties.push_back( property );
+		}
+	}
+	const bool binary = format != "ascii";
+	success = success && (format == "ascii" || format == "binary_little_endian" || format == "binary_big_endian");
+	// ----- Parse header. -----
+
+	// +++++ Read elements. +++++
+	PlyReader reader( filestream, binary, format == "binary_big_endian" );
+	std::vector<int> polygon;
+	for ( size_t elementId = 0; elementId < elements.size() && success; ++elementId )
+	{
+		const PlyElement& element = elements[elementId];
+		const bool isVertex = element.name == "vertex";
+		const bool isFace = element.name == "face";
+		bool hasNormals = false;
+		for ( const PlyProperty& property : element.properties )
+			hasNormals = hasNormals || property.role == PlyRole::NormalX;
+		if ( isVertex )
+		{
+			mesh.vertices.reserve( std::min( element.count, max_reserved_items ) );
+			if ( hasNormals )
+				mesh.normals.reserve( std::min( element.count, max_reserved_items ) );
+		}
+		if ( isFace )
+			mesh.triangles.reserve( std::min( element.count, max_reserved_items ) );
+
+		for ( size_t itemId = 0; itemId < element.count && success; ++itemId )
+		{
+			Vec3f vertex, normal;
+			for ( const PlyProperty& property : element.properties )
+			{
+				double value = 0.0;
+				if ( property.count_type == PlyType::Unknown )
+				{
+					success = reader.Read( property.type, value );
+					switch ( property.role )
+					{
+					case PlyRole::X: vertex.x = static_cast<float>( value ); break;
+					case PlyRole::Y: vertex.y = static_cast<float>( value ); break;
+					case PlyRole::Z: vertex.z = static_cast<float>( value ); break;
+					case PlyRole::NormalX: normal.x = static_cast<float>( value ); break;
+					case PlyRole::NormalY: normal.y = static_cast<float>( value ); break;
+					case PlyRole::NormalZ: normal.z = static_cast<float>( value ); break;
+					default: break;
+					}
+				}
+				else
+				{
+					double count = 0.0;
+					success = reader.Read( property.count_type, count );
+					const bool isIndices = property.role == PlyRole::VertexIndices;
+					polygon.clear();
+					for ( int i = 0; i < static_cast<int>( count ) && success; ++i )
+					{
+						success = reader.Read( property.type, value );
+						if ( isIndices )
+							polygon.push_back( static_cast<int>( value ) );
+					}
+					if ( isIndices )
+						AddPolygon( polygon, mesh );
+				}
+				if ( !success )
+					break;
+			}
+			if ( isVertex )
+			{
+				mesh.vertices.push_back( vertex );
+				if ( hasNormals )
+					mesh.normals.push_back( normal );
+			}
+		}
+	}
+	// ----- Read elements. -----
+	filestream.close();
+
+	return success && !mesh.triangles.empty() && mesh.IsValid();
+}
@@ -0,0 +1,33 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - MeshLoader
+*
+* Streaming loader of triangle meshes from OBJ and PLY files.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_MESHLOADER_H
+#define RENDERINGNAIVE_MESHLOADER_H
+
+#include <string>
+
+struct TriangleMesh;
+
+
+// Files are read sequentially, vertices and faces go directly into mesh arrays, polygons are triangulated as fans.
+// OBJ: positions and faces ("v", "f"; texture coordinates and normals of faces are ignored, negative indices are supported).
+// PLY: ascii, binary little and big endian; vertex positions, optional vertex normals and face index lists.
+
+class MeshLoader
+{
+public:
+	// Format is chosen by the file extension (.obj or .ply).
+	static bool Load( const std::string& file_path, TriangleMesh& mesh );
+
+	static bool LoadObj( const std::string& file_path, TriangleMesh& mesh );
+	static bool LoadPly( const std::string& file_path, TriangleMesh& mesh );
+};
+
+#endif // RENDERINGNAIVE_MESHLOADER_H
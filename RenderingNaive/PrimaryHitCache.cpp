@@ -0,0 +1,121 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - PrimaryHitCache
+*
+* Hits of primary rays of views, reused by re-renders of the same geometry (e.g., after changes of lights or materials only).
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "PrimaryHitCache.h"
+
+#include <fstream>
+
+#include "BinaryStream.h"
+
+
+const uint32_t primary_hit_cache_magic = 0x48504c46; // "FLPH" in little endian.
+const uint32_t primary_hit_cache_version = 1;
+
+
+
+// Primary rays of the view depend on these fields only; the image is not hashed, just its size.
+static uint64_t ViewKey( const uint64_t geometryHash, const RenderView& view )
+{
+	uint64_t hash = HashBinary( binary_hash_seed, geometryHash );
+	hash = HashBinary( hash, static_cast<int32_t>( view.image->Width() ) );
+	hash = HashBinary( hash, static_cast<int32_t>( view.image->Height() ) );
+	hash = HashBinary( hash, view.position );
+	hash = HashBinary( hash, view.screen_half_size );
+	hash = HashBinary( hash, static_cast<uint8_t>( view.projector ) );
+	hash = HashBinary( hash, static_cast<uint8_t>( view.vertical_parallax ) );
+	return HashBinary( hash, view.observer_distance );
+}
+
+
+
+int PrimaryHitCache::Attach( const RayTracer& rayTracer, std::vector<RenderView>& views )
+{
+	const uint64_t geometryHash = rayTracer.GeometryHash();
+	const size_t numViews = views.size();
+	keys.resize( numViews, 0 );
+	hits.resize( numViews );
+
+	int numReused = 0;
+	for ( size_t viewId = 0; viewId < numViews; ++viewId )
+	{
+		RenderView& view = views[viewId];
+		const uint64_t key = ViewKey( geometryHash, view );
+		const size_t numPixels = static_cast<size_t>( view.image->Width() ) * view.image->Height();
+		view.reuse_primary_hits = keys[viewId] == key && hits[viewId].size() == numPixels;
+		// Key covers the geometry, not the hits themselves, so hits of a corrupted file must not index primitives out of range.
+		for ( size_t i = 0; i < numPixels && view.reuse_primary_hits; ++i )
+			view.reuse_primary_hits = rayTracer.IsHitValid( hits[viewId][i] );
+		if ( view.reuse_primary_hits )
+		{
+			++numReused;
+		}
+		else
+		{
+			keys[viewId] = key;
+			hits[viewId].assign( numPixels, PrimitiveHit() );
+		}
+		view.primary_hits = hits[viewId].data();
+	}
+	return numReused;
+}
+
+
+
+void PrimaryHitCache::Detach( std::vector<RenderView>& views )
+{
+	for ( RenderView& view : views )
+	{
+		view.primary_hits = nullptr;
+		view.reuse_primary_hits = false;
+	}
+}
+
+
+
+bool PrimaryHitCache::Read( const std::string& file_path )
+{
+	keys.clear();
+	hits.clear();
+
+	std::ifstream filestream( file_path, std::ifstream::in | std::ifstream::binary );
+	uint32_t magic = 0, version = 0;
+	int32_t numViews = 0;
+	if ( !filestream.is_open() || !ReadBinary( filestream, magic ) || !ReadBinary( filestream, version ) || !ReadBinary( filestream, numViews ) ||
+		magic != primary_hit_cache_magic || version != primary_hit_cache_version || numViews < 0 )
+		return false;
+
+	// Views are appended one by one, so a corrupted count fails at the end of the stream, not at allocation.
+	std::vector<uint64_t> readKeys;
+	std::vector<std::vector<PrimitiveHit>> readHits;
+	for ( int viewId = 0; viewId < numViews; ++viewId )
+	{
+		readKeys.push_back( 0 );
+		readHits.emplace_back();
+		if ( !ReadBinary( filestream, readKeys.back() ) || !ReadBinaryVector( filestream, readHits.back() ) )
+			return false;
+	}
+
+	keys.swap( readKeys );
+	hits.swap( readHits );
+	return true;
+}
+
+
+
+bool PrimaryHitCache::Write( const std::string& file_path ) const
+{
+	std::ofstream filestream( file_path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc );
+	bool written = filestream.is_open() && WriteBinary( filestream, primary_hit_cache_magic ) && WriteBinary( filestream, primary_hit_cache_version ) &&
+		WriteBinary( filestream, static_cast<int32_t>( keys.size() ) );
+	for ( size_t viewId = 0; viewId < keys.size() && written; ++viewId )
+		written = WriteBinary( filestream, keys[viewId] ) && WriteBinaryVector( filestream, hits[viewId] );
+	filestream.close();
+	return written && !filestream.fail();
+}
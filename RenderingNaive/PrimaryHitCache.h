@@ -0,0 +1,43 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - PrimaryHitCache
+*
+* Hits of primary rays of views, reused by re-renders of the same geometry (e.g., after changes of lights or materials only).
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_PRIMARYHITCACHE_H
+#define RENDERINGNAIVE_PRIMARYHITCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RayTracer.h"
+
+
+// Hits of rays through pixel centers are kept per view (see RenderView::primary_hits), with a key of the geometry of the scene
+// (see RayTracer::GeometryHash) and of the view. Views are matched by their index: a view, whose key equals the stored one,
+// reuses the hits and is only shaded, other views store their hits anew while rendering. Adaptive anti-aliasing samples
+// are never cached. Hits are saved to a binary file (for the same machine), so shading-only iterations skip primary intersection
+// across runs of the program.
+
+class PrimaryHitCache
+{
+public:
+	// Points views to their hits, until Detach. Returns number of views, whose hits are reused.
+	int Attach( const RayTracer& rayTracer, std::vector<RenderView>& views );
+	static void Detach( std::vector<RenderView>& views );
+
+	// Reading fails (and clears the cache) if the file is absent, of other version, or corrupted.
+	bool Read( const std::string& file_path );
+	bool Write( const std::string& file_path ) const;
+
+private:
+	std::vector<uint64_t> keys; // Per view.
+	std::vector<std::vector<PrimitiveHit>> hits;
+};
+
+#endif // RENDERINGNAIVE_PRIMARYHITCACHE_H
@@ -0,0 +1,237 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - ProgressiveRenderer
+*
+* Renders views in successive refinement passes under a wall-clock budget, with resumable checkpoints.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ProgressiveRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "BinaryStream.h"
+#include "TileScheduler.h"
+
+
+const uint32_t checkpoint_magic = 0x52504c46; // "FLPR" in little endian.
+const uint32_t checkpoint_version = 1;
+const int default_max_passes = 16;
+const float default_checkpoint_interval = 60.0f;
+
+
+
+// FNV-1a hash of the scene and geometry of the views; images of views are not hashed.
+static uint64_t SetupHash( RayTracer& rayTracer, const std::vector<RenderView>& views )
+{
+	std::ostringstream stream( std::ios::out | std::ios::binary );
+	rayTracer.WriteScene( stream );
+	for ( const RenderView& view : views )
+	{
+		WriteBinary( stream, static_cast<int32_t>( view.image->Width() ) );
+		WriteBinary( stream, static_cast<int32_t>( view.image->Height() ) );
+		WriteBinary( stream, view.position );
+		WriteBinary( stream, view.screen_half_size );
+		WriteBinary( stream, static_cast<uint8_t>( view.projector ) );
+		WriteBinary( stream, static_cast<uint8_t>( view.vertical_parallax ) );
+		WriteBinary( stream, view.observer_distance );
+	}
+	const std::string bytes = stream.str();
+	return HashBinary( binary_hash_seed, bytes.data(), bytes.size() );
+}
+
+
+
+ProgressiveRenderer::ProgressiveRenderer()
+	:maxPasses( default_max_passes )
+	,timeBudget( 0.0f )
+	,checkpointInterval( default_checkpoint_interval )
+	,resumedPasses( 0 )
+	,completedPasses( 0 )
+{
+
+}
+
+
+
+bool ProgressiveRenderer::SetMaxPasses( const int maxPasses )
+{
+	if ( maxPasses <= 0 )
+		return false;
+	this->maxPasses = maxPasses;
+	return true;
+}
+
+
+
+bool ProgressiveRenderer::SetTimeBudget( const float timeBudget )
+{
+	if ( timeBudget < 0.0f )
+		return false;
+	this->timeBudget = timeBudget;
+	return true;
+}
+
+
+
+bool ProgressiveRenderer::SetCheckpoint( const std::string& file_path, const float checkpointInterval )
+{
+	if ( checkpointInterval < 0.0f )
+		return false;
+	this->checkpointPath = file_path;
+	this->checkpointInterval = checkpointInterval;
+	return true;
+}
+
+
+
+bool ProgressiveRenderer::Render( RayTracer& rayTracer, const std::vector<RenderView>& views )
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point startTime = Clock::now();
+	const int numViews = static_cast<int>( views.size() );
+
+	// +++++ Resume from the checkpoint, or start from scratch. +++++
+	const uint64_t setupHash = SetupHash( rayTracer, views );
+	if ( checkpointPath.empty() || !ReadCheckpoint( setupHash, views ) )
+	{
+		sums.assign( numViews, std::vector<Vec3f>() );
+		passes.assign( numViews, 0 );
+		for ( int viewId = 0; viewId < numViews; ++viewId )
+			sums[viewId].assign( views[viewId].image->Width() * views[viewId].image->Height(), Vec3f( 0.0f, 0.0f, 0.0f ) );
+	}
+	resumedPasses = numViews > 0 ? *std::min_element( passes.begin(), passes.end() ) : 0;
+	if ( resumedPasses > 0 )
+		std::cout << "Resumed from checkpoint with " << resumedPasses << " passes done." << std::endl;
+	// ----- Resume from the checkpoint, or start from scratch. -----
+
+	// +++++ Render passes view by view, until all passes are done or the next step would exceed the budget. +++++
+	TileScheduler tileScheduler;
+	tileScheduler.SetProgressReport( false );
+	std::vector<RenderView> stepViews( 1 );
+	Image2D sample;
+	Clock::time_point checkpointTime = startTime;
+	float stepSeconds = 0.0f;
+	bool checkpointDirty = false;
+	int numSteps = 0;
+	while ( numViews > 0 )
+	{
+		const int viewId = static_cast<int>( std::min_element( passes.begin(), passes.end() ) - passes.begin() );
+		if ( passes[viewId] >= maxPasses )
+			break;
+		const float elapsed = std::chrono::duration<float>( Clock::now() - startTime ).count();
+		if ( timeBudget > 0.0f && elapsed + stepSeconds > timeBudget )
+			break;
+
+		const Clock::time_point stepTime = Clock::now();
+		const int width = views[viewId].image->Width();
+		const int height = views[viewId].image->Height();
+		sample.Resize( width, height );
+		stepViews[0] = views[viewId];
+		stepViews[0].image = &sample;
+		stepViews[0].pixel_strata = nullptr;
+		stepViews[0].sample_id = passes[viewId];
+		tileScheduler.Render( rayTracer, stepViews );
+
+		std::vector<Vec3f>& sum = sums[viewId];
+		const Vec3f* sampleData = sample.Data();
+#pragma omp parallel for
+		for ( int j = 0; j < height; ++j )
+		{
+			for ( size_t k = static_cast<size_t>(j)*width; k < static_cast<size_t>(j+1)*width; ++k )
+				sum[k] = sum[k] + sampleData[k];
+		}
+		++passes[viewId];
+		++numSteps;
+		checkpointDirty = true;
+		stepSeconds = std::chrono::duration<float>( Clock::now() - stepTime ).count();
+
+		if ( !checkpointPath.empty() && std::chrono::duration<float>( Clock::now() - checkpointTime ).count() >= checkpointInterval )
+		{
+			if ( !WriteCheckpoint( setupHash ) )
+				std::cout << "Could not write checkpoint " << checkpointPath << "." << std::endl;
+			checkpointTime = Clock::now();
+			checkpointDirty = false;
+		}
+	}
+	if ( !checkpointPath.empty() && checkpointDirty && !WriteCheckpoint( setupHash ) )
+		std::cout << "Could not write checkpoint " << checkpointPath << "." << std::endl;
+	// ----- Render passes view by view, until all passes are done or the next step would exceed the budget. -----
+
+	// +++++ Average the samples. +++++
+	for ( int viewId = 0; viewId < numViews; ++viewId )
+	{
+		Vec3f* data = views[viewId].image->Data();
+		const float scale = passes[viewId] > 0 ? 1.0f / passes[viewId] : 0.0f;
+		const int numPixels = static_cast<int>( sums[viewId].size() );
+#pragma omp parallel for
+		for ( int k = 0; k < numPixels; ++k )
+			data[k] = sums[viewId][k] * scale;
+	}
+	// ----- Average the samples. -----
+
+	completedPasses = numViews > 0 ? *std::min_element( passes.begin(), passes.end() ) : 0;
+	std::cout << "Rendered " << numSteps << " view passes in " << std::chrono::duration<float>( Clock::now() - startTime ).count() << " s, "
+		<< completedPasses << " of " << maxPasses << " passes done for all views." << std::endl;
+	return completedPasses >= maxPasses;
+}
+
+
+
+bool ProgressiveRenderer::ReadCheckpoint( const uint64_t setupHash, const std::vector<RenderView>& views )
+{
+	std::ifstream filestream( checkpointPath, std::ifstream::in | std::ifstream::binary );
+	uint32_t magic = 0, version = 0;
+	uint64_t hash = 0;
+	int32_t numViews = 0;
+	if ( !filestream.is_open() || !ReadBinary( filestream, magic ) || !ReadBinary( filestream, version ) || !ReadBinary( filestream, hash ) || !ReadBinary( filestream, numViews ) ||
+		magic != checkpoint_magic || version != checkpoint_version || hash != setupHash || numViews != static_cast<int32_t>( views.size() ) )
+		return false;
+
+	std::vector<std::vector<Vec3f>> readSums( numViews );
+	std::vector<int> readPasses( numViews );
+	for ( int viewId = 0; viewId < numViews; ++viewId )
+	{
+		int32_t viewPasses = 0;
+		if ( !ReadBinary( filestream, viewPasses ) || !ReadBinaryVector( filestream, readSums[viewId] ) || viewPasses < 0 ||
+			readSums[viewId].size() != views[viewId].image->Width() * views[viewId].image->Height() )
+			return false;
+		readPasses[viewId] = viewPasses;
+	}
+
+	sums.swap( readSums );
+	passes.swap( readPasses );
+	return true;
+}
+
+
+
+// Checkpoint is written to a temporary file and then renamed, so a job killed while writing keeps the previous one.
+bool ProgressiveRenderer::WriteCheckpoint( const uint64_t setupHash ) const
+{
+	const std::string tempPath = checkpointPath + ".tmp";
+	std::ofstream filestream( tempPath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc );
+	bool written = filestream.is_open() && WriteBinary( filestream, checkpoint_magic ) && WriteBinary( filestream, checkpoint_version ) &&
+		WriteBinary( filestream, setupHash ) && WriteBinary( filestream, static_cast<int32_t>( passes.size() ) );
+	for ( size_t viewId = 0; viewId < passes.size() && written; ++viewId )
+		written = WriteBinary( filestream, static_cast<int32_t>( passes[viewId] ) ) && WriteBinaryVector( filestream, sums[viewId] );
+	filestream.close();
+	written = written && !filestream.fail();
+
+	// Renaming replaces the previous checkpoint atomically on POSIX; elsewhere it has to be removed first.
+	if ( written && std::rename( tempPath.c_str(), checkpointPath.c_str() ) != 0 )
+	{
+		std::remove( checkpointPath.c_str() );
+		written = std::rename( tempPath.c_str(), checkpointPath.c_str() ) == 0;
+	}
+	if ( !written )
+		std::remove( tempPath.c_str() );
+	return written;
+}
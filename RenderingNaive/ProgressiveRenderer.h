@@ -0,0 +1,60 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - ProgressiveRenderer
+*
+* Renders views in successive refinement passes under a wall-clock budget, with resumable checkpoints.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_PROGRESSIVERENDERER_H
+#define RENDERINGNAIVE_PROGRESSIVERENDERER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RayTracer.h"
+
+
+// Every pass adds one sample per pixel: the first pass samples pixel centers, the next ones are jittered within pixels.
+// Samples are accumulated per view. A step renders the next pass of the view with the fewest passes, so views differ
+// by at most one pass, and the time budget is checked between steps. Accumulated sums and numbers of passes
+// are written to the checkpoint file at the given interval and when rendering stops. Checkpoint is identified by hash
+// of the scene and the views: with the same scene and views, rendering resumes from it and finished passes are not
+// recomputed; otherwise it is ignored and overwritten.
+
+class ProgressiveRenderer
+{
+public:
+	ProgressiveRenderer();
+
+	bool SetMaxPasses( const int maxPasses );
+	bool SetTimeBudget( const float timeBudget ); // Seconds of one Render call, 0 means no limit.
+	bool SetCheckpoint( const std::string& file_path, const float checkpointInterval ); // Empty path disables checkpoints.
+
+	// Renders passes until all views have maxPasses of them, or the time budget is spent; images of views have to be
+	// allocated, they receive averages of the accumulated samples. Returns true if all passes are done.
+	bool Render( RayTracer& rayTracer, const std::vector<RenderView>& views );
+
+	// Passes of the last Render call: done before it (resumed from checkpoint) and done in total.
+	int ResumedPasses() const { return resumedPasses; }
+	int CompletedPasses() const { return completedPasses; }
+
+private:
+	bool ReadCheckpoint( const uint64_t setupHash, const std::vector<RenderView>& views );
+	bool WriteCheckpoint( const uint64_t setupHash ) const;
+
+	int maxPasses;
+	float timeBudget;
+	std::string checkpointPath;
+	float checkpointInterval;
+
+	std::vector<std::vector<Vec3f>> sums; // Sums of samples per view.
+	std::vector<int> passes; // Passes per view.
+	int resumedPasses;
+	int completedPasses;
+};
+
+#endif // RENDERINGNAIVE_PROGRESSIVERENDERER_H
@@ -0,0 +1,152 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - RayStatistics
+*
+* Optional counters of the ray tracer (rays, intersection tests, BVH nodes), compiled in with ENABLE_RAY_STATISTICS.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "RayStatistics.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+#include "Image2D.h"
+#include "TileScheduler.h"
+#include "json.hpp"
+
+
+// Counters of all threads, which have ever counted something. Deque never moves its elements, so threads keep pointers to them.
+static std::mutex registryMutex;
+static std::deque<RayCounters> registry;
+
+
+
+void RayCounters::Add( const RayCounters& counters )
+{
+	primary_rays += counters.primary_rays;
+	secondary_rays += counters.secondary_rays;
+	shadow_rays += counters.shadow_rays;
+	culled_rays += counters.culled_rays;
+	bvh_nodes += counters.bvh_nodes;
+	sphere_tests += counters.sphere_tests;
+	quad_tests += counters.quad_tests;
+	box_tests += counters.box_tests;
+	triangle_tests += counters.triangle_tests;
+	for ( int depth = 0; depth < ray_statistics_depths; ++depth )
+		terminated_rays[depth] += counters.terminated_rays[depth];
+}
+
+
+
+RayCounters& RayStatistics::ThreadCounters()
+{
+	// Only the first call of a thread takes the lock.
+	thread_local RayCounters* counters = nullptr;
+	if ( counters == nullptr )
+	{
+		std::lock_guard<std::mutex> lock( registryMutex );
+		registry.emplace_back();
+		counters = &registry.back();
+	}
+	return *counters;
+}
+
+
+
+RayCounters RayStatistics::Total()
+{
+	std::lock_guard<std::mutex> lock( registryMutex );
+	RayCounters total;
+	for ( const RayCounters& counters : registry )
+		total.Add( counters );
+	return total;
+}
+
+
+
+void RayStatistics::Reset()
+{
+	std::lock_guard<std::mutex> lock( registryMutex );
+	for ( RayCounters& counters : registry )
+		counters = RayCounters();
+}
+
+
+
+bool RayStatistics::Serialize( const std::string& file_path, const RayCounters& counters, const std::vector<TileCost>& tileCosts )
+{
+	std::fstream filestream;
+	nlohmann::json json;
+
+	bool success = true;
+
+	try
+	{
+		const uint64_t numRays = counters.primary_rays + counters.secondary_rays + counters.shadow_rays;
+		const double rayScale = numRays > 0 ? 1.0 / numRays : 0.0;
+		json["primary_rays"] = counters.primary_rays;
+		json["secondary_rays"] = counters.secondary_rays;
+		json["shadow_rays"] = counters.shadow_rays;
+		json["culled_rays"] = counters.culled_rays;
+		json["bvh_nodes"] = counters.bvh_nodes;
+		json["sphere_tests"] = counters.sphere_tests;
+		json["quad_tests"] = counters.quad_tests;
+		json["box_tests"] = counters.box_tests;
+		json["triangle_tests"] = counters.triangle_tests;
+		json["bvh_nodes_per_ray"] = counters.bvh_nodes * rayScale;
+		json["intersection_tests_per_ray"] = counters.IntersectionTests() * rayScale;
+
+		// Trailing depths, which no path reached, are omitted.
+		int numDepths = ray_statistics_depths;
+		while ( numDepths > 0 && counters.terminated_rays[numDepths-1] == 0 )
+			--numDepths;
+		json["terminated_rays_per_depth"] = nlohmann::json::array();
+		for ( int depth = 0; depth < numDepths; ++depth )
+			json["terminated_rays_per_depth"].push_back( counters.terminated_rays[depth] );
+
+		json["tiles"] = nlohmann::json::array();
+		for ( const TileCost& cost : tileCosts )
+		{
+			nlohmann::json item;
+			item["view"] = cost.view_id;
+			item["x"] = cost.x_begin;
+			item["y"] = cost.y_begin;
+			item["seconds"] = cost.seconds;
+			item["thread"] = cost.thread_id;
+			item["stolen"] = cost.stolen;
+			json["tiles"].push_back( item );
+		}
+
+		filestream.open( file_path, std::ofstream::out );
+		filestream << std::setw( 4 ) << json << std::endl;
+		filestream.close();
+		success = !filestream.fail();
+	}
+	catch ( ... )
+	{
+		success = false;
+	}
+
+	filestream.close();
+
+	return success;
+}
+
+
+
+void RayStatistics::HeatmapImage( const std::vector<float>& pixelWork, const int width, const int height, const float maxWork, Image2D& image )
+{
+	image.Resize( width, height );
+	const float scale = maxWork > 0.0f ? 1.0f / maxWork : 0.0f;
+	for ( size_t i = 0; i < pixelWork.size() && i < static_cast<size_t>( width )*height; ++i )
+	{
+		const float t = std::min( pixelWork[i] * scale, 1.0f );
+		image.Data()[i] = t < 0.5f ? Vec3f( 0.0f, 2.0f*t, 1.0f - 2.0f*t ) : Vec3f( 2.0f*t - 1.0f, 2.0f - 2.0f*t, 0.0f );
+	}
+}
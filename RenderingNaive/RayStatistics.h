@@ -0,0 +1,84 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - RayStatistics
+*
+* Optional counters of the ray tracer (rays, intersection tests, BVH nodes), compiled in with ENABLE_RAY_STATISTICS.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_RAYSTATISTICS_H
+#define RENDERINGNAIVE_RAYSTATISTICS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Image2D;
+struct TileCost;
+
+
+// Counters are updated in hot paths through RAY_STATISTICS_ADD, which compiles to nothing unless RAY_STATISTICS is defined
+// (CMake option ENABLE_RAY_STATISTICS). Every thread updates its own counters without locks or atomics; they are summed
+// when rendering is over. Work of a ray is the number of visited BVH nodes and primitive tests, it is also recorded per pixel.
+
+#ifdef RAY_STATISTICS
+#define RAY_STATISTICS_ADD( counter, value ) (RayStatistics::ThreadCounters().counter += (value))
+#else
+#define RAY_STATISTICS_ADD( counter, value ) ((void)0)
+#endif
+
+
+const int ray_statistics_depths = 32;
+
+// Aligned to cache lines, so counters of different threads never share one.
+struct alignas( 64 ) RayCounters
+{
+	uint64_t primary_rays = 0;
+	uint64_t secondary_rays = 0; // Reflected and refracted.
+	uint64_t shadow_rays = 0;
+	uint64_t culled_rays = 0; // Primary rays of tiles, which miss the scene bounds; they are not traced, nor counted as primary rays.
+	uint64_t bvh_nodes = 0; // Visited nodes of the scene and mesh hierarchies; a packet visits a node once.
+	uint64_t sphere_tests = 0;
+	uint64_t quad_tests = 0;
+	uint64_t box_tests = 0;
+	uint64_t triangle_tests = 0;
+	uint64_t terminated_rays[ray_statistics_depths] = {}; // Paths ended at the depth: ray missed, or spawned no further rays.
+
+	uint64_t Work() const { return bvh_nodes + IntersectionTests(); }
+	uint64_t IntersectionTests() const { return sphere_tests + quad_tests + box_tests + triangle_tests; }
+	void Add( const RayCounters& counters );
+};
+
+
+class RayStatistics
+{
+public:
+#ifdef RAY_STATISTICS
+	static constexpr bool Enabled() { return true; }
+#else
+	static constexpr bool Enabled() { return false; }
+#endif
+
+	static RayCounters& ThreadCounters();
+	// Work done by the calling thread so far, 0 if statistics are compiled out.
+	static uint64_t ThreadWork()
+	{
+#ifdef RAY_STATISTICS
+		return ThreadCounters().Work();
+#else
+		return 0;
+#endif
+	}
+	// Sum of counters of all threads, and resetting them; only while no thread renders.
+	static RayCounters Total();
+	static void Reset();
+
+	// Counters with rates per ray, and costs of rendered tiles.
+	static bool Serialize( const std::string& file_path, const RayCounters& counters, const std::vector<TileCost>& tileCosts );
+	// Heatmap of work per pixel, from blue (no work) through green to red (maxWork and more).
+	static void HeatmapImage( const std::vector<float>& pixelWork, const int width, const int height, const float maxWork, Image2D& image );
+};
+
+#endif // RENDERINGNAIVE_RAYSTATISTICS_H
@@ -8,144 +8,1630 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
-#include "raytracer.h"
+#include "RayTracer.h"
 
+#include "BinaryStream.h"
+#include "RayStatistics.h"
+
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <limits>
 #include <vector>
 #include <algorithm>
 
 
-const float scene_epsilon = 0.05f;
-const int default_maxraydepth = 4;
+const float scene_epsilon = 0.05f;
+const float scene_max_distance = 100000.0f;
+const int default_maxraydepth = 4;
+const float default_minrayweight = 1e-3f;
+const int ray_stack_size = 32;
+const double quad_min_cosine = 1e-3; // Rays almost parallel to a quad miss it.
+const int ray_sort_cell_bits = 10; // Per axis.
+const float scene_bounds_padding = 1e-3f; // Relative to the largest extent of the scene, in addition to scene_epsilon.
+const Vec3f background_color( 0.2f, 0.7f, 0.8f );
+
+
+// Slab test of the ray up to maxDistance (in units of the direction; by default the whole ray) against the box.
+static bool RayHitsBounds( const Aabb& bounds, const Vec3f& origin, const Vec3f& direction, const float maxDistance = std::numeric_limits<float>::max() )
+{
+	float tEnter = 0.0f;
+	float tExit = maxDistance;
+	for ( size_t axis = 0; axis < 3; ++axis )
+	{
+		const float t1 = (bounds.min_corner[axis] - origin[axis]) / direction[axis];
+		const float t2 = (bounds.max_corner[axis] - origin[axis]) / direction[axis];
+		tEnter = std::max( tEnter, std::min( t1, t2 ) );
+		tExit = std::min( tExit, std::max( t1, t2 ) );
+	}
+	return tEnter <= tExit;
+}
+
+
+// Interval slab test of all rays with origins and directions (not necessarily normalized) within the given ranges:
+// bounds of the entry into and the exit from every slab over all the rays. If the latest entry is after the earliest exit
+// (or the exit is behind the origins), every ray misses the box.
+static bool RaysMissBounds( const Aabb& bounds, const Aabb& origins, const Aabb& directions )
+{
+	float latestEntry = 0.0f;
+	float earliestExit = std::numeric_limits<float>::max();
+	for ( size_t axis = 0; axis < 3; ++axis )
+	{
+		const float directionMin = directions.min_corner[axis], directionMax = directions.max_corner[axis];
+		if ( directionMin <= 0.0f && directionMax >= 0.0f )
+			continue; // Some rays may be parallel to the slab.
+		const float entryPlane = directionMin > 0.0f ? bounds.min_corner[axis] : bounds.max_corner[axis];
+		const float exitPlane = directionMin > 0.0f ? bounds.max_corner[axis] : bounds.min_corner[axis];
+		// Distances are monotonic in origin and direction, so their extremes are at the ends of the ranges.
+		float entryMin = std::numeric_limits<float>::max();
+		float exitMax = -std::numeric_limits<float>::max();
+		for ( int end = 0; end < 4; ++end )
+		{
+			const float origin = end & 1 ? origins.max_corner[axis] : origins.min_corner[axis];
+			const float direction = end & 2 ? directionMax : directionMin;
+			entryMin = std::min( entryMin, (entryPlane - origin) / direction );
+			exitMax = std::max( exitMax, (exitPlane - origin) / direction );
+		}
+		latestEntry = std::max( latestEntry, entryMin );
+		earliestExit = std::min( earliestExit, exitMax );
+	}
+	return latestEntry > earliestExit;
+}
+
+
+static bool EqualVectors( const Vec3f& a, const Vec3f& b )
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+
+static Aabb LightBounds( const Light& light )
+{
+	const Vec3f radius( light.radius, light.radius, light.radius );
+	return Aabb( light.position - radius, light.position + radius );
+}
+
+
+// Deterministic jitter in [0, 1) for the given seed (integer hash), so images do not depend on the order of rendering.
+static float SampleJitter( uint32_t seed )
+{
+	seed = (seed ^ 61u) ^ (seed >> 16);
+	seed *= 9u;
+	seed = seed ^ (seed >> 4);
+	seed *= 0x27d4eb2du;
+	seed = seed ^ (seed >> 15);
+	return static_cast<float>( seed >> 8 ) * (1.0f / 16777216.0f);
+}
+
+
+// Fills lanes of the packet with consecutive rays; tail lanes repeat the last ray and stay inactive.
+static void LoadRayPacket( const Vec3f* origins, const Vec3f* directions, const int packetSize, RayPacket& packet )
+{
+	for ( int lane = 0; lane < ray_packet_size; lane++ )
+	{
+		const int i = std::min( lane, packetSize-1 );
+		packet.origin_x[lane] = origins[i].x;
+		packet.origin_y[lane] = origins[i].y;
+		packet.origin_z[lane] = origins[i].z;
+		packet.direction_x[lane] = directions[i].x;
+		packet.direction_y[lane] = directions[i].y;
+		packet.direction_z[lane] = directions[i].z;
+		packet.inverse_direction_x[lane] = 1.0f / directions[i].x;
+		packet.inverse_direction_y[lane] = 1.0f / directions[i].y;
+		packet.inverse_direction_z[lane] = 1.0f / directions[i].z;
+		packet.distance[lane] = lane < packetSize ? std::numeric_limits<float>::max() : -1.0f;
+	}
+}
+
+
+// Pending ray of the iterative CastRay.
+struct RayTask
+{
+	RayTask() noexcept : depth( 0 ), weight( 0.0f ) {}
+	RayTask( const Vec3f& origin, const Vec3f& direction, const int depth, const float weight ) noexcept : origin( origin ), direction( direction ), depth( depth ), weight( weight ) {}
+	Vec3f origin;
+	Vec3f direction;
+	int depth;
+	float weight; // Contribution of the ray color to the pixel color.
+};
+
+
+// Rays of one depth of the wavefront in SoA layout.
+struct RayQueue
+{
+	std::vector<float> origin_x, origin_y, origin_z;
+	std::vector<float> direction_x, direction_y, direction_z;
+	std::vector<float> weight; // Contribution of the ray color to the pixel color.
+	std::vector<int> pixel;
+
+	int Size() const { return static_cast<int>( pixel.size() ); }
+	Vec3f Origin( const int k ) const { return Vec3f( origin_x[k], origin_y[k], origin_z[k] ); }
+	Vec3f Direction( const int k ) const { return Vec3f( direction_x[k], direction_y[k], direction_z[k] ); }
+	void Clear()
+	{
+		origin_x.clear(); origin_y.clear(); origin_z.clear();
+		direction_x.clear(); direction_y.clear(); direction_z.clear();
+		weight.clear();
+		pixel.clear();
+	}
+	void Push( const Vec3f& origin, const Vec3f& direction, const float rayWeight, const int rayPixel )
+	{
+		origin_x.push_back( origin.x ); origin_y.push_back( origin.y ); origin_z.push_back( origin.z );
+		direction_x.push_back( direction.x ); direction_y.push_back( direction.y ); direction_z.push_back( direction.z );
+		weight.push_back( rayWeight );
+		pixel.push_back( rayPixel );
+	}
+};
+
+
+// Fills lanes of the packet with consecutive rays of the queue, like the other LoadRayPacket.
+static void LoadRayPacket( const RayQueue& rays, const int first, const int packetSize, RayPacket& packet )
+{
+	for ( int lane = 0; lane < ray_packet_size; lane++ )
+	{
+		const int i = first + std::min( lane, packetSize-1 );
+		packet.origin_x[lane] = rays.origin_x[i];
+		packet.origin_y[lane] = rays.origin_y[i];
+		packet.origin_z[lane] = rays.origin_z[i];
+		packet.direction_x[lane] = rays.direction_x[i];
+		packet.direction_y[lane] = rays.direction_y[i];
+		packet.direction_z[lane] = rays.direction_z[i];
+		packet.inverse_direction_x[lane] = 1.0f / rays.direction_x[i];
+		packet.inverse_direction_y[lane] = 1.0f / rays.direction_y[i];
+		packet.inverse_direction_z[lane] = 1.0f / rays.direction_z[i];
+		packet.distance[lane] = lane < packetSize ? std::numeric_limits<float>::max() : -1.0f;
+	}
+}
+
+
+// Spreads the lower 10 bits, so that there are two zero bits between each of them.
+static uint32_t SpreadBits( uint32_t value )
+{
+	value &= 0x3ff;
+	value = (value | (value << 16)) & 0x030000ff;
+	value = (value | (value << 8)) & 0x0300f00f;
+	value = (value | (value << 4)) & 0x030c30c3;
+	value = (value | (value << 2)) & 0x09249249;
+	return value;
+}
+
+
+// Reorders rays by direction octant, then by Morton code of the origin cell, in batches of the given size.
+// Cells form a regular grid over the bounding box of origins of the batch. Rays of the same key keep their order.
+static void SortRays( const RayQueue& rays, const int batchSize, RayQueue& sortedRays )
+{
+	const int numRays = rays.Size();
+	const float numCells = static_cast<float>( 1 << ray_sort_cell_bits );
+	std::vector<uint64_t> keys( numRays ); // Sort key in the upper 33 bits, ray index in the lower 31 ones.
+	sortedRays.Clear();
+	for ( int first = 0; first < numRays; first += batchSize )
+	{
+		const int last = std::min( numRays, first + batchSize );
+		Vec3f boundsMin( rays.origin_x[first], rays.origin_y[first], rays.origin_z[first] );
+		Vec3f boundsMax = boundsMin;
+		for ( int k = first + 1; k < last; k++ )
+		{
+			boundsMin = Vec3f( std::min( boundsMin.x, rays.origin_x[k] ), std::min( boundsMin.y, rays.origin_y[k] ), std::min( boundsMin.z, rays.origin_z[k] ) );
+			boundsMax = Vec3f( std::max( boundsMax.x, rays.origin_x[k] ), std::max( boundsMax.y, rays.origin_y[k] ), std::max( boundsMax.z, rays.origin_z[k] ) );
+		}
+		const float extent = std::max( std::max( boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y ), std::max( boundsMax.z - boundsMin.z, 1e-6f ) );
+		const float scale = (numCells - 1.0f) / extent;
+		for ( int k = first; k < last; k++ )
+		{
+			const uint32_t octant = (rays.direction_x[k] < 0.0f ? 1u : 0u) | (rays.direction_y[k] < 0.0f ? 2u : 0u) | (rays.direction_z[k] < 0.0f ? 4u : 0u);
+			const uint32_t cell = SpreadBits( static_cast<uint32_t>( (rays.origin_x[k] - boundsMin.x) * scale ) ) |
+				(SpreadBits( static_cast<uint32_t>( (rays.origin_y[k] - boundsMin.y) * scale ) ) << 1) |
+				(SpreadBits( static_cast<uint32_t>( (rays.origin_z[k] - boundsMin.z) * scale ) ) << 2);
+			const uint64_t key = (static_cast<uint64_t>( octant ) << (3*ray_sort_cell_bits)) | cell;
+			keys[k] = (key << 31) | static_cast<uint32_t>( k );
+		}
+		std::sort( keys.begin() + first, keys.begin() + last );
+		for ( int k = first; k < last; k++ )
+		{
+			const int ray = static_cast<int>( keys[k] & 0x7fffffffu );
+			sortedRays.Push( rays.Origin( ray ), rays.Direction( ray ), rays.weight[ray], rays.pixel[ray] );
+		}
+	}
+}
+
+
+// Rays of the wavefront, which hit something, with hit points and gathered materials in SoA layout.
+struct HitQueue
+{
+	std::vector<int> ray;
+	std::vector<int> material_id;
+	std::vector<float> point_x, point_y, point_z;
+	std::vector<float> normal_x, normal_y, normal_z;
+	std::vector<float> diffuse_r, diffuse_g, diffuse_b;
+	std::vector<float> albedo_0, albedo_1;
+	std::vector<float> specular_exponent;
+	// Lighting stage.
+	std::vector<float> diffuse_intensity, specular_intensity;
+	std::vector<float> light_dir_x, light_dir_y, light_dir_z, light_distance;
+	std::vector<float> visibility;
+
+	int Size() const { return static_cast<int>( ray.size() ); }
+	Vec3f Point( const int k ) const { return Vec3f( point_x[k], point_y[k], point_z[k] ); }
+	Vec3f Normal( const int k ) const { return Vec3f( normal_x[k], normal_y[k], normal_z[k] ); }
+	void Clear()
+	{
+		ray.clear();
+		material_id.clear();
+		point_x.clear(); point_y.clear(); point_z.clear();
+		normal_x.clear(); normal_y.clear(); normal_z.clear();
+		diffuse_r.clear(); diffuse_g.clear(); diffuse_b.clear();
+		albedo_0.clear(); albedo_1.clear();
+		specular_exponent.clear();
+	}
+	void Push( const int hitRay, const Vec3f& point, const Vec3f& N, const int materialId, const Material& material )
+	{
+		ray.push_back( hitRay );
+		material_id.push_back( materialId );
+		point_x.push_back( point.x ); point_y.push_back( point.y ); point_z.push_back( point.z );
+		normal_x.push_back( N.x ); normal_y.push_back( N.y ); normal_z.push_back( N.z );
+		diffuse_r.push_back( material.diffuse_color.x ); diffuse_g.push_back( material.diffuse_color.y ); diffuse_b.push_back( material.diffuse_color.z );
+		albedo_0.push_back( material.albedo[0] ); albedo_1.push_back( material.albedo[1] );
+		specular_exponent.push_back( material.specular_exponent );
+	}
+	// Sizes the arrays of the lighting stage to the number of hits.
+	void ResizeLighting()
+	{
+		const size_t size = ray.size();
+		diffuse_intensity.assign( size, 0.0f ); specular_intensity.assign( size, 0.0f );
+		light_dir_x.resize( size ); light_dir_y.resize( size ); light_dir_z.resize( size ); light_distance.resize( size );
+		visibility.resize( size );
+	}
+};
+
+
+RayTracer::RayTracer()
+	:lightsChanged( false )
+	,lightSamples( 0 )
+	,geometryChanged( false )
+	,changesUnbounded( true )
+	,packetTracing( true )
+	,wavefront( false )
+	,raySortBatch( 0 )
+	,depthStatistics( ray_stack_size - 1 )
+	,maxRayDepth( default_maxraydepth )
+	,minRayWeight( default_minrayweight )
+{
+
+}
+
+
+RayTracer::~RayTracer()
+{
+
+}
+
+
+void RayTracer::RemoveAllGeometry()
+{
+	spheres.clear();
+	quads.clear();
+	boxes.clear();
+	meshes.clear();
+	meshesBvh.clear();
+	instances.clear();
+	instancesTransform.clear();
+	materials.clear();
+	geometryChanged = true;
+	movedPrimitives.clear();
+	changesUnbounded = true;
+}
+
+
+void RayTracer::RemoveAllLights()
+{
+	lights.clear();
+	lightsChanged = true;
+	changesUnbounded = true;
+}
+
+
+int RayTracer::AddMaterial( const Material& material )
+{
+	materials.push_back( material );
+	return static_cast<int>( materials.size() ) - 1;
+}
+
+
+bool RayTracer::AddSphere( const Sphere& sphere )
+{
+	if ( sphere.material_id < 0 || sphere.material_id >= static_cast<int>( materials.size() ) )
+		return false;
+	spheres.push_back( sphere );
+	geometryChanged = true;
+	return true;
+}
+
+
+bool RayTracer::AddQuad( const Quad& quad )
+{
+	const int numMaterials = static_cast<int>( materials.size() );
+	if ( quad.material_id < 0 || quad.material_id >= numMaterials || quad.checker_material_id >= numMaterials || quad.checker_cell_size <= 0.0f )
+		return false;
+	quads.push_back( quad );
+	geometryChanged = true;
+	return true;
+}
+
+
+bool RayTracer::AddBox( const Box& box )
+{
+	if ( box.material_id < 0 || box.material_id >= static_cast<int>( materials.size() ) )
+		return false;
+	boxes.push_back( box );
+	geometryChanged = true;
+	return true;
+}
+
+
+int RayTracer::AddSharedMesh( const TriangleMesh& mesh )
+{
+	if ( mesh.triangles.empty() || !mesh.IsValid() )
+		return -1;
+	meshes.push_back( mesh );
+	meshesBvh.push_back( Bvh() );
+	return static_cast<int>( meshes.size() ) - 1;
+}
+
+
+bool RayTracer::AddInstance( const Instance& instance )
+{
+	InstanceTransform transform;
+	if ( instance.mesh_id < 0 || instance.mesh_id >= static_cast<int>( meshes.size() ) ||
+		instance.material_id < 0 || instance.material_id >= static_cast<int>( materials.size() ) ||
+		!ComputeInstanceTransform( instance, transform ) )
+		return false;
+	instances.push_back( instance );
+	instancesTransform.push_back( transform );
+	geometryChanged = true;
+	return true;
+}
+
+
+bool RayTracer::AddMesh( const TriangleMesh& mesh, const int materialId )
+{
+	if ( materialId < 0 || materialId >= static_cast<int>( materials.size() ) )
+		return false;
+	const int meshId = AddSharedMesh( mesh );
+	return meshId >= 0 && AddInstance( Instance( meshId, materialId ) );
+}
+
+
+bool RayTracer::ComputeInstanceTransform( const Instance& instance, InstanceTransform& transform )
+{
+	// Inverse of the matrix of columns a, b, c has rows b x c, c x a, a x b, divided by the determinant.
+	const float determinant = dot( instance.axis_x, cross( instance.axis_y, instance.axis_z ) );
+	if ( !(std::fabs( determinant ) > 0.0f) || !std::isfinite( determinant ) )
+		return false;
+	transform.inverse_rows[0] = cross( instance.axis_y, instance.axis_z ) * (1.0f / determinant);
+	transform.inverse_rows[1] = cross( instance.axis_z, instance.axis_x ) * (1.0f / determinant);
+	transform.inverse_rows[2] = cross( instance.axis_x, instance.axis_y ) * (1.0f / determinant);
+	transform.position = instance.position;
+	transform.identity = EqualVectors( instance.position, Vec3f( 0, 0, 0 ) ) &&
+		EqualVectors( instance.axis_x, Vec3f( 1, 0, 0 ) ) && EqualVectors( instance.axis_y, Vec3f( 0, 1, 0 ) ) && EqualVectors( instance.axis_z, Vec3f( 0, 0, 1 ) );
+	return true;
+}
+
+
+Vec3f RayTracer::InstanceTransform::PointToObject( const Vec3f& point ) const
+{
+	return VectorToObject( point - position );
+}
+
+
+Vec3f RayTracer::InstanceTransform::VectorToObject( const Vec3f& vector ) const
+{
+	return Vec3f( inverse_rows[0] * vector, inverse_rows[1] * vector, inverse_rows[2] * vector );
+}
+
+
+Vec3f RayTracer::InstanceTransform::NormalToWorld( const Vec3f& normal ) const
+{
+	// Normals are transformed by the inverse transpose.
+	return inverse_rows[0] * normal.x + inverse_rows[1] * normal.y + inverse_rows[2] * normal.z;
+}
+
+
+void RayTracer::AddLight( const Light& light )
+{
+	lights.push_back( light );
+	lightsChanged = true;
+	changesUnbounded = true;
+}
+
+
+bool RayTracer::MoveSphere( const int sphereId, const Vec3f& center )
+{
+	if ( sphereId < 0 || sphereId >= static_cast<int>( spheres.size() ) )
+		return false;
+	if ( EqualVectors( spheres[sphereId].center, center ) )
+		return true;
+	AddMoveBounds( sphereId );
+	spheres[sphereId].center = center;
+	AddMoveBounds( sphereId );
+	return true;
+}
+
+
+bool RayTracer::MoveQuad( const int quadId, const Vec3f& center )
+{
+	if ( quadId < 0 || quadId >= static_cast<int>( quads.size() ) )
+		return false;
+	if ( EqualVectors( quads[quadId].center, center ) )
+		return true;
+	AddMoveBounds( FirstQuadId() + quadId );
+	quads[quadId].center = center;
+	AddMoveBounds( FirstQuadId() + quadId );
+	return true;
+}
+
+
+bool RayTracer::MoveBox( const int boxId, const Vec3f& minCorner, const Vec3f& maxCorner )
+{
+	if ( boxId < 0 || boxId >= static_cast<int>( boxes.size() ) )
+		return false;
+	if ( EqualVectors( boxes[boxId].min_corner, minCorner ) && EqualVectors( boxes[boxId].max_corner, maxCorner ) )
+		return true;
+	AddMoveBounds( FirstBoxId() + boxId );
+	boxes[boxId].min_corner = minCorner;
+	boxes[boxId].max_corner = maxCorner;
+	AddMoveBounds( FirstBoxId() + boxId );
+	return true;
+}
+
+
+bool RayTracer::MoveInstance( const int instanceId, const Vec3f& position )
+{
+	if ( instanceId < 0 || instanceId >= static_cast<int>( instances.size() ) )
+		return false;
+	if ( EqualVectors( instances[instanceId].position, position ) )
+		return true;
+	Instance instance = instances[instanceId];
+	instance.position = position;
+	InstanceTransform transform;
+	if ( !ComputeInstanceTransform( instance, transform ) )
+		return false;
+	AddMoveBounds( FirstInstanceId() + instanceId );
+	instances[instanceId] = instance;
+	instancesTransform[instanceId] = transform;
+	AddMoveBounds( FirstInstanceId() + instanceId );
+	return true;
+}
+
+
+bool RayTracer::MoveLight( const int lightId, const Vec3f& position )
+{
+	if ( lightId < 0 || lightId >= static_cast<int>( lights.size() ) )
+		return false;
+	Light& light = lights[lightId];
+	if ( EqualVectors( light.position, position ) )
+		return true;
+	// Light grid is rebuilt with all lights, but they are few compared to primitives.
+	if ( light.radius > 0.0f )
+		changedBounds.push_back( LightBounds( light ) );
+	else
+		changesUnbounded = true;
+	light.position = position;
+	if ( light.radius > 0.0f )
+		changedBounds.push_back( LightBounds( light ) );
+	lightsChanged = true;
+	return true;
+}
+
+
+void RayTracer::AddMoveBounds( const int primitiveId )
+{
+	// Before the first build, bounds of instances are unknown; everything is built anyway.
+	if ( geometryChanged )
+		return;
+	changedBounds.push_back( PrimitiveBounds( primitiveId ) );
+	movedPrimitives.push_back( primitiveId );
+}
+
+
+bool RayTracer::TakeChangedBounds( std::vector<Aabb>& bounds )
+{
+	const Vec3f padding( scene_epsilon, scene_epsilon, scene_epsilon );
+	bounds.clear();
+	for ( const Aabb& changed : changedBounds )
+		bounds.push_back( Aabb( changed.min_corner - padding, changed.max_corner + padding ) );
+	changedBounds.clear();
+	const bool bounded = !changesUnbounded;
+	changesUnbounded = false;
+	return bounded;
+}
+
+
+bool RayTracer::SetMaxRayDepth( const int raydepth )
+{
+	if ( raydepth < 0 || raydepth > ray_stack_size - 2 )
+		return false;
+	this->maxRayDepth = raydepth;
+	return true;
+}
+
+
+bool RayTracer::SetMinRayWeight( const float rayweight )
+{
+	if ( rayweight < 0.0f )
+		return false;
+	this->minRayWeight = rayweight;
+	return true;
+}
+
+
+bool RayTracer::SetLightSamples( const int lightSamples )
+{
+	if ( lightSamples < 0 )
+		return false;
+	this->lightSamples = lightSamples;
+	return true;
+}
+
+
+bool RayTracer::SetRaySortBatch( const int raySortBatch )
+{
+	if ( raySortBatch < 0 )
+		return false;
+	this->raySortBatch = raySortBatch;
+	return true;
+}
+
+
+void RayTracer::ResetDepthStatistics()
+{
+	depthStatistics.assign( ray_stack_size - 1, WavefrontDepthStatistics() );
+}
+
+
+uint64_t RayTracer::GeometryHash() const
+{
+	// Fields are hashed one by one, so padding and materials never change the hash.
+	uint64_t hash = binary_hash_seed;
+	for ( const Sphere& sphere : spheres )
+	{
+		hash = HashBinary( hash, sphere.center );
+		hash = HashBinary( hash, sphere.radius );
+	}
+	for ( const Quad& quad : quads )
+	{
+		hash = HashBinary( hash, quad.center );
+		hash = HashBinary( hash, quad.axis_u );
+		hash = HashBinary( hash, quad.axis_v );
+		hash = HashBinary( hash, quad.half_size );
+	}
+	for ( const Box& box : boxes )
+	{
+		hash = HashBinary( hash, box.min_corner );
+		hash = HashBinary( hash, box.max_corner );
+	}
+	for ( const Instance& instance : instances )
+	{
+		hash = HashBinary( hash, instance.mesh_id );
+		hash = HashBinary( hash, instance.position );
+		hash = HashBinary( hash, instance.axis_x );
+		hash = HashBinary( hash, instance.axis_y );
+		hash = HashBinary( hash, instance.axis_z );
+	}
+	for ( const TriangleMesh& mesh : meshes )
+	{
+		hash = HashBinary( hash, mesh.vertices.size() );
+		hash = HashBinary( hash, mesh.vertices.data(), mesh.vertices.size() );
+		hash = HashBinary( hash, mesh.triangles.size() );
+		hash = HashBinary( hash, mesh.triangles.data(), mesh.triangles.size() );
+	}
+	// Counts separate the lists, e.g., a sphere from a box with the same bytes.
+	const uint64_t counts[5] = { spheres.size(), quads.size(), boxes.size(), instances.size(), meshes.size() };
+	return HashBinary( hash, counts, 5 );
+}
+
+
+bool RayTracer::IsHitValid( const PrimitiveHit& primitiveHit ) const
+{
+	const int i = primitiveHit.primitive_id;
+	if ( i < 0 )
+		return i == -1;
+	if ( i >= NumPrimitives() )
+		return false;
+	if ( i < FirstInstanceId() || i >= FirstQuadId() )
+		return true;
+	// Shading normal and barycentrics index the triangle of the shared mesh.
+	const Instance& instance = instances[i - FirstInstanceId()];
+	return primitiveHit.triangle_id >= 0 && primitiveHit.triangle_id < static_cast<int>( meshes[instance.mesh_id].triangles.size() );
+}
+
+
+void RayTracer::UpdateAccelerationStructure()
+{
+	if ( lightsChanged )
+	{
+		lightGrid.Build( lights );
+		lightsChanged = false;
+	}
+	if ( !geometryChanged )
+	{
+		if ( !movedPrimitives.empty() )
+			RefitAccelerationStructure();
+		return;
+	}
+	std::vector<Aabb> trianglesBounds;
+	for ( size_t i = 0; i < meshes.size(); i++ )
+	{
+		if ( meshesBvh[i].IsEmpty() )
+		{
+			meshes[i].TrianglesBounds( trianglesBounds );
+			meshesBvh[i].Build( trianglesBounds );
+		}
+	}
+	std::vector<Aabb> primitivesBounds( FirstQuadId() );
+	for ( int i = 0; i < FirstQuadId(); i++ )
+		primitivesBounds[i] = PrimitiveBounds( i );
+	sceneBvh.Build( primitivesBounds );
+	UpdatePrimitivesLayout();
+	geometryChanged = false;
+	movedPrimitives.clear();
+	changesUnbounded = true;
+}
+
+
+void RayTracer::RefitAccelerationStructure()
+{
+	std::vector<int> bvhPrimitives;
+	for ( const int primitiveId : movedPrimitives )
+	{
+		if ( primitiveId < FirstBoxId() )
+		{
+			spheresCenterX[primitiveId] = spheres[primitiveId].center.x;
+			spheresCenterY[primitiveId] = spheres[primitiveId].center.y;
+			spheresCenterZ[primitiveId] = spheres[primitiveId].center.z;
+		}
+		for ( size_t axis = 0; axis < 3; ++axis )
+		{
+			if ( primitiveId >= FirstBoxId() && primitiveId < FirstInstanceId() )
+			{
+				boxesMin[axis][primitiveId - FirstBoxId()] = boxes[primitiveId - FirstBoxId()].min_corner[axis];
+				boxesMax[axis][primitiveId - FirstBoxId()] = boxes[primitiveId - FirstBoxId()].max_corner[axis];
+			}
+			if ( primitiveId >= FirstQuadId() )
+				quadsCenter[axis][primitiveId - FirstQuadId()] = quads[primitiveId - FirstQuadId()].center[axis];
+		}
+		if ( primitiveId < FirstQuadId() )
+			bvhPrimitives.push_back( primitiveId );
+	}
+	sceneBvh.Refit( bvhPrimitives, [this]( const int primitiveId ) { return PrimitiveBounds( primitiveId ); } );
+	UpdateCullingBounds();
+	movedPrimitives.clear();
+}
+
+
+Aabb RayTracer::PrimitiveBounds( const int primitiveId ) const
+{
+	if ( primitiveId < FirstBoxId() )
+	{
+		const Sphere& sphere = spheres[primitiveId];
+		const Vec3f radius( sphere.radius, sphere.radius, sphere.radius );
+		return Aabb( sphere.center - radius, sphere.center + radius );
+	}
+	if ( primitiveId < FirstInstanceId() )
+	{
+		const Box& box = boxes[primitiveId - FirstBoxId()];
+		return Aabb( box.min_corner, box.max_corner );
+	}
+	Aabb bounds;
+	if ( primitiveId < FirstQuadId() )
+	{
+		// Bounds of the transformed corners of the mesh bounds.
+		const Instance& instance = instances[primitiveId - FirstInstanceId()];
+		const Aabb meshBounds = meshesBvh[instance.mesh_id].Bounds();
+		for ( int corner = 0; corner < 8; ++corner )
+		{
+			const float x = corner & 1 ? meshBounds.max_corner.x : meshBounds.min_corner.x;
+			const float y = corner & 2 ? meshBounds.max_corner.y : meshBounds.min_corner.y;
+			const float z = corner & 4 ? meshBounds.max_corner.z : meshBounds.min_corner.z;
+			bounds.Grow( instancesTransform[primitiveId - FirstInstanceId()].identity ? Vec3f( x, y, z ) : instance.position + instance.axis_x*x + instance.axis_y*y + instance.axis_z*z );
+		}
+		return bounds;
+	}
+	const Quad& quad = quads[primitiveId - FirstQuadId()];
+	for ( int corner = 0; corner < 4; ++corner )
+		bounds.Grow( quad.center + quad.axis_u*(corner & 1 ? quad.half_size.x : -quad.half_size.x) + quad.axis_v*(corner & 2 ? quad.half_size.y : -quad.half_size.y) );
+	return bounds;
+}
+
+
+void RayTracer::UpdatePrimitivesLayout()
+{
+	spheresCenterX.resize( spheres.size() );
+	spheresCenterY.resize( spheres.size() );
+	spheresCenterZ.resize( spheres.size() );
+	spheresRadius.resize( spheres.size() );
+	for ( size_t i = 0; i < spheres.size(); i++ )
+	{
+		spheresCenterX[i] = spheres[i].center.x;
+		spheresCenterY[i] = spheres[i].center.y;
+		spheresCenterZ[i] = spheres[i].center.z;
+		spheresRadius[i] = spheres[i].radius;
+	}
+	for ( size_t axis = 0; axis < 3; ++axis )
+	{
+		quadsCenter[axis].resize( quads.size() );
+		quadsNormal[axis].resize( quads.size() );
+		quadsAxisU[axis].resize( quads.size() );
+		quadsAxisV[axis].resize( quads.size() );
+		for ( size_t i = 0; i < quads.size(); i++ )
+		{
+			quadsCenter[axis][i] = quads[i].center[axis];
+			quadsNormal[axis][i] = quads[i].Normal()[axis];
+			quadsAxisU[axis][i] = quads[i].axis_u[axis];
+			quadsAxisV[axis][i] = quads[i].axis_v[axis];
+		}
+		boxesMin[axis].resize( boxes.size() );
+		boxesMax[axis].resize( boxes.size() );
+		for ( size_t i = 0; i < boxes.size(); i++ )
+		{
+			boxesMin[axis][i] = boxes[i].min_corner[axis];
+			boxesMax[axis][i] = boxes[i].max_corner[axis];
+		}
+	}
+	for ( size_t axis = 0; axis < 2; ++axis )
+	{
+		quadsHalfSize[axis].resize( quads.size() );
+		for ( size_t i = 0; i < quads.size(); i++ )
+			quadsHalfSize[axis][i] = quads[i].half_size[axis];
+	}
+	UpdateCullingBounds();
+}
+
+
+void RayTracer::UpdateCullingBounds()
+{
+	// +++++ Bounds for culling of rays and tiles, padded by a fraction of the scene extent. +++++
+	cullingBounds.assign( 1, sceneBvh.Bounds() );
+	quadsBounds = Aabb();
+	Aabb allBounds = cullingBounds[0];
+	for ( int quadId = FirstQuadId(); quadId < NumPrimitives(); quadId++ )
+	{
+		const Aabb bounds = PrimitiveBounds( quadId );
+		cullingBounds.push_back( bounds );
+		quadsBounds.Grow( bounds );
+		allBounds.Grow( bounds );
+	}
+	if ( cullingBounds[0].IsEmpty() )
+		cullingBounds.erase( cullingBounds.begin() );
+	const Vec3f extent = allBounds.max_corner - allBounds.min_corner;
+	const float paddingSize = scene_epsilon + scene_bounds_padding * std::max( std::max( extent.x, extent.y ), extent.z );
+	const Vec3f padding( paddingSize, paddingSize, paddingSize );
+	for ( Aabb& bounds : cullingBounds )
+		bounds = Aabb( bounds.min_corner - padding, bounds.max_corner + padding );
+	if ( !quadsBounds.IsEmpty() )
+		quadsBounds = Aabb( quadsBounds.min_corner - padding, quadsBounds.max_corner + padding );
+	// ----- Bounds for culling of rays and tiles, padded by a fraction of the scene extent. -----
+}
+
+
+bool RayTracer::WriteScene( std::ostream& stream )
+{
+	UpdateAccelerationStructure();
+	bool success = WriteBinaryVector( stream, materials ) && WriteBinaryVector( stream, spheres ) && WriteBinaryVector( stream, quads ) && WriteBinaryVector( stream, boxes ) &&
+		WriteBinaryVector( stream, lights ) && WriteBinaryVector( stream, instances ) && WriteBinary( stream, static_cast<uint64_t>( meshes.size() ) );
+	for ( size_t i = 0; i < meshes.size() && success; i++ )
+		success = meshes[i].Write( stream ) && meshesBvh[i].Write( stream );
+	return success && sceneBvh.Write( stream );
+}
+
+
+bool RayTracer::ReadScene( std::istream& stream )
+{
+	RemoveAllGeometry();
+	RemoveAllLights();
+	uint64_t numMeshes = 0;
+	bool success = ReadBinaryVector( stream, materials ) && ReadBinaryVector( stream, spheres ) && ReadBinaryVector( stream, quads ) && ReadBinaryVector( stream, boxes ) &&
+		ReadBinaryVector( stream, lights ) && ReadBinaryVector( stream, instances ) && ReadBinary( stream, numMeshes );
+	// Meshes are appended one by one, so a corrupted count fails at the end of the stream, not at allocation.
+	for ( uint64_t i = 0; i < numMeshes && success; i++ )
+	{
+		meshes.emplace_back();
+		meshesBvh.emplace_back();
+		success = meshes.back().Read( stream ) && meshesBvh.back().Read( stream );
+	}
+	success = success && sceneBvh.Read( stream );
+	// Material ids and primitive ids of hierarchies must refer to existing materials and primitives.
+	const int numMaterials = static_cast<int>( materials.size() );
+	for ( const Sphere& sphere : spheres )
+		success = success && sphere.material_id >= 0 && sphere.material_id < numMaterials;
+	for ( const Quad& quad : quads )
+		success = success && quad.material_id >= 0 && quad.material_id < numMaterials && quad.checker_material_id < numMaterials && quad.checker_cell_size > 0.0f;
+	for ( const Box& box : boxes )
+		success = success && box.material_id >= 0 && box.material_id < numMaterials;
+	instancesTransform.resize( instances.size() );
+	for ( size_t i = 0; i < instances.size() && success; i++ )
+	{
+		const Instance& instance = instances[i];
+		success = instance.material_id >= 0 && instance.material_id < numMaterials && instance.mesh_id >= 0 && instance.mesh_id < static_cast<int>( meshes.size() ) &&
+			ComputeInstanceTransform( instance, instancesTransform[i] );
+	}
+	// Hierarchies hold permutations of their primitive ids (see Bvh::Read), so they must cover all primitives exactly.
+	success = success && sceneBvh.PrimitiveIds().size() == static_cast<size_t>( FirstQuadId() );
+	for ( size_t i = 0; i < meshes.size() && success; i++ )
+		success = meshesBvh[i].PrimitiveIds().size() == meshes[i].triangles.size();
+	if ( !success )
+	{
+		RemoveAllGeometry();
+		RemoveAllLights();
+		return false;
+	}
+	UpdatePrimitivesLayout();
+	geometryChanged = false;
+	return true;
+}
+
+
+void RayTracer::RenderPinhole( Image2D& image, const Vec3f& position, const Vec2f& screenHalfSize )
+{
+	RenderView view;
+	view.image = &image;
+	view.position = position;
+	view.screen_half_size = screenHalfSize;
+	const int height = image.Height();
+	UpdateAccelerationStructure();
+#pragma omp parallel for
+	for ( int j = 0; j < height; j++ )
+		RenderTile( view, 0, j, image.Width(), j+1 );
+}
 
 
-RayTracer::RayTracer()
-	:maxRayDepth( default_maxraydepth )
+void RayTracer::RenderProjector( Image2D& image, const Vec3f& position, const float observerDistance, const Vec2f& screenHalfSize )
+{
+	RenderView view;
+	view.image = &image;
+	view.position = position;
+	view.screen_half_size = screenHalfSize;
+	view.projector = true;
+	view.observer_distance = observerDistance;
+	const int height = image.Height();
+	UpdateAccelerationStructure();
+#pragma omp parallel for
+	for ( int j = 0; j < height; j++ )
+		RenderTile( view, 0, j, image.Width(), j+1 );
+}
+
+
+void RayTracer::RenderTile( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd )
 {
+	Image2D& image = *view.image;
+	const int width = image.Width();
+	const int height = image.Height();
+	const int count = xEnd - xBegin;
+	std::vector<Vec3f> rayOrigins( count ), rayDirections( count ), sampleColors;
+	std::vector<float> sampleWork;
+	if ( TileReused( view, xBegin, yBegin, xEnd, yEnd ) )
+		return;
+	if ( TileMissesScene( view, xBegin, yBegin, xEnd, yEnd ) )
+	{
+		FillBackground( view, xBegin, yBegin, xEnd, yEnd );
+		return;
+	}
+	if ( wavefront && view.pixel_strata == nullptr )
+	{
+		// The whole tile is one wavefront, so the stages run over as many rays as possible.
+		const int numRays = count * (yEnd - yBegin);
+		rayOrigins.resize( numRays );
+		rayDirections.resize( numRays );
+		sampleColors.resize( numRays );
+		std::vector<PrimitiveHit> tileHits( view.primary_hits != nullptr ? numRays : 0 );
+		for ( int j = yBegin; j < yEnd; j++ )
+		{
+			RowPrimaryRays( view, j, xBegin, xEnd, &rayOrigins[(j-yBegin)*count], &rayDirections[(j-yBegin)*count] );
+			if ( view.primary_hits != nullptr && view.reuse_primary_hits )
+				std::copy( view.primary_hits + static_cast<size_t>(j)*width + xBegin, view.primary_hits + static_cast<size_t>(j)*width + xEnd, &tileHits[(j-yBegin)*count] );
+		}
+		TraceWavefront( rayOrigins.data(), rayDirections.data(), numRays, sampleColors.data(), tileHits.empty() ? nullptr : tileHits.data(), view.reuse_primary_hits );
+		for ( int j = yBegin; j < yEnd; j++ )
+		{
+			std::copy( &sampleColors[(j-yBegin)*count], &sampleColors[(j-yBegin)*count] + count, &image.Data()[ static_cast<size_t>(j)*width + xBegin ] );
+			if ( view.primary_hits != nullptr && !view.reuse_primary_hits )
+				std::copy( &tileHits[(j-yBegin)*count], &tileHits[(j-yBegin)*count] + count, view.primary_hits + static_cast<size_t>(j)*width + xBegin );
+		}
+		return;
+	}
+
+	for ( int j = yBegin; j < yEnd; j++ )
+	{
+		Vec3f* row = &image.Data()[ static_cast<size_t>(j)*width ];
+		if ( view.pixel_strata == nullptr )
+		{
+			RowPrimaryRays( view, j, xBegin, xEnd, rayOrigins.data(), rayDirections.data() );
+			sampleWork.resize( view.pixel_work != nullptr ? count : 0 );
+			// Without hints, cached hits are replaced by hits of the traced rays.
+			PrimitiveHit* cachedHits = view.primary_hits != nullptr ? view.primary_hits + static_cast<size_t>(j)*width + xBegin : nullptr;
+			if ( cachedHits != nullptr && !view.reuse_primary_hits )
+				std::fill( cachedHits, cachedHits + count, PrimitiveHit() );
+			TracePrimaryRays( rayOrigins.data(), rayDirections.data(), count, row + xBegin, cachedHits, view.pixel_work != nullptr ? sampleWork.data() : nullptr, view.reuse_primary_hits );
+			for ( size_t i = 0; i < sampleWork.size(); i++ )
+				view.pixel_work[ static_cast<size_t>(j)*width + xBegin + i ] += sampleWork[i];
+			continue;
+		}
 
+		// Refinement: jittered samples, one per cell of the n x n grid over the pixel; samples of a pixel are consecutive.
+		const unsigned char* strata = view.pixel_strata + static_cast<size_t>(j)*width;
+		rayOrigins.clear();
+		rayDirections.clear();
+		for ( int i = xBegin; i < xEnd; i++ )
+		{
+			const int n = strata[i];
+			if ( n <= 1 )
+				continue;
+			for ( int cellY = 0; cellY < n; cellY++ )
+			{
+				for ( int cellX = 0; cellX < n; cellX++ )
+				{
+					const uint32_t seed = (static_cast<uint32_t>(j)*static_cast<uint32_t>(width) + static_cast<uint32_t>(i))*64u + static_cast<uint32_t>(cellY*n + cellX)*2u;
+					const float x = static_cast<float>(i) + (static_cast<float>(cellX) + SampleJitter( seed )) / n;
+					const float y = static_cast<float>(height-j-1) + (static_cast<float>(cellY) + SampleJitter( seed + 1u )) / n;
+					rayOrigins.push_back( Vec3f() );
+					rayDirections.push_back( Vec3f() );
+					PrimaryRay( view, x, y, rayOrigins.back(), rayDirections.back() );
+				}
+			}
+		}
+		if ( rayOrigins.empty() )
+			continue;
+		sampleColors.resize( rayOrigins.size() );
+		sampleWork.assign( rayOrigins.size(), 0.0f );
+		TracePrimaryRays( rayOrigins.data(), rayDirections.data(), static_cast<int>( rayOrigins.size() ), sampleColors.data(), nullptr, view.pixel_work != nullptr ? sampleWork.data() : nullptr );
+		size_t sampleId = 0;
+		for ( int i = xBegin; i < xEnd; i++ )
+		{
+			const int n = strata[i];
+			if ( n <= 1 )
+				continue;
+			Vec3f color( 0.0f, 0.0f, 0.0f );
+			float work = 0.0f;
+			for ( int k = 0; k < n*n; k++, sampleId++ )
+			{
+				color = color + sampleColors[sampleId];
+				work += sampleWork[sampleId];
+			}
+			row[i] = color * (1.0f / (n*n));
+			if ( view.pixel_work != nullptr )
+				view.pixel_work[ static_cast<size_t>(j)*width + i ] += work;
+		}
+	}
 }
 
 
-RayTracer::~RayTracer()
+void RayTracer::RenderTileViews( const std::vector<RenderView>& views, const int xBegin, const int yBegin, const int xEnd, const int yEnd )
 {
+	if ( wavefront )
+	{
+		// Hits are not reused between views in the wavefront mode, every view is a wavefront of its own.
+		for ( const RenderView& view : views )
+			RenderTile( view, xBegin, yBegin, xEnd, yEnd );
+		return;
+	}
 
+	const int count = xEnd - xBegin;
+	std::vector<Vec3f> rayOrigins( count ), rayDirections( count );
+	std::vector<PrimitiveHit> primitiveHits( count );
+	std::vector<float> rayWork( count );
+	std::vector<char> viewsSkipped( views.size() );
+	for ( size_t viewId = 0; viewId < views.size(); viewId++ )
+	{
+		viewsSkipped[viewId] = TileReused( views[viewId], xBegin, yBegin, xEnd, yEnd );
+		if ( !viewsSkipped[viewId] && TileMissesScene( views[viewId], xBegin, yBegin, xEnd, yEnd ) )
+		{
+			FillBackground( views[viewId], xBegin, yBegin, xEnd, yEnd );
+			viewsSkipped[viewId] = true;
+		}
+	}
+	for ( int j = yBegin; j < yEnd; j++ )
+	{
+		// Hits of the previous view are tested first, they bound the traversal of the next view.
+		std::fill( primitiveHits.begin(), primitiveHits.end(), PrimitiveHit() );
+		for ( size_t viewId = 0; viewId < views.size(); viewId++ )
+		{
+			const RenderView& view = views[viewId];
+			if ( viewsSkipped[viewId] )
+				continue;
+			if ( view.pixel_strata != nullptr )
+			{
+				RenderTile( view, xBegin, j, xEnd, j+1 );
+				continue;
+			}
+			RowPrimaryRays( view, j, xBegin, xEnd, rayOrigins.data(), rayDirections.data() );
+			const size_t rowStart = static_cast<size_t>(j)*view.image->Width() + xBegin;
+			// Cached hits serve as hints of the next view as well.
+			const bool reuseHits = view.primary_hits != nullptr && view.reuse_primary_hits;
+			if ( reuseHits )
+				std::copy( view.primary_hits + rowStart, view.primary_hits + rowStart + count, primitiveHits.begin() );
+			TracePrimaryRays( rayOrigins.data(), rayDirections.data(), count, &view.image->Data()[rowStart], primitiveHits.data(), view.pixel_work != nullptr ? rayWork.data() : nullptr, reuseHits );
+			if ( view.primary_hits != nullptr && !reuseHits )
+				std::copy( primitiveHits.begin(), primitiveHits.end(), view.primary_hits + rowStart );
+			for ( int i = 0; i < count && view.pixel_work != nullptr; i++ )
+				view.pixel_work[rowStart + i] += rayWork[i];
+		}
+	}
 }
 
 
-void RayTracer::RemoveAllGeometry()
+void RayTracer::RowPrimaryRays( const RenderView& view, const int j, const int xBegin, const int xEnd, Vec3f* origins, Vec3f* directions ) const
 {
-	spheres.clear();
+	const int width = view.image->Width();
+	const int height = view.image->Height();
+	for ( int i = xBegin; i < xEnd; i++ )
+	{
+		float jitterX = 0.5f, jitterY = 0.5f;
+		if ( view.sample_id > 0 )
+		{
+			const uint32_t seed = (static_cast<uint32_t>(j)*static_cast<uint32_t>(width) + static_cast<uint32_t>(i))*2u + static_cast<uint32_t>(view.sample_id)*0x9e3779b9u;
+			jitterX = SampleJitter( seed );
+			jitterY = SampleJitter( seed + 1u );
+		}
+		PrimaryRay( view, static_cast<float>(i) + jitterX, static_cast<float>(height-j-1) + jitterY, origins[i-xBegin], directions[i-xBegin] );
+	}
 }
 
 
-void RayTracer::RemoveAllLights()
+void RayTracer::PrimaryRay( const RenderView& view, const float x, const float y, Vec3f& origin, Vec3f& direction ) const
 {
-	lights.clear();
+	Vec3f screenPos;
+	PrimaryRaySegment( view, x, y, origin, screenPos );
+	direction = (screenPos-origin).normalize();
 }
 
 
-void RayTracer::AddSphere( const Sphere& sphere )
+void RayTracer::PrimaryRaySegment( const RenderView& view, const float x, const float y, Vec3f& origin, Vec3f& screenPos ) const
 {
-	spheres.push_back( sphere );
+	const int width = view.image->Width();
+	const int height = view.image->Height();
+	const Vec2f screenStart = -view.screen_half_size;
+	const Vec2f screenSize = view.screen_half_size*2.0f;
+	screenPos = Vec3f(
+		screenStart.x + screenSize.x*x / width,
+		screenStart.y + screenSize.y*y / height,
+		0.0f );
+	if ( view.projector )
+	{
+		// Origins of neighbouring rays lie on the observer line (plane), so rays of a row are still coherent.
+		const float observerX = screenPos.x - (screenPos.x-view.position.x)/view.position.z*view.observer_distance;
+		const float observerY = view.vertical_parallax ? screenPos.y - (screenPos.y-view.position.y)/view.position.z*view.observer_distance : 0.0f;
+		origin = Vec3f( observerX, observerY, view.observer_distance );
+	}
+	else
+	{
+		origin = view.position;
+	}
 }
 
 
-void RayTracer::AddLight( const Light& light )
+void RayTracer::TileRayBounds( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd, Aabb& origins, Aabb& directions ) const
 {
-	lights.push_back( light );
+	// Origins and unnormalized directions (screen point minus origin) are linear in the screen point,
+	// so over the whole tile their ranges are spanned by the rays through the tile corners.
+	const int height = view.image->Height();
+	origins = Aabb();
+	directions = Aabb();
+	for ( int corner = 0; corner < 4; ++corner )
+	{
+		Vec3f origin, screenPoint;
+		PrimaryRaySegment( view, static_cast<float>( corner & 1 ? xEnd : xBegin ), static_cast<float>( corner & 2 ? height-yBegin : height-yEnd ), origin, screenPoint );
+		origins.Grow( origin );
+		directions.Grow( screenPoint - origin );
+	}
 }
 
 
-bool RayTracer::SetMaxRayDepth( const int raydepth )
+bool RayTracer::TileMissesScene( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd ) const
+{
+	Aabb origins, directions;
+	TileRayBounds( view, xBegin, yBegin, xEnd, yEnd, origins, directions );
+	for ( const Aabb& bounds : cullingBounds )
+	{
+		if ( !RaysMissBounds( bounds, origins, directions ) )
+			return false;
+	}
+	return true;
+}
+
+
+bool RayTracer::TileReused( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd )
 {
-	if ( raydepth < 0 )
+	if ( view.pixel_reuse == nullptr )
 		return false;
-	this->maxRayDepth = raydepth;
+	const int width = view.image->Width();
+	for ( int j = yBegin; j < yEnd; j++ )
+	{
+		const unsigned char* reuse = view.pixel_reuse + static_cast<size_t>(j)*width;
+		if ( std::find( reuse + xBegin, reuse + xEnd, 0 ) != reuse + xEnd )
+			return false;
+	}
 	return true;
 }
 
 
-void RayTracer::RenderPinhole( Image2D& image, const Vec3f& position, const Vec2f& screenHalfSize )
+bool RayTracer::IsTileUnchanged( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd, const std::vector<Aabb>& changedBounds ) const
 {
-	const int width = image.Width();
-	const int height = image.Height();
-	const Vec2f screenStart = -screenHalfSize;
-	const Vec2f screenSize = screenHalfSize*2.0f;
-#pragma omp parallel for
-	for ( size_t j = 0; j < height; j++ )
+	if ( view.primary_hits == nullptr )
+		return false;
+	if ( changedBounds.empty() )
+		return true;
+	const int width = view.image->Width();
+	const int height = view.image->Height();
+
+	// Only bounds, which some primary ray of the tile can enter, are tested per pixel.
+	Aabb origins, directions;
+	TileRayBounds( view, xBegin, yBegin, xEnd, yEnd, origins, directions );
+	std::vector<const Aabb*> primaryBounds;
+	for ( const Aabb& bounds : changedBounds )
+	{
+		if ( !RaysMissBounds( bounds, origins, directions ) )
+			primaryBounds.push_back( &bounds );
+	}
+
+	// +++++ Rays through pixel centers (as in RowPrimaryRays) end at their hits, and do not enter changed bounds before them. +++++
+	std::vector<Vec3f> points;
+	std::vector<int> lightIds;
+	Aabb pointsBounds;
+	for ( int j = yBegin; j < yEnd; j++ )
+	{
+		for ( int i = xBegin; i < xEnd; i++ )
+		{
+			// Ray up to its hit (the whole ray, if it has missed) is changed by primitives moving into it or away from its end.
+			const PrimitiveHit& primitiveHit = view.primary_hits[ static_cast<size_t>(j)*width + i ];
+			Vec3f origin, direction;
+			PrimaryRay( view, static_cast<float>(i) + 0.5f, static_cast<float>(height-j-1) + 0.5f, origin, direction );
+			for ( const Aabb* bounds : primaryBounds )
+			{
+				if ( RayHitsBounds( *bounds, origin, direction, primitiveHit.distance ) )
+					return false;
+			}
+			Vec3f point, N;
+			int materialId;
+			if ( !ResolveHit( origin, direction, primitiveHit, point, N, materialId ) )
+				continue;
+			// Secondary rays may reach anything; beyond the maximal depth they only see the background.
+			const Material& material = materials[materialId];
+			if ( maxRayDepth > 0 && (material.albedo[2] > minRayWeight || material.albedo[3] > minRayWeight) )
+				return false;
+			points.push_back( point );
+			pointsBounds.Grow( point );
+			// Sampled lights are among the lights, which can illuminate the point.
+			const LightCandidates candidates = lightGrid.Candidates( point );
+			lightIds.insert( lightIds.end(), candidates.light_ids, candidates.light_ids + candidates.count );
+		}
+	}
+	// ----- Rays through pixel centers (as in RowPrimaryRays) end at their hits, and do not enter changed bounds before them. -----
+
+	// +++++ Shadow rays of all hit points towards lights of any of them do not enter changed bounds. +++++
+	std::sort( lightIds.begin(), lightIds.end() );
+	lightIds.erase( std::unique( lightIds.begin(), lightIds.end() ), lightIds.end() );
+	for ( const int lightId : lightIds )
 	{
-		for ( size_t i = 0; i < width; i++ )
+		// Directions from points of the tile to the light, so bounds out of reach of all shadow rays are skipped at once.
+		const Vec3f& lightPosition = lights[lightId].position;
+		const Aabb lightDirections( lightPosition - pointsBounds.max_corner, lightPosition - pointsBounds.min_corner );
+		for ( const Aabb& bounds : changedBounds )
 		{
-			const Vec3f screenPos = Vec3f(
-				screenStart.x + screenSize.x*(static_cast<float>(i) + 0.5f) / width,
-				//screenStart.y + screenSize.y*(static_cast<float>(j) + 0.5f) / height,
-				screenStart.y + screenSize.y*(static_cast<float>(height-j-1) + 0.5f) / height,
-				0.0f );
-			const Vec3f rayOrigin = position;
-			const Vec3f rayDirection = (screenPos-rayOrigin).normalize();
-			image.at(i,j) = CastRay( rayOrigin, rayDirection );
+			if ( RaysMissBounds( bounds, pointsBounds, lightDirections ) )
+				continue;
+			for ( const Vec3f& point : points )
+			{
+				if ( RayHitsBounds( bounds, point, lightPosition - point, 1.0f ) )
+					return false;
+			}
 		}
 	}
+	// ----- Shadow rays of all hit points towards lights of any of them do not enter changed bounds. -----
+	return true;
 }
 
 
-void RayTracer::RenderProjector( Image2D& image, const Vec3f& position, const float observerDistance, const Vec2f& screenHalfSize )
+void RayTracer::FillBackground( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd ) const
 {
-	const int width = image.Width();
-	const int height = image.Height();
-	const Vec2f screenStart = -screenHalfSize;
-	const Vec2f screenSize = screenHalfSize * 2.0f;
-#pragma omp parallel for
-	for ( size_t j = 0; j < height; j++ )
+	const int width = view.image->Width();
+	RAY_STATISTICS_ADD( culled_rays, static_cast<uint64_t>( xEnd - xBegin ) * (yEnd - yBegin) );
+	for ( int j = yBegin; j < yEnd; j++ )
 	{
-		for ( size_t i = 0; i < width; i++ )
+		Vec3f* row = &view.image->Data()[ static_cast<size_t>(j)*width ];
+		if ( view.pixel_strata == nullptr )
+		{
+			std::fill( row + xBegin, row + xEnd, background_color );
+			if ( view.primary_hits != nullptr && !view.reuse_primary_hits )
+				std::fill( view.primary_hits + static_cast<size_t>(j)*width + xBegin, view.primary_hits + static_cast<size_t>(j)*width + xEnd, PrimitiveHit() );
+			continue;
+		}
+		// Average of n x n background samples, summed as by RenderTile, so refined pixels do not change.
+		const unsigned char* strata = view.pixel_strata + static_cast<size_t>(j)*width;
+		for ( int i = xBegin; i < xEnd; i++ )
 		{
-			const Vec3f screenPos = Vec3f(
-				screenStart.x + screenSize.x*(static_cast<float>(i) + 0.5f) / width,
-				//screenStart.y + screenSize.y*(static_cast<float>(j) + 0.5f) / height,
-				screenStart.y + screenSize.y*(static_cast<float>(height-j-1) + 0.5f) / height,
-				0.0f );
-			const float observerX = screenPos.x - (screenPos.x-position.x)/position.z*observerDistance;
-			const Vec3f rayOrigin = Vec3f( observerX, 0.0f, observerDistance );
-			const Vec3f rayDirection = (screenPos - rayOrigin).normalize();
-			image.at(i,j) = CastRay( rayOrigin, rayDirection );
+			const int n = strata[i];
+			if ( n <= 1 )
+				continue;
+			Vec3f color( 0.0f, 0.0f, 0.0f );
+			for ( int k = 0; k < n*n; k++ )
+				color = color + background_color;
+			row[i] = color * (1.0f / (n*n));
 		}
 	}
 }
 
 
-Vec3f RayTracer::CastRay( const Vec3f& origin, const Vec3f& direction, int depth )
+void RayTracer::TracePrimaryRays( const Vec3f* origins, const Vec3f* directions, const int count, Vec3f* colors, PrimitiveHit* hints, float* work, const bool hitsKnown )
 {
-	Vec3f point, N;
-	Material material;
+	if ( wavefront )
+	{
+		TraceWavefront( origins, directions, count, colors, hints, hitsKnown );
+		if ( work != nullptr )
+			std::fill( work, work + count, 0.0f );
+		return;
+	}
 
-	if ( depth > maxRayDepth || !SceneIntersect( origin, direction, point, N, material ) ) {
-		return Vec3f( 0.2f, 0.7f, 0.8f ); // background color
+	RAY_STATISTICS_ADD( primary_rays, count );
+	if ( hitsKnown )
+	{
+		for ( int i = 0; i < count; i++ )
+		{
+			const uint64_t workBefore = RayStatistics::ThreadWork();
+			colors[i] = CastRay( origins[i], directions[i], &hints[i] );
+			if ( work != nullptr )
+				work[i] = static_cast<float>( RayStatistics::ThreadWork() - workBefore );
+		}
+		return;
+	}
+	if ( !packetTracing )
+	{
+		for ( int i = 0; i < count; i++ )
+		{
+			const uint64_t workBefore = RayStatistics::ThreadWork();
+			if ( hints == nullptr )
+			{
+				colors[i] = CastRay( origins[i], directions[i] );
+			}
+			else
+			{
+				IntersectHint( origins[i], directions[i], hints[i] );
+				IntersectPrimitives( origins[i], directions[i], hints[i] );
+				colors[i] = CastRay( origins[i], directions[i], &hints[i] );
+			}
+			if ( work != nullptr )
+				work[i] = static_cast<float>( RayStatistics::ThreadWork() - workBefore );
+		}
+		return;
 	}
 
-	Vec3f reflect_dir = Reflect( direction, N ).normalize();
-	Vec3f refract_dir = Refract( direction, N, material.refractive_index ).normalize();
-	Vec3f reflect_orig = reflect_dir * N < 0.0f ? point - N * scene_epsilon : point + N * scene_epsilon; // offset the original point to avoid occlusion by the object itself
-	Vec3f refract_orig = refract_dir * N < 0.0f ? point - N * scene_epsilon : point + N * scene_epsilon;
-	Vec3f reflect_color = CastRay( reflect_orig, reflect_dir, depth + 1 );
-	Vec3f refract_color = CastRay( refract_orig, refract_dir, depth + 1 );
+	RayPacket packet;
+	PrimitiveHit primitiveHits[ray_packet_size];
+	for ( int first = 0; first < count; first += ray_packet_size )
+	{
+		const int packetSize = std::min( ray_packet_size, count - first );
+		const uint64_t packetWorkBefore = RayStatistics::ThreadWork();
+		LoadRayPacket( origins + first, directions + first, packetSize, packet );
+		for ( int lane = 0; lane < ray_packet_size; lane++ )
+		{
+			primitiveHits[lane] = PrimitiveHit();
+			if ( hints != nullptr && lane < packetSize )
+			{
+				primitiveHits[lane] = hints[first + lane];
+				IntersectHint( origins[first + lane], directions[first + lane], primitiveHits[lane] );
+				packet.distance[lane] = primitiveHits[lane].distance;
+			}
+		}
+		IntersectPrimitivesPacket( packet, primitiveHits );
+		if ( hints != nullptr )
+			std::copy( primitiveHits, primitiveHits + packetSize, hints + first );
+
+		const float laneWork = static_cast<float>( RayStatistics::ThreadWork() - packetWorkBefore ) / packetSize;
 
-	float diffuse_light_intensity = 0, specular_light_intensity = 0;
-	for ( size_t i = 0; i < lights.size(); i++ ) {
-		Vec3f light_dir = (lights[i].position - point).normalize();
-		float light_distance = (lights[i].position - point).norm();
-
-		Vec3f shadow_orig = light_dir * N < 0.0f ? point - N * scene_epsilon : point + N * scene_epsilon; // checking if the point lies in the shadow of the lights[i]
-		Vec3f shadow_pt, shadow_N;
-		Material tmpmaterial;
-		if ( SceneIntersect( shadow_orig, light_dir, shadow_pt, shadow_N, tmpmaterial ) && (shadow_pt - shadow_orig).norm() < light_distance )
+		// Shading and secondary rays are incoherent, so they are traced ray by ray.
+		for ( int lane = 0; lane < packetSize; lane++ )
+		{
+			const uint64_t workBefore = RayStatistics::ThreadWork();
+			colors[first + lane] = CastRay( origins[first + lane], directions[first + lane], &primitiveHits[lane] );
+			if ( work != nullptr )
+				work[first + lane] = laneWork + static_cast<float>( RayStatistics::ThreadWork() - workBefore );
+		}
+	}
+}
+
+
+void RayTracer::TraceWavefront( const Vec3f* origins, const Vec3f* directions, const int count, Vec3f* colors, PrimitiveHit* primaryHits, const bool hitsKnown )
+{
+	std::fill( colors, colors + count, Vec3f( 0.0f, 0.0f, 0.0f ) );
+
+	RayQueue rays, nextRays;
+	for ( int i = 0; i < count; i++ )
+		rays.Push( origins[i], directions[i], 1.0f, i );
+	HitQueue hits;
+	std::vector<PrimitiveHit> primitiveHits;
+	typedef std::chrono::steady_clock Clock;
+	WavefrontDepthStatistics statistics[ray_stack_size - 1];
+	for ( int depth = 0; rays.Size() > 0; depth++ )
+	{
+		const int numRays = rays.Size();
+		statistics[depth].rays = numRays;
+		if ( depth == 0 )
+			RAY_STATISTICS_ADD( primary_rays, numRays );
+		else
+			RAY_STATISTICS_ADD( secondary_rays, numRays );
+
+		// +++++ Intersect. +++++
+		const Clock::time_point intersectTime = Clock::now();
+		primitiveHits.assign( numRays, PrimitiveHit() );
+		// Even sorted secondary rays diverge too much for packets, they are traced ray by ray.
+		if ( depth == 0 && primaryHits != nullptr && hitsKnown )
+		{
+			std::copy( primaryHits, primaryHits + numRays, primitiveHits.begin() );
+		}
+		else if ( packetTracing && depth == 0 )
+		{
+			RayPacket packet;
+			for ( int first = 0; first < numRays; first += ray_packet_size )
+			{
+				const int packetSize = std::min( ray_packet_size, numRays - first );
+				LoadRayPacket( rays, first, packetSize, packet );
+				PrimitiveHit packetHits[ray_packet_size];
+				IntersectPrimitivesPacket( packet, packetHits );
+				std::copy( packetHits, packetHits + packetSize, primitiveHits.begin() + first );
+			}
+		}
+		else
+		{
+			for ( int k = 0; k < numRays; k++ )
+				IntersectPrimitives( rays.Origin( k ), rays.Direction( k ), primitiveHits[k] );
+		}
+		if ( depth == 0 && primaryHits != nullptr && !hitsKnown )
+			std::copy( primitiveHits.begin(), primitiveHits.end(), primaryHits );
+		statistics[depth].intersect_seconds = std::chrono::duration<double>( Clock::now() - intersectTime ).count();
+		// ----- Intersect. -----
+
+		// +++++ Resolve hits and gather materials; missed rays see the background. +++++
+		hits.Clear();
+		for ( int k = 0; k < numRays; k++ )
+		{
+			Vec3f point, N;
+			int materialId;
+			if ( !ResolveHit( rays.Origin( k ), rays.Direction( k ), primitiveHits[k], point, N, materialId ) )
+			{
+				RAY_STATISTICS_ADD( terminated_rays[depth], 1 );
+				colors[rays.pixel[k]] = colors[rays.pixel[k]] + background_color * rays.weight[k];
+				continue;
+			}
+			hits.Push( k, point, N, materialId, materials[materialId] );
+		}
+		const int numHits = hits.Size();
+		hits.ResizeLighting();
+		// ----- Resolve hits and gather materials; missed rays see the background. -----
+
+		// +++++ Direct lighting, light by light: shadow rays setup, shadow queries, then diffuse and specular terms. +++++
+		if ( lightGrid.IsCulling() || lightSamples > 0 )
+		{
+			// Lights differ from point to point, so they are gathered hit by hit.
+			for ( int k = 0; k < numHits; k++ )
+				LightIntensities( rays.Direction( hits.ray[k] ), hits.Point( k ), hits.Normal( k ), hits.specular_exponent[k], hits.diffuse_intensity[k], hits.specular_intensity[k] );
+		}
+		else
+		{
+			for ( const Light& light : lights )
+			{
+				for ( int k = 0; k < numHits; k++ )
+				{
+					const float dx = light.position.x - hits.point_x[k];
+					const float dy = light.position.y - hits.point_y[k];
+					const float dz = light.position.z - hits.point_z[k];
+					const float distance = std::sqrt( dx*dx + dy*dy + dz*dz );
+					const float scale = 1.0f / distance;
+					hits.light_dir_x[k] = dx*scale;
+					hits.light_dir_y[k] = dy*scale;
+					hits.light_dir_z[k] = dz*scale;
+					hits.light_distance[k] = distance;
+				}
+
+				for ( int k = 0; k < numHits; k++ )
+				{
+					const Vec3f lightDir( hits.light_dir_x[k], hits.light_dir_y[k], hits.light_dir_z[k] );
+					const Vec3f point = hits.Point( k );
+					const Vec3f N = hits.Normal( k );
+					const Vec3f shadowOrig = lightDir * N < 0.0f ? point - N * scene_epsilon : point + N * scene_epsilon;
+					hits.visibility[k] = Occluded( shadowOrig, lightDir, hits.light_distance[k] ) ? 0.0f : 1.0f;
+				}
+
+				for ( int k = 0; k < numHits; k++ )
+				{
+					const int ray = hits.ray[k];
+					// Dot products are summed in the same order as Vec3f ones, to match the recursive path.
+					const float lightDotN = hits.light_dir_z[k]*hits.normal_z[k] + hits.light_dir_y[k]*hits.normal_y[k] + hits.light_dir_x[k]*hits.normal_x[k];
+					// Reflect( -lightDir, N ) = 2*(lightDir*N)*N - lightDir.
+					const float reflectX = -hits.light_dir_x[k] - hits.normal_x[k]*2.0f*(-lightDotN);
+					const float reflectY = -hits.light_dir_y[k] - hits.normal_y[k]*2.0f*(-lightDotN);
+					const float reflectZ = -hits.light_dir_z[k] - hits.normal_z[k]*2.0f*(-lightDotN);
+					const float reflectDotDir = -reflectZ*rays.direction_z[ray] + -reflectY*rays.direction_y[ray] + -reflectX*rays.direction_x[ray];
+					hits.diffuse_intensity[k] += hits.visibility[k] * (light.intensity * std::max( 0.0f, lightDotN ));
+					hits.specular_intensity[k] += hits.visibility[k] * (powf( std::max( 0.0f, reflectDotDir ), hits.specular_exponent[k] )*light.intensity);
+				}
+			}
+		}
+		for ( int k = 0; k < numHits; k++ )
+		{
+			const int ray = hits.ray[k];
+			const float specular = hits.specular_intensity[k] * hits.albedo_1[k];
+			const Vec3f shade(
+				hits.diffuse_r[k] * hits.diffuse_intensity[k] * hits.albedo_0[k] + specular,
+				hits.diffuse_g[k] * hits.diffuse_intensity[k] * hits.albedo_0[k] + specular,
+				hits.diffuse_b[k] * hits.diffuse_intensity[k] * hits.albedo_0[k] + specular );
+			colors[rays.pixel[ray]] = colors[rays.pixel[ray]] + shade * rays.weight[ray];
+		}
+		// ----- Direct lighting, light by light: shadow rays setup, shadow queries, then diffuse and specular terms. -----
+
+		// +++++ Spawn reflected and refracted rays of the next depth. +++++
+		nextRays.Clear();
+		for ( int k = 0; k < numHits; k++ )
+		{
+			const int ray = hits.ray[k];
+			const int pixel = rays.pixel[ray];
+			const Material& material = materials[hits.material_id[k]];
+			const float reflectWeight = rays.weight[ray] * material.albedo[2];
+			const float refractWeight = rays.weight[ray] * material.albedo[3];
+			const bool traceReflect = reflectWeight > minRayWeight;
+			const bool traceRefract = refractWeight > minRayWeight;
+			if ( !traceReflect && !traceRefract )
+				RAY_STATISTICS_ADD( terminated_rays[depth], 1 );
+			if ( (traceReflect || traceRefract) && depth + 1 > maxRayDepth ) {
+				// Rays beyond the maximal depth see the background.
+				RAY_STATISTICS_ADD( terminated_rays[depth], 1 );
+				colors[pixel] = colors[pixel] + background_color * ((traceReflect ? reflectWeight : 0.0f) + (traceRefract ? refractWeight : 0.0f));
+				continue;
+			}
+			const Vec3f direction = rays.Direction( ray );
+			const Vec3f point = hits.Point( k );
+			const Vec3f N = hits.Normal( k );
+			if ( traceRefract ) {
+				const Vec3f refract_dir = Refract( direction, N, material.refractive_index ).normalize();
+				const Vec3f refract_orig = refract_dir * N < 0.0f ? point - N * scene_epsilon : point + N * scene_epsilon;
+				nextRays.Push( refract_orig, refract_dir, refractWeight, pixel );
+			}
+			if ( traceReflect ) {
+				const Vec3f reflect_dir = Reflect( direction, N ).normalize();
+				const Vec3f reflect_orig = reflect_dir * N < 0.0f ? point - N * scene_epsilon : point + N * scene_epsilon;
+				nextRays.Push( reflect_orig, reflect_dir, reflectWeight, pixel );
+			}
+		}
+		// ----- Spawn reflected and refracted rays of the next depth. -----
+
+		if ( raySortBatch > 0 && nextRays.Size() > 1 )
+		{
+			const Clock::time_point sortTime = Clock::now();
+			SortRays( nextRays, raySortBatch, rays );
+			statistics[depth+1].sort_seconds = std::chrono::duration<double>( Clock::now() - sortTime ).count();
+		}
+		else
+		{
+			std::swap( rays, nextRays );
+		}
+	}
+
+	for ( int depth = 0; depth < ray_stack_size - 1 && statistics[depth].rays > 0; depth++ )
+	{
+#pragma omp atomic
+		depthStatistics[depth].rays += statistics[depth].rays;
+#pragma omp atomic
+		depthStatistics[depth].sort_seconds += statistics[depth].sort_seconds;
+#pragma omp atomic
+		depthStatistics[depth].intersect_seconds += statistics[depth].intersect_seconds;
+	}
+}
+
+
+Vec3f RayTracer::CastRay( const Vec3f& origin, const Vec3f& direction, const PrimitiveHit* primaryHit )
+{
+	// Depth-first evaluation of the ray tree. Every ray carries the weight of its contribution to the pixel,
+	// so the color is accumulated directly, and branches with negligible weight are not traced at all.
+	// Stack holds at most one pending sibling per depth level plus two children, which SetMaxRayDepth guarantees to fit.
+	RayTask stack[ray_stack_size];
+	int stackSize = 0;
+	stack[stackSize++] = RayTask( origin, direction, 0, 1.0f );
+	Vec3f color( 0.0f, 0.0f, 0.0f );
+	while ( stackSize > 0 )
+	{
+		const RayTask ray = stack[--stackSize];
+		if ( ray.depth > 0 )
+			RAY_STATISTICS_ADD( secondary_rays, 1 );
+		PrimitiveHit primitiveHit;
+		if ( ray.depth == 0 && primaryHit != nullptr )
+			primitiveHit = *primaryHit;
+		else
+			IntersectPrimitives( ray.origin, ray.direction, primitiveHit );
+		Vec3f point, N;
+		int materialId;
+		if ( !ResolveHit( ray.origin, ray.direction, primitiveHit, point, N, materialId ) ) {
+			RAY_STATISTICS_ADD( terminated_rays[ray.depth], 1 );
+			color = color + background_color * ray.weight;
+			continue;
+		}
+		const Material& material = materials[materialId];
+		color = color + ShadeDirect( ray.direction, point, N, material ) * ray.weight;
+
+		const float reflectWeight = ray.weight * material.albedo[2];
+		const float refractWeight = ray.weight * material.albedo[3];
+		const bool traceReflect = reflectWeight > minRayWeight;
+		const bool traceRefract = refractWeight > minRayWeight;
+		if ( !traceReflect && !traceRefract )
+			RAY_STATISTICS_ADD( terminated_rays[ray.depth], 1 );
+		if ( (traceReflect || traceRefract) && ray.depth + 1 > maxRayDepth ) {
+			// Rays beyond the maximal depth see the background.
+			RAY_STATISTICS_ADD( terminated_rays[ray.depth], 1 );
+			color = color + background_color * ((traceReflect ? reflectWeight : 0.0f) + (traceRefract ? refractWeight : 0.0f));
 			continue;
+		}
+		if ( traceRefract ) {
+			const Vec3f refract_dir = Refract( ray.direction, N, material.refractive_index ).normalize();
+			const Vec3f refract_orig = refract_dir * N < 0.0f ? point - N * scene_epsilon : point + N * scene_epsilon;
+			stack[stackSize++] = RayTask( refract_orig, refract_dir, ray.depth + 1, refractWeight );
+		}
+		if ( traceReflect ) {
+			const Vec3f reflect_dir = Reflect( ray.direction, N ).normalize();
+			const Vec3f reflect_orig = reflect_dir * N < 0.0f ? point - N * scene_epsilon : point + N * scene_epsilon; // offset the original point to avoid occlusion by the object itself
+			stack[stackSize++] = RayTask( reflect_orig, reflect_dir, ray.depth + 1, reflectWeight );
+		}
+	}
+	return color;
+}
+
+
+Vec3f RayTracer::ShadeDirect( const Vec3f& direction, const Vec3f& point, const Vec3f& N, const Material& material )
+{
+	float diffuse_light_intensity = 0, specular_light_intensity = 0;
+	LightIntensities( direction, point, N, material.specular_exponent, diffuse_light_intensity, specular_light_intensity );
+	return material.diffuse_color * diffuse_light_intensity * material.albedo[0] + Vec3f( 1., 1., 1. )*specular_light_intensity * material.albedo[1];
+}
+
+
+void RayTracer::LightIntensities( const Vec3f& direction, const Vec3f& point, const Vec3f& N, const float specularExponent, float& diffuse, float& specular )
+{
+	const LightCandidates candidates = lightGrid.Candidates( point );
+	if ( lightSamples == 0 || candidates.count <= lightSamples ) {
+		for ( int k = 0; k < candidates.count; k++ )
+			AddLightIntensities( lights[candidates.light_ids[k]], 1.0f, direction, point, N, specularExponent, diffuse, specular );
+		return;
+	}
 
-		diffuse_light_intensity += lights[i].intensity * std::max( 0.f, light_dir*N );
-		specular_light_intensity += powf( std::max( 0.f, -Reflect( -light_dir, N )*direction ), material.specular_exponent )*lights[i].intensity;
+	// Stratified samples of the distribution of intensities: light of intensity I is chosen with probability I/total,
+	// so its contribution is weighted by total/(I*samples). Jitter is a hash of the point, so images do not depend on the order of rendering.
+	const float totalIntensity = candidates.cumulative_intensity[candidates.count-1];
+	if ( totalIntensity <= 0.0f )
+		return;
+	uint32_t bits[3];
+	std::memcpy( bits, &point, sizeof( bits ) );
+	const uint32_t seed = bits[0]*73856093u ^ bits[1]*19349663u ^ bits[2]*83492791u;
+	for ( int sample = 0; sample < lightSamples; sample++ )
+	{
+		const float u = (static_cast<float>( sample ) + SampleJitter( seed + static_cast<uint32_t>( sample )*0x9e3779b9u )) / lightSamples * totalIntensity;
+		const int k = std::min( static_cast<int>( std::upper_bound( candidates.cumulative_intensity, candidates.cumulative_intensity + candidates.count, u ) - candidates.cumulative_intensity ), candidates.count-1 );
+		const float intensity = candidates.cumulative_intensity[k] - (k > 0 ? candidates.cumulative_intensity[k-1] : 0.0f);
+		if ( intensity > 0.0f )
+			AddLightIntensities( lights[candidates.light_ids[k]], totalIntensity / (intensity * lightSamples), direction, point, N, specularExponent, diffuse, specular );
 	}
-	return material.diffuse_color * diffuse_light_intensity * material.albedo[0] + Vec3f( 1., 1., 1. )*specular_light_intensity * material.albedo[1] + reflect_color * material.albedo[2] + refract_color * material.albedo[3];
+}
+
+
+void RayTracer::AddLightIntensities( const Light& light, const float weight, const Vec3f& direction, const Vec3f& point, const Vec3f& N, const float specularExponent, float& diffuse, float& specular )
+{
+	Vec3f light_dir = (light.position - point).normalize();
+	float light_distance = (light.position - point).norm();
+	const float intensity = light.intensity * light.Attenuation( light_distance ) * weight;
+	if ( intensity == 0.0f )
+		return;
+
+	Vec3f shadow_orig = light_dir * N < 0.0f ? point - N * scene_epsilon : point + N * scene_epsilon; // checking if the point lies in the shadow of the light
+	if ( Occluded( shadow_orig, light_dir, light_distance ) )
+		return;
+
+	diffuse += intensity * std::max( 0.f, light_dir*N );
+	specular += powf( std::max( 0.f, -Reflect( -light_dir, N )*direction ), specularExponent )*intensity;
 }
 
 
@@ -166,29 +1652,321 @@ Vec3f RayTracer::Refract( const Vec3f &I, const Vec3f &N, const float eta_t, con
 }
 
 
-bool RayTracer::SceneIntersect( const Vec3f &orig, const Vec3f &dir, Vec3f &hit, Vec3f &N, Material &material )
+bool RayTracer::Occluded( const Vec3f& orig, const Vec3f& dir, const float maxDistance ) const
+{
+	// Hits beyond the scene distance limit are not considered as hits (see ResolveHit).
+	float hitDistance = std::min( maxDistance, scene_max_distance );
+
+	RAY_STATISTICS_ADD( shadow_rays, 1 );
+	const int numQuads = RayHitsBounds( quadsBounds, orig, dir ) ? static_cast<int>( quads.size() ) : 0;
+	for ( int quadId = 0; quadId < numQuads; quadId++ ) {
+		if ( IntersectQuad( quadId, orig, dir, hitDistance ) )
+			return true;
+	}
+	PrimitiveHit blockerHit;
+	return sceneBvh.Traverse( orig, dir, hitDistance, [&]( const int i, float& distance ) {
+		return IntersectPrimitive( i, orig, dir, distance, blockerHit, true );
+	}, true );
+}
+
+
+void RayTracer::IntersectPrimitives( const Vec3f& orig, const Vec3f& dir, PrimitiveHit& primitiveHit ) const
+{
+	// Rays, which miss bounds of all quads, skip their tests.
+	const int numQuads = RayHitsBounds( quadsBounds, orig, dir ) ? static_cast<int>( quads.size() ) : 0;
+	for ( int quadId = 0; quadId < numQuads; quadId++ ) {
+		if ( IntersectQuad( quadId, orig, dir, primitiveHit.distance ) )
+			primitiveHit.primitive_id = FirstQuadId() + quadId;
+	}
+	sceneBvh.Traverse( orig, dir, primitiveHit.distance, [&]( const int i, float& distance ) {
+		if ( !IntersectPrimitive( i, orig, dir, distance, primitiveHit, false ) )
+			return false;
+		primitiveHit.primitive_id = i;
+		return true;
+	} );
+}
+
+
+void RayTracer::IntersectPrimitivesPacket( RayPacket& packet, PrimitiveHit* primitiveHits ) const
 {
-	float spheres_dist = std::numeric_limits<float>::max();
-	for ( size_t i = 0; i < spheres.size(); i++ ) {
+	// +++++ Quads, with rays of the packet, which hit bounds of quads (tail lanes have negative distance). +++++
+	int packetLanes[ray_packet_size];
+	int numActive = 0;
+	for ( int lane = 0; lane < ray_packet_size; lane++ ) {
+		const Vec3f origin( packet.origin_x[lane], packet.origin_y[lane], packet.origin_z[lane] );
+		const Vec3f direction( packet.direction_x[lane], packet.direction_y[lane], packet.direction_z[lane] );
+		packetLanes[lane] = packet.distance[lane] >= 0.0f && RayHitsBounds( quadsBounds, origin, direction ) ? 1 : 0;
+		numActive += packetLanes[lane];
+	}
+	const int numQuads = numActive > 0 ? static_cast<int>( quads.size() ) : 0;
+	for ( int quadId = 0; quadId < numQuads; quadId++ ) {
+		float dists[ray_packet_size];
+		int hits[ray_packet_size];
+		IntersectQuadPacket( quadId, packet, packetLanes, dists, hits );
+		for ( int lane = 0; lane < ray_packet_size; lane++ ) {
+			if ( hits[lane] ) {
+				packet.distance[lane] = dists[lane];
+				primitiveHits[lane].distance = dists[lane];
+				primitiveHits[lane].primitive_id = FirstQuadId() + quadId;
+			}
+		}
+	}
+	// ----- Quads, with rays of the packet, which hit bounds of quads (tail lanes have negative distance). -----
+
+	sceneBvh.TraversePacket( packet, [&]( const int i, const int* activeLanes ) {
+		if ( i >= FirstInstanceId() ) {
+			// Triangles are intersected ray by ray.
+			for ( int lane = 0; lane < ray_packet_size; lane++ ) {
+				if ( !activeLanes[lane] )
+					continue;
+				const Vec3f origin( packet.origin_x[lane], packet.origin_y[lane], packet.origin_z[lane] );
+				const Vec3f direction( packet.direction_x[lane], packet.direction_y[lane], packet.direction_z[lane] );
+				if ( IntersectInstance( i - FirstInstanceId(), origin, direction, primitiveHits[lane] ) )
+					primitiveHits[lane].primitive_id = i;
+				packet.distance[lane] = primitiveHits[lane].distance;
+			}
+			return;
+		}
+		float dists[ray_packet_size];
+		int hits[ray_packet_size];
+		if ( i < FirstBoxId() )
+			IntersectSpherePacket( i, packet, activeLanes, dists, hits );
+		else
+			IntersectBoxPacket( i - FirstBoxId(), packet, activeLanes, dists, hits );
+		for ( int lane = 0; lane < ray_packet_size; lane++ ) {
+			if ( hits[lane] ) {
+				packet.distance[lane] = dists[lane];
+				primitiveHits[lane].distance = dists[lane];
+				primitiveHits[lane].primitive_id = i;
+			}
+		}
+	} );
+}
+
+
+void RayTracer::IntersectSpherePacket( const int sphereId, const RayPacket& packet, const int* activeLanes, float* distances, int* hits ) const
+{
+	// Same arithmetic as Sphere::ray_intersect (including the order of dot product terms), so results are bit-exact.
+	const float centerX = spheresCenterX[sphereId], centerY = spheresCenterY[sphereId], centerZ = spheresCenterZ[sphereId];
+	const float radius2 = spheresRadius[sphereId]*spheresRadius[sphereId];
+	RAY_STATISTICS_ADD( sphere_tests, std::count( activeLanes, activeLanes + ray_packet_size, 1 ) );
+	for ( int lane = 0; lane < ray_packet_size; lane++ ) {
+		const float Lx = centerX - packet.origin_x[lane];
+		const float Ly = centerY - packet.origin_y[lane];
+		const float Lz = centerZ - packet.origin_z[lane];
+		const float tca = Lz*packet.direction_z[lane] + Ly*packet.direction_y[lane] + Lx*packet.direction_x[lane];
+		const float d2 = (Lz*Lz + Ly*Ly + Lx*Lx) - tca*tca;
+		const float thc = std::sqrt( std::max( radius2 - d2, 0.0f ) );
+		const float t0 = tca - thc;
+		const float t1 = tca + thc;
+		const float t = t0 < 0.0f ? t1 : t0;
+		distances[lane] = t;
+		// Bitwise operators keep the loop free of branches.
+		hits[lane] = (activeLanes[lane] != 0) & (d2 <= radius2) & (t >= 0.0f) & (t < packet.distance[lane]);
+	}
+}
+
+
+void RayTracer::IntersectQuadPacket( const int quadId, const RayPacket& packet, const int* activeLanes, float* distances, int* hits ) const
+{
+	// Same arithmetic as IntersectQuad, so results are bit-exact.
+	const float centerX = quadsCenter[0][quadId], centerY = quadsCenter[1][quadId], centerZ = quadsCenter[2][quadId];
+	const float normalX = quadsNormal[0][quadId], normalY = quadsNormal[1][quadId], normalZ = quadsNormal[2][quadId];
+	const float axisUX = quadsAxisU[0][quadId], axisUY = quadsAxisU[1][quadId], axisUZ = quadsAxisU[2][quadId];
+	const float axisVX = quadsAxisV[0][quadId], axisVY = quadsAxisV[1][quadId], axisVZ = quadsAxisV[2][quadId];
+	const float halfSizeU = quadsHalfSize[0][quadId], halfSizeV = quadsHalfSize[1][quadId];
+	RAY_STATISTICS_ADD( quad_tests, std::count( activeLanes, activeLanes + ray_packet_size, 1 ) );
+	for ( int lane = 0; lane < ray_packet_size; lane++ ) {
+		const float cosine = packet.direction_z[lane]*normalZ + packet.direction_y[lane]*normalY + packet.direction_x[lane]*normalX;
+		const float t = ((centerZ - packet.origin_z[lane])*normalZ + (centerY - packet.origin_y[lane])*normalY + (centerX - packet.origin_x[lane])*normalX) / cosine;
+		const float offsetX = (packet.origin_x[lane] + packet.direction_x[lane]*t) - centerX;
+		const float offsetY = (packet.origin_y[lane] + packet.direction_y[lane]*t) - centerY;
+		const float offsetZ = (packet.origin_z[lane] + packet.direction_z[lane]*t) - centerZ;
+		const float u = offsetZ*axisUZ + offsetY*axisUY + offsetX*axisUX;
+		const float v = offsetZ*axisVZ + offsetY*axisVY + offsetX*axisVX;
+		distances[lane] = t;
+		hits[lane] = (activeLanes[lane] != 0) & (std::fabs( cosine ) > quad_min_cosine) & (t > 0.0f) &
+			(std::fabs( u ) < halfSizeU) & (std::fabs( v ) < halfSizeV) & (t < packet.distance[lane]);
+	}
+}
+
+
+void RayTracer::IntersectBoxPacket( const int boxId, const RayPacket& packet, const int* activeLanes, float* distances, int* hits ) const
+{
+	// Same arithmetic as IntersectBox, so results are bit-exact.
+	const float minX = boxesMin[0][boxId], minY = boxesMin[1][boxId], minZ = boxesMin[2][boxId];
+	const float maxX = boxesMax[0][boxId], maxY = boxesMax[1][boxId], maxZ = boxesMax[2][boxId];
+	RAY_STATISTICS_ADD( box_tests, std::count( activeLanes, activeLanes + ray_packet_size, 1 ) );
+	for ( int lane = 0; lane < ray_packet_size; lane++ ) {
+		const float tx1 = (minX - packet.origin_x[lane]) * packet.inverse_direction_x[lane];
+		const float tx2 = (maxX - packet.origin_x[lane]) * packet.inverse_direction_x[lane];
+		const float ty1 = (minY - packet.origin_y[lane]) * packet.inverse_direction_y[lane];
+		const float ty2 = (maxY - packet.origin_y[lane]) * packet.inverse_direction_y[lane];
+		const float tz1 = (minZ - packet.origin_z[lane]) * packet.inverse_direction_z[lane];
+		const float tz2 = (maxZ - packet.origin_z[lane]) * packet.inverse_direction_z[lane];
+		const float tNear = std::max( std::max( std::min( tx1, tx2 ), std::min( ty1, ty2 ) ), std::min( tz1, tz2 ) );
+		const float tFar = std::min( std::min( std::max( tx1, tx2 ), std::max( ty1, ty2 ) ), std::max( tz1, tz2 ) );
+		// From inside the box, the ray hits the exit face.
+		const float t = tNear > 0.0f ? tNear : tFar;
+		distances[lane] = t;
+		hits[lane] = (activeLanes[lane] != 0) & (tNear <= tFar) & (t > 0.0f) & (t < packet.distance[lane]);
+	}
+}
+
+
+bool RayTracer::IntersectPrimitive( const int primitiveId, const Vec3f& orig, const Vec3f& dir, float& distance, PrimitiveHit& primitiveHit, const bool anyHit ) const
+{
+	if ( primitiveId < FirstBoxId() ) {
+		RAY_STATISTICS_ADD( sphere_tests, 1 );
 		float dist_i;
-		if ( spheres[i].ray_intersect( orig, dir, dist_i ) && dist_i < spheres_dist ) {
-			spheres_dist = dist_i;
-			hit = orig + dir * dist_i;
-			N = (hit - spheres[i].center).normalize();
-			material = spheres[i].material;
+		if ( spheres[primitiveId].ray_intersect( orig, dir, dist_i ) && dist_i < distance ) {
+			distance = dist_i;
+			return true;
+		}
+		return false;
+	}
+	if ( primitiveId < FirstInstanceId() )
+		return IntersectBox( primitiveId - FirstBoxId(), orig, dir, distance );
+	if ( primitiveId >= FirstQuadId() )
+		return IntersectQuad( primitiveId - FirstQuadId(), orig, dir, distance );
+	primitiveHit.distance = distance;
+	if ( !IntersectInstance( primitiveId - FirstInstanceId(), orig, dir, primitiveHit, anyHit ) )
+		return false;
+	distance = primitiveHit.distance;
+	return true;
+}
+
+
+bool RayTracer::IntersectQuad( const int quadId, const Vec3f& orig, const Vec3f& dir, float& distance ) const
+{
+	RAY_STATISTICS_ADD( quad_tests, 1 );
+	const Quad& quad = quads[quadId];
+	const Vec3f N( quadsNormal[0][quadId], quadsNormal[1][quadId], quadsNormal[2][quadId] );
+	const float cosine = dir * N;
+	if ( !(std::fabs( cosine ) > quad_min_cosine) )
+		return false;
+	const float d = ((quad.center - orig) * N) / cosine;
+	const Vec3f offset = (orig + dir * d) - quad.center;
+	if ( d > 0 && std::fabs( offset * quad.axis_u ) < quad.half_size.x && std::fabs( offset * quad.axis_v ) < quad.half_size.y && d < distance ) {
+		distance = d;
+		return true;
+	}
+	return false;
+}
+
+
+bool RayTracer::IntersectBox( const int boxId, const Vec3f& orig, const Vec3f& dir, float& distance ) const
+{
+	RAY_STATISTICS_ADD( box_tests, 1 );
+	const Box& box = boxes[boxId];
+	float tNear = -std::numeric_limits<float>::infinity();
+	float tFar = std::numeric_limits<float>::infinity();
+	for ( size_t axis = 0; axis < 3; ++axis ) {
+		const float inverseDirection = 1.0f / dir[axis];
+		const float t1 = (box.min_corner[axis] - orig[axis]) * inverseDirection;
+		const float t2 = (box.max_corner[axis] - orig[axis]) * inverseDirection;
+		tNear = std::max( tNear, std::min( t1, t2 ) );
+		tFar = std::min( tFar, std::max( t1, t2 ) );
+	}
+	// From inside the box, the ray hits the exit face.
+	const float t = tNear > 0.0f ? tNear : tFar;
+	if ( tNear <= tFar && t > 0.0f && t < distance ) {
+		distance = t;
+		return true;
+	}
+	return false;
+}
+
+
+bool RayTracer::IntersectInstance( const int instanceId, const Vec3f& orig, const Vec3f& dir, PrimitiveHit& primitiveHit, const bool anyHit ) const
+{
+	const InstanceTransform& transform = instancesTransform[instanceId];
+	const int meshId = instances[instanceId].mesh_id;
+	if ( transform.identity )
+		return IntersectMesh( meshId, orig, dir, primitiveHit, anyHit );
+	// Direction is not normalized in object space, so the ray parameter stays the same.
+	return IntersectMesh( meshId, transform.PointToObject( orig ), transform.VectorToObject( dir ), primitiveHit, anyHit );
+}
+
+
+bool RayTracer::IntersectMesh( const int meshId, const Vec3f& orig, const Vec3f& dir, PrimitiveHit& primitiveHit, const bool anyHit ) const
+{
+	const TriangleMesh& mesh = meshes[meshId];
+	const WatertightRay ray( orig, dir );
+	return meshesBvh[meshId].Traverse( orig, dir, primitiveHit.distance, [&]( const int j, float& triangleDistance ) {
+		RAY_STATISTICS_ADD( triangle_tests, 1 );
+		const Vec3i& triangle = mesh.triangles[j];
+		if ( IntersectTriangle( ray, mesh.vertices[triangle.x], mesh.vertices[triangle.y], mesh.vertices[triangle.z], triangleDistance, primitiveHit.u, primitiveHit.v ) ) {
+			primitiveHit.triangle_id = j;
+			return true;
 		}
+		return false;
+	}, anyHit );
+}
+
+
+void RayTracer::IntersectHint( const Vec3f& orig, const Vec3f& dir, PrimitiveHit& primitiveHit ) const
+{
+	const PrimitiveHit hint = primitiveHit;
+	primitiveHit = PrimitiveHit();
+	if ( hint.primitive_id < 0 )
+		return;
+	if ( hint.primitive_id < FirstInstanceId() || hint.primitive_id >= FirstQuadId() ) {
+		if ( IntersectPrimitive( hint.primitive_id, orig, dir, primitiveHit.distance, primitiveHit, false ) )
+			primitiveHit.primitive_id = hint.primitive_id;
+		return;
+	}
+	// Only the triangle of the hint is intersected.
+	const InstanceTransform& transform = instancesTransform[hint.primitive_id - FirstInstanceId()];
+	const TriangleMesh& mesh = meshes[instances[hint.primitive_id - FirstInstanceId()].mesh_id];
+	RAY_STATISTICS_ADD( triangle_tests, 1 );
+	const Vec3i& triangle = mesh.triangles[hint.triangle_id];
+	const WatertightRay ray = transform.identity ? WatertightRay( orig, dir ) : WatertightRay( transform.PointToObject( orig ), transform.VectorToObject( dir ) );
+	if ( IntersectTriangle( ray, mesh.vertices[triangle.x], mesh.vertices[triangle.y], mesh.vertices[triangle.z], primitiveHit.distance, primitiveHit.u, primitiveHit.v ) ) {
+		primitiveHit.primitive_id = hint.primitive_id;
+		primitiveHit.triangle_id = hint.triangle_id;
 	}
+}
+
 
-	float checkerboard_dist = std::numeric_limits<float>::max();
-	if ( fabs( dir.y ) > 1e-3 ) {
-		float d = -(orig.y + 200) / dir.y; // the checkerboard plane has equation y = -200
-		Vec3f pt = orig + dir * d;
-		if ( d > 0 && fabs(pt.x) < 1000 && fabs(pt.z) < 1000 && d < spheres_dist ) {
-			checkerboard_dist = d;
-			hit = pt;
-			N = Vec3f( 0, 1, 0 );
-			material.diffuse_color = (int( .5f*hit.x/100.0f + 1000.0f ) + int( .5f*hit.z/100.0f )) & 1 ? Vec3f( .3f, .3f, .3f ) : Vec3f( .3f, .2f, .1f );
+bool RayTracer::ResolveHit( const Vec3f& orig, const Vec3f& dir, const PrimitiveHit& primitiveHit, Vec3f& hit, Vec3f& N, int& materialId ) const
+{
+	const int i = primitiveHit.primitive_id;
+	if ( i < 0 )
+		return false;
+	hit = orig + dir * primitiveHit.distance;
+	if ( i < FirstBoxId() ) {
+		N = (hit - spheres[i].center).normalize();
+		materialId = spheres[i].material_id;
+	}
+	else if ( i >= FirstQuadId() ) {
+		const int quadId = i - FirstQuadId();
+		N = Vec3f( quadsNormal[0][quadId], quadsNormal[1][quadId], quadsNormal[2][quadId] );
+		materialId = quads[quadId].MaterialAt( hit );
+	}
+	else if ( i < FirstInstanceId() ) {
+		// Normal of the closest face.
+		const Box& box = boxes[i - FirstBoxId()];
+		float faceDistance = std::numeric_limits<float>::max();
+		for ( size_t axis = 0; axis < 3; ++axis ) {
+			const float distances[2] = { std::fabs( hit[axis] - box.min_corner[axis] ), std::fabs( hit[axis] - box.max_corner[axis] ) };
+			for ( int side = 0; side < 2; ++side ) {
+				if ( distances[side] < faceDistance ) {
+					faceDistance = distances[side];
+					N = Vec3f( 0, 0, 0 );
+					N[axis] = side == 0 ? -1.0f : 1.0f;
+				}
+			}
 		}
+		materialId = box.material_id;
 	}
-	return std::min( spheres_dist, checkerboard_dist ) < 100000.0f;
-}
\ No newline at end of file
+	else {
+		const Instance& instance = instances[i - FirstInstanceId()];
+		const InstanceTransform& transform = instancesTransform[i - FirstInstanceId()];
+		N = meshes[instance.mesh_id].ShadingNormal( primitiveHit.triangle_id, primitiveHit.u, primitiveHit.v );
+		if ( !transform.identity )
+			N = transform.NormalToWorld( N ).normalize();
+		materialId = instance.material_id;
+	}
+	return primitiveHit.distance < scene_max_distance;
+}
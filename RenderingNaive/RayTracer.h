@@ -11,16 +11,72 @@
 #ifndef RENDERINGNAIVE_RAYTRACER_H
 #define RENDERINGNAIVE_RAYTRACER_H
 
+#include <cstdint>
+#include <vector>
+
 #define _USE_MATH_DEFINES
 #include "geometry.h"
 #include "Image2D.h"
 
+#include "Bvh.h"
+#include "LightGrid.h"
+#include "TriangleMesh.h"
+
 
+struct Box;
+struct Instance;
 struct Light;
 struct Material;
+struct Quad;
 struct Sphere;
 
 
+// Closest hit among primitives of the scene. Primitives are numbered as spheres, boxes, instances (all in the scene BVH), and quads.
+struct PrimitiveHit
+{
+	float distance = std::numeric_limits<float>::max();
+	int primitive_id = -1;
+	int triangle_id = -1; // Instances only: triangle of the shared mesh.
+	float u = 0.0f; // Barycentrics of the triangle hit.
+	float v = 0.0f;
+};
+
+
+// Rays of one depth traced in the wavefront mode, and time of their sorting and intersection (summed over threads).
+struct WavefrontDepthStatistics
+{
+	uint64_t rays = 0;
+	double sort_seconds = 0.0;
+	double intersect_seconds = 0.0;
+};
+
+
+// One rendered view: pinhole camera (MultiView), or projector, whose rays pass through the observer line (HoloVizio).
+struct RenderView
+{
+	Image2D* image = nullptr;
+	Vec3f position;
+	Vec2f screen_half_size;
+	bool projector = false;
+	float observer_distance = 0.0f; // Projectors only.
+	// Projectors only: rays keep the vertical direction from the projector (grids of several rows of projectors);
+	// otherwise the display has horizontal parallax only, and rays start at the height of the observer (y=0).
+	bool vertical_parallax = false;
+	// Adaptive anti-aliasing: if given, only pixels with n > 1 strata are rendered (again), as average of n x n jittered samples.
+	const unsigned char* pixel_strata = nullptr;
+	// Progressive rendering: sample 0 is at pixel centers, other samples are jittered within pixels.
+	int sample_id = 0;
+	// Statistics builds (see RayStatistics): if given, work of rays of every pixel is added to it, except in the wavefront mode.
+	float* pixel_work = nullptr;
+	// Primary hit cache (see PrimaryHitCache), used only while there are no strata: if given, hits of primary rays are stored to it,
+	// or, with reuse_primary_hits, they are taken from it and only shaded, without any primary intersection.
+	PrimitiveHit* primary_hits = nullptr;
+	bool reuse_primary_hits = false;
+	// Animation (see FrameSequenceRenderer): if given, tiles with all pixels flagged are skipped, they keep their images and primary hits.
+	const unsigned char* pixel_reuse = nullptr;
+};
+
+
 
 // Based on tinyraytracer project: https://github.com/ssloy/tinyraytracer
 
@@ -33,32 +89,220 @@ public:
 	void RemoveAllGeometry();
 	void RemoveAllLights();
 
-	void AddSphere( const Sphere& sphere );
+	// Primitives refer to materials by ids, returned by AddMaterial. Materials are removed together with geometry.
+	int AddMaterial( const Material& material );
+	bool AddSphere( const Sphere& sphere );
+	bool AddQuad( const Quad& quad );
+	bool AddBox( const Box& box );
+	// Shared mesh is stored (with its BVH) once and placed into the scene by instances; returns its id, or -1 if the mesh is invalid.
+	int AddSharedMesh( const TriangleMesh& mesh );
+	bool AddInstance( const Instance& instance );
+	bool AddMesh( const TriangleMesh& mesh, const int materialId ); // Shared mesh with one instance in place.
 	void AddLight( const Light& light );
 
-	bool SetMaxRayDepth( const int raydepth );
+	// Animation: existing primitives and lights are moved, by their ids in order of adding per type; moves to the same place are ignored.
+	// The scene BVH is refitted to moved primitives, not rebuilt (see UpdateAccelerationStructure), so the cost follows the number of moves.
+	bool MoveSphere( const int sphereId, const Vec3f& center );
+	bool MoveQuad( const int quadId, const Vec3f& center );
+	bool MoveBox( const int boxId, const Vec3f& minCorner, const Vec3f& maxCorner );
+	bool MoveInstance( const int instanceId, const Vec3f& position );
+	bool MoveLight( const int lightId, const Vec3f& position );
+	// Regions changed since the last call: bounds of moved primitives before and after moves, and bounds of spheres of influence
+	// of moved lights, all padded by the offset of secondary rays. Returns false if the change is not bounded: a light of unlimited
+	// radius has moved, or geometry or lights were added or removed.
+	bool TakeChangedBounds( std::vector<Aabb>& bounds );
+	// Animation: true if pixels [xBegin, xEnd) x [yBegin, yEnd) of the view would be rendered the same as before the changes within
+	// the given bounds, which needs hits of pixel centers (see RenderView::primary_hits) of that rendering. A pixel qualifies if its ray
+	// ends at the primary hit (no reflection nor refraction), and neither the ray up to the hit nor shadow rays of the hit enter the bounds.
+	bool IsTileUnchanged( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd, const std::vector<Aabb>& changedBounds ) const;
+
+	bool SetMaxRayDepth( const int raydepth ); // At most 30.
+	bool SetMinRayWeight( const float rayweight ); // Reflected and refracted rays of smaller contribution to the pixel are not traced.
+	// Many-light sampling: every hit point casts shadow rays only to the given number of lights, chosen at random in proportion
+	// to their intensities among lights, which can illuminate the point. Zero (default) means all these lights.
+	bool SetLightSamples( const int lightSamples );
+	void SetPacketTracing( const bool packetTracing ) { this->packetTracing = packetTracing; } // Trace primary rays in packets (on by default).
+	// Wavefront mode: rays of a tile go through the stages (intersection, shading, shadows, secondary rays) together,
+	// depth by depth, instead of the recursive per-ray CastRay. Result is the same up to the order of summation.
+	void SetWavefront( const bool wavefront ) { this->wavefront = wavefront; }
+	// Wavefront mode: secondary rays are reordered by direction octant and origin cell in batches of the given number of rays,
+	// so that consecutive rays traverse the same BVH nodes. Zero disables sorting (default).
+	bool SetRaySortBatch( const int raySortBatch );
+	// Statistics of the wavefront mode per ray depth, accumulated since the last reset.
+	void ResetDepthStatistics();
+	const std::vector<WavefrontDepthStatistics>& DepthStatistics() const { return depthStatistics; }
+
+	// Hash of shapes and placement of primitives (not of materials), which hits of rays depend on.
+	uint64_t GeometryHash() const;
+	// True if the hit is a miss or refers to an existing primitive (and triangle of an instance), e.g., for hits read from files.
+	bool IsHitValid( const PrimitiveHit& primitiveHit ) const;
+
+	// Rebuilds acceleration structure and light grid, if geometry or lights have changed since the last build; if primitives have only
+	// moved, the scene BVH is refitted. Rendering calls it automatically.
+	void UpdateAccelerationStructure();
+
+	// Binary cache of geometry, lights and acceleration structure (for the same build on the same machine).
+	// Reading replaces all geometry and lights; acceleration structure is used as is.
+	bool WriteScene( std::ostream& stream );
+	bool ReadScene( std::istream& stream );
 
 	void RenderPinhole( Image2D& image, const Vec3f& position, const Vec2f& screenHalfSize );
 	void RenderProjector( Image2D& image, const Vec3f& position, const float observerDistance, const Vec2f& screenHalfSize );
+	// Renders pixels [xBegin, xEnd) x [yBegin, yEnd) of the view. Tiles can be rendered in parallel,
+	// but acceleration structure has to be updated beforehand.
+	void RenderTile( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd );
+	// Renders the same pixels of all views (of the same image size) row by row, every pixel after the same pixel of the previous view.
+	// Rays of neighbouring projectors through a screen row lie in one epipolar plane and mostly hit the same primitives,
+	// so the hit of the previous view is intersected first and bounds the traversal. Result is the same as of RenderTile.
+	void RenderTileViews( const std::vector<RenderView>& views, const int xBegin, const int yBegin, const int xEnd, const int yEnd );
 
 private:
-	Vec3f CastRay( const Vec3f& origin, const Vec3f& direction, int depth = 0 );
+	// Primary rays of pixels [xBegin, xEnd) of the image row j, through pixel centers or jittered (see RenderView::sample_id).
+	void RowPrimaryRays( const RenderView& view, const int j, const int xBegin, const int xEnd, Vec3f* origins, Vec3f* directions ) const;
+	// Primary ray through the point of the view image; x is from the left, y is from the bottom, in pixels.
+	void PrimaryRay( const RenderView& view, const float x, const float y, Vec3f& origin, Vec3f& direction ) const;
+	// Origin of the primary ray and its point on the screen plane; both are linear functions of x and y.
+	void PrimaryRaySegment( const RenderView& view, const float x, const float y, Vec3f& origin, Vec3f& screenPos ) const;
+	// Ranges of origins and of unnormalized directions of rays through pixels [xBegin, xEnd) x [yBegin, yEnd) of the view, at any position within pixels.
+	void TileRayBounds( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd, Aabb& origins, Aabb& directions ) const;
+	// True if no ray through pixels [xBegin, xEnd) x [yBegin, yEnd) of the view (at any position within pixels) can hit the scene bounds.
+	bool TileMissesScene( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd ) const;
+	// True if all pixels of the tile are flagged for reuse (see RenderView::pixel_reuse).
+	static bool TileReused( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd );
+	// Fills pixels of a tile, which misses the scene, with the result of tracing: the background, and no hits.
+	void FillBackground( const RenderView& view, const int xBegin, const int yBegin, const int xEnd, const int yEnd ) const;
+	// Consecutive primary rays (e.g., of an image row). Rays are traced in packets, if enabled.
+	// Hints are hits of coherent rays, which are intersected first; they are replaced by hits of the traced rays.
+	// Work of every ray (see RayStatistics) is written to work, if given; work of a packet is shared equally by its rays.
+	// With hitsKnown, hints are exact hits of the rays (e.g., cached ones), which are only shaded.
+	void TracePrimaryRays( const Vec3f* origins, const Vec3f* directions, const int count, Vec3f* colors, PrimitiveHit* hints = nullptr, float* work = nullptr, const bool hitsKnown = false );
+	// Wavefront variant of TracePrimaryRays: every stage is a loop over all rays of the current depth.
+	// Hits are not used as hints; if given, they are replaced by hits of the rays, or, with hitsKnown, they are used as these hits.
+	void TraceWavefront( const Vec3f* origins, const Vec3f* directions, const int count, Vec3f* colors, PrimitiveHit* primaryHits = nullptr, const bool hitsKnown = false );
+	// Traces the ray and its reflections and refractions. Intersection of the ray itself can be given, if it is already known.
+	Vec3f CastRay( const Vec3f& origin, const Vec3f& direction, const PrimitiveHit* primaryHit = nullptr );
+	// Diffuse and specular lighting of the hit point, including shadows.
+	Vec3f ShadeDirect( const Vec3f& direction, const Vec3f& point, const Vec3f& N, const Material& material );
+	// Diffuse and specular light intensities of the hit point: all lights, which can illuminate it, or samples of them.
+	void LightIntensities( const Vec3f& direction, const Vec3f& point, const Vec3f& N, const float specularExponent, float& diffuse, float& specular );
+	// Adds intensities of the light, scaled by the weight, unless the point is in its shadow.
+	void AddLightIntensities( const Light& light, const float weight, const Vec3f& direction, const Vec3f& point, const Vec3f& N, const float specularExponent, float& diffuse, float& specular );
 	Vec3f Reflect( const Vec3f &I, const Vec3f &N );
 	Vec3f Refract( const Vec3f &I, const Vec3f &N, const float eta_t, const float eta_i = 1.0f );
-	bool SceneIntersect( const Vec3f &orig, const Vec3f &dir, Vec3f &hit, Vec3f &N, Material &material );
+	void IntersectPrimitives( const Vec3f& orig, const Vec3f& dir, PrimitiveHit& primitiveHit ) const;
+	void IntersectPrimitivesPacket( RayPacket& packet, PrimitiveHit* primitiveHits ) const;
+	// Returns true if the primitive is hit closer than distance, and updates the distance (and primitiveHit of instances).
+	bool IntersectPrimitive( const int primitiveId, const Vec3f& orig, const Vec3f& dir, float& distance, PrimitiveHit& primitiveHit, const bool anyHit ) const;
+	// Packet kernels: distances and hit flags (closer than packet distances) of all lanes for one primitive.
+	void IntersectSpherePacket( const int sphereId, const RayPacket& packet, const int* activeLanes, float* distances, int* hits ) const;
+	void IntersectQuadPacket( const int quadId, const RayPacket& packet, const int* activeLanes, float* distances, int* hits ) const;
+	void IntersectBoxPacket( const int boxId, const RayPacket& packet, const int* activeLanes, float* distances, int* hits ) const;
+	bool IntersectQuad( const int quadId, const Vec3f& orig, const Vec3f& dir, float& distance ) const;
+	bool IntersectBox( const int boxId, const Vec3f& orig, const Vec3f& dir, float& distance ) const;
+	// Intersects the shared mesh with the ray in object space of the instance; parameter along the ray is the same as in world space.
+	bool IntersectInstance( const int instanceId, const Vec3f& orig, const Vec3f& dir, PrimitiveHit& primitiveHit, const bool anyHit = false ) const;
+	// Returns true if the mesh is hit closer than primitiveHit.distance. With anyHit, the first found hit is returned, not the closest one.
+	bool IntersectMesh( const int meshId, const Vec3f& orig, const Vec3f& dir, PrimitiveHit& primitiveHit, const bool anyHit = false ) const;
+	// Replaces the hit of a coherent ray by the hit of the ray with the same primitive, or by no hit.
+	void IntersectHint( const Vec3f& orig, const Vec3f& dir, PrimitiveHit& primitiveHit ) const;
+	// Shadow query: checks if anything is hit closer than maxDistance, stopping at the first blocker.
+	bool Occluded( const Vec3f& orig, const Vec3f& dir, const float maxDistance ) const;
+	// Fills hit point, normal and material id of the closest hit. Textures (checkers of quads) are evaluated here,
+	// once per traced ray, not for every hit found during traversal.
+	bool ResolveHit( const Vec3f& orig, const Vec3f& dir, const PrimitiveHit& primitiveHit, Vec3f& hit, Vec3f& N, int& materialId ) const;
+	void UpdatePrimitivesLayout();
+	void UpdateCullingBounds();
+	// Moved primitives are updated in the SoA layout, the scene BVH is refitted to them, and culling bounds are recomputed.
+	void RefitAccelerationStructure();
+	// Bounds of a primitive of any type (see PrimitiveHit); instances need the BVH of their mesh.
+	Aabb PrimitiveBounds( const int primitiveId ) const;
+	// Records bounds of the primitive before and after its move.
+	void AddMoveBounds( const int primitiveId );
+
+	// Ranges of primitive ids; the scene BVH has all primitives before the first quad.
+	int FirstBoxId() const { return static_cast<int>( spheres.size() ); }
+	int FirstInstanceId() const { return FirstBoxId() + static_cast<int>( boxes.size() ); }
+	int FirstQuadId() const { return FirstInstanceId() + static_cast<int>( instances.size() ); }
+	int NumPrimitives() const { return FirstQuadId() + static_cast<int>( quads.size() ); }
+
+	// World to object space of an instance: rows of the inverse of its axes (columns), and its position.
+	// Identity instances (e.g., added by AddMesh) skip the transform, so their hits are exactly the same as of the mesh itself.
+	struct InstanceTransform
+	{
+		Vec3f inverse_rows[3];
+		Vec3f position;
+		bool identity = true;
+
+		Vec3f PointToObject( const Vec3f& point ) const;
+		Vec3f VectorToObject( const Vec3f& vector ) const;
+		Vec3f NormalToWorld( const Vec3f& normal ) const; // Not normalized.
+	};
+	static bool ComputeInstanceTransform( const Instance& instance, InstanceTransform& transform );
 
 private:
 	std::vector<Sphere> spheres;
+	std::vector<Quad> quads;
+	std::vector<Box> boxes;
+	std::vector<TriangleMesh> meshes; // Shared meshes, placed by instances.
+	std::vector<Instance> instances;
+	std::vector<InstanceTransform> instancesTransform;
+	std::vector<Material> materials; // Shared by all primitives.
 	std::vector<Light>  lights;
+	LightGrid lightGrid;
+	bool lightsChanged;
+	int lightSamples;
+
+	// Two-level hierarchy: scene BVH over spheres, boxes and instances, every shared mesh has own BVH over triangles.
+	// Mesh BVHs are built once, scene BVH is rebuilt whenever geometry changes. Quads are few and large (floors, walls),
+	// their bounds would overlap most of the scene, so they are intersected by every ray before the traversal, which their hits bound.
+	Bvh sceneBvh;
+	std::vector<Bvh> meshesBvh;
+	bool geometryChanged;
+	// Bounds of the scene BVH and of every quad, padded against rounding: tiles, whose rays miss all of them, are filled
+	// with the background without tracing. Rays, which miss the union of quads, skip quad tests.
+	std::vector<Aabb> cullingBounds;
+	Aabb quadsBounds;
+	// Animation: primitives moved since the last update of the acceleration structure, and changes since the last TakeChangedBounds.
+	std::vector<int> movedPrimitives;
+	std::vector<Aabb> changedBounds;
+	bool changesUnbounded;
+
+	// Spheres, quads and boxes in SoA layout for packet intersection; vectors are split into arrays of x, y and z.
+	std::vector<float> spheresCenterX;
+	std::vector<float> spheresCenterY;
+	std::vector<float> spheresCenterZ;
+	std::vector<float> spheresRadius;
+	std::vector<float> quadsCenter[3];
+	std::vector<float> quadsNormal[3];
+	std::vector<float> quadsAxisU[3];
+	std::vector<float> quadsAxisV[3];
+	std::vector<float> quadsHalfSize[2];
+	std::vector<float> boxesMin[3];
+	std::vector<float> boxesMax[3];
+
+	bool packetTracing;
+	bool wavefront;
+	int raySortBatch;
+	std::vector<WavefrontDepthStatistics> depthStatistics;
 
 	int maxRayDepth;
+	float minRayWeight;
 };
 
 
 struct Light {
-	Light( const Vec3f &p, const float i ) noexcept : position( p ), intensity( i ) {}
+	Light( const Vec3f &p, const float i, const float r = 0.0f ) noexcept : position( p ), intensity( i ), radius( r ) {}
+	Light() noexcept : position(), intensity(), radius() {}
 	Vec3f position;
 	float intensity;
+	float radius; // Light of limited radius fades out smoothly towards it, 0 means unlimited radius and no fading.
+
+	float Attenuation( const float distance ) const {
+		if ( radius <= 0.0f ) return 1.0f;
+		const float x = distance / radius;
+		const float window = 1.0f - x*x*x*x;
+		return window > 0.0f ? window*window : 0.0f;
+	}
 };
 
 struct Material {
@@ -73,9 +317,10 @@ struct Material {
 struct Sphere {
 	Vec3f center;
 	float radius;
-	Material material;
+	int material_id;
 
-	Sphere( const Vec3f &c, const float r, const Material &m ) noexcept : center( c ), radius( r ), material( m ) {}
+	Sphere( const Vec3f &c, const float r, const int m ) noexcept : center( c ), radius( r ), material_id( m ) {}
+	Sphere() noexcept : center(), radius(), material_id() {}
 
 	bool ray_intersect( const Vec3f &orig, const Vec3f &dir, float &t0 ) const {
 		const Vec3f L = center - orig;
@@ -91,5 +336,60 @@ struct Sphere {
 	}
 };
 
+// Rectangle with the center and half sizes along two orthogonal unit axes. Its normal is axis_v x axis_u (y for axes x and z),
+// both sides are hit. With a checker material, the quad is a checkerboard of cells of the given size: the cell (i, j)
+// has i = int( u / cell_size + offset.x ) and j = int( v / cell_size + offset.y ), where u and v are coordinates along the axes
+// from the center; cells of odd i + j have material_id, cells of even i + j have checker_material_id.
+// Indices are truncated towards zero, offsets keep them positive across the quad.
+struct Quad {
+	Vec3f center;
+	Vec3f axis_u;
+	Vec3f axis_v;
+	Vec2f half_size;
+	int material_id;
+	int checker_material_id; // -1 means a plain quad.
+	float checker_cell_size;
+	Vec2f checker_offset;
+
+	Quad( const Vec3f &c, const Vec3f &u, const Vec3f &v, const Vec2f &h, const int m ) noexcept
+		: center( c ), axis_u( u ), axis_v( v ), half_size( h ), material_id( m ), checker_material_id( -1 ), checker_cell_size( 1.0f ), checker_offset( 0.0f, 0.0f ) {}
+	Quad() noexcept : center(), axis_u( 1, 0, 0 ), axis_v( 0, 0, 1 ), half_size(), material_id(), checker_material_id( -1 ), checker_cell_size( 1.0f ), checker_offset( 0.0f, 0.0f ) {}
+
+	Vec3f Normal() const { return cross( axis_v, axis_u ); }
+	// Material at the point of the quad.
+	int MaterialAt( const Vec3f &point ) const {
+		if ( checker_material_id < 0 ) return material_id;
+		const Vec3f offset = point - center;
+		const int i = int( offset * axis_u / checker_cell_size + checker_offset.x );
+		const int j = int( offset * axis_v / checker_cell_size + checker_offset.y );
+		return (i + j) & 1 ? material_id : checker_material_id;
+	}
+};
+
+// Axis-aligned box.
+struct Box {
+	Vec3f min_corner;
+	Vec3f max_corner;
+	int material_id;
+
+	Box( const Vec3f &minCorner, const Vec3f &maxCorner, const int m ) noexcept : min_corner( minCorner ), max_corner( maxCorner ), material_id( m ) {}
+	Box() noexcept : min_corner(), max_corner(), material_id() {}
+};
+
+// Shared mesh placed into the scene: a point p of the mesh is at position + axis_x*p.x + axis_y*p.y + axis_z*p.z.
+// Axes may be scaled and sheared, but not degenerate. Instances of the same mesh may have different materials.
+struct Instance {
+	int mesh_id; // Returned by AddSharedMesh.
+	int material_id;
+	Vec3f position;
+	Vec3f axis_x;
+	Vec3f axis_y;
+	Vec3f axis_z;
+
+	Instance( const int mesh, const int m, const Vec3f &p = Vec3f( 0, 0, 0 ), const Vec3f &x = Vec3f( 1, 0, 0 ), const Vec3f &y = Vec3f( 0, 1, 0 ), const Vec3f &z = Vec3f( 0, 0, 1 ) ) noexcept
+		: mesh_id( mesh ), material_id( m ), position( p ), axis_x( x ), axis_y( y ), axis_z( z ) {}
+	Instance() noexcept : mesh_id(), material_id(), position(), axis_x( 1, 0, 0 ), axis_y( 0, 1, 0 ), axis_z( 0, 0, 1 ) {}
+};
+
 
 #endif // RENDERINGNAIVE_RAYTRACER_H
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - SceneAnimation
+*
+* Keyframed motion of primitives and lights of a scene, applied to the ray tracer frame by frame.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "SceneAnimation.h"
+
+#include <algorithm>
+
+#include "RayTracer.h"
+
+
+
+void SceneAnimation::Setup( const SceneModel& sceneModel )
+{
+	tracks.clear();
+	Track track;
+	for ( size_t i = 0; i < sceneModel.spheres.size(); ++i )
+	{
+		track.type = TrackType::Sphere;
+		track.id = static_cast<int>( i );
+		track.position = sceneModel.spheres[i].center;
+		track.keyframes = sceneModel.spheres[i].keyframes;
+		if ( !track.keyframes.empty() )
+			tracks.push_back( track );
+	}
+	for ( size_t i = 0; i < sceneModel.quads.size(); ++i )
+	{
+		track.type = TrackType::Quad;
+		track.id = static_cast<int>( i );
+		track.position = sceneModel.quads[i].center;
+		track.keyframes = sceneModel.quads[i].keyframes;
+		if ( !track.keyframes.empty() )
+			tracks.push_back( track );
+	}
+	for ( size_t i = 0; i < sceneModel.boxes.size(); ++i )
+	{
+		track.type = TrackType::Box;
+		track.id = static_cast<int>( i );
+		track.position = sceneModel.boxes[i].min_corner;
+		track.max_corner = sceneModel.boxes[i].max_corner;
+		track.keyframes = sceneModel.boxes[i].keyframes;
+		if ( !track.keyframes.empty() )
+			tracks.push_back( track );
+	}
+	// Mesh without instances is placed by one instance, which is never animated.
+	int instanceId = 0;
+	for ( const SceneMesh& mesh : sceneModel.meshes )
+	{
+		if ( mesh.instances.empty() )
+			++instanceId;
+		for ( const SceneInstance& instance : mesh.instances )
+		{
+			track.type = TrackType::Instance;
+			track.id = instanceId++;
+			track.position = instance.position;
+			track.keyframes = instance.keyframes;
+			if ( !track.keyframes.empty() )
+				tracks.push_back( track );
+		}
+	}
+	for ( size_t i = 0; i < sceneModel.lights.size(); ++i )
+	{
+		track.type = TrackType::Light;
+		track.id = static_cast<int>( i );
+		track.position = sceneModel.lights[i].position;
+		track.keyframes = sceneModel.lights[i].keyframes;
+		if ( !track.keyframes.empty() )
+			tracks.push_back( track );
+	}
+}
+
+
+
+int SceneAnimation::NumFrames() const
+{
+	int numFrames = 0;
+	for ( const Track& track : tracks )
+		numFrames = std::max( numFrames, track.keyframes.back().frame + 1 );
+	return numFrames;
+}
+
+
+
+bool SceneAnimation::Apply( const int frame, RayTracer& rayTracer ) const
+{
+	bool success = true;
+	for ( const Track& track : tracks )
+	{
+		const Vec3f offset = Offset( track.keyframes, frame );
+		switch ( track.type )
+		{
+		case TrackType::Sphere:
+			success = rayTracer.MoveSphere( track.id, track.position + offset ) && success;
+			break;
+		case TrackType::Quad:
+			success = rayTracer.MoveQuad( track.id, track.position + offset ) && success;
+			break;
+		case TrackType::Box:
+			success = rayTracer.MoveBox( track.id, track.position + offset, track.max_corner + offset ) && success;
+			break;
+		case TrackType::Instance:
+			success = rayTracer.MoveInstance( track.id, track.position + offset ) && success;
+			break;
+		case TrackType::Light:
+			success = rayTracer.MoveLight( track.id, track.position + offset ) && success;
+			break;
+		}
+	}
+	return success;
+}
+
+
+
+Vec3f SceneAnimation::Offset( const std::vector<SceneKeyframe>& keyframes, const int frame )
+{
+	if ( frame <= keyframes.front().frame )
+		return keyframes.front().offset;
+	if ( frame >= keyframes.back().frame )
+		return keyframes.back().offset;
+	// First keyframe after the frame, and the one before it.
+	const auto next = std::upper_bound( keyframes.begin(), keyframes.end(), frame,
+		[]( const int value, const SceneKeyframe& keyframe ) { return value < keyframe.frame; } );
+	const SceneKeyframe& previous = *(next - 1);
+	const float t = static_cast<float>( frame - previous.frame ) / static_cast<float>( next->frame - previous.frame );
+	return previous.offset + (next->offset - previous.offset) * t;
+}
@@ -0,0 +1,54 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - SceneAnimation
+*
+* Keyframed motion of primitives and lights of a scene, applied to the ray tracer frame by frame.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_SCENEANIMATION_H
+#define RENDERINGNAIVE_SCENEANIMATION_H
+
+#include <vector>
+
+#include "geometry.h"
+#include "SceneModel.h"
+
+class RayTracer;
+
+
+// Every animated object of the scene is a track: its place in the scene file and its keyframes (see SceneKeyframe).
+// Objects are identified by their order in the scene file, as SceneLoader adds them, so the animation applies
+// to a ray tracer with that scene (loaded from the file or from its cache), before any other primitives.
+
+class SceneAnimation
+{
+public:
+	void Setup( const SceneModel& sceneModel );
+
+	bool IsEmpty() const { return tracks.empty(); }
+	int NumFrames() const; // Up to the last keyframe.
+
+	// Moves all animated objects to their places at the frame; objects, which have not moved since the last frame, are ignored
+	// by the ray tracer. Returns false if an object does not exist in the ray tracer.
+	bool Apply( const int frame, RayTracer& rayTracer ) const;
+
+private:
+	enum class TrackType { Sphere, Quad, Box, Instance, Light };
+	struct Track
+	{
+		TrackType type;
+		int id; // Per type, in order of adding to the ray tracer.
+		Vec3f position; // Center, minimal corner or position in the scene file.
+		Vec3f max_corner; // Boxes only.
+		std::vector<SceneKeyframe> keyframes;
+	};
+
+	static Vec3f Offset( const std::vector<SceneKeyframe>& keyframes, const int frame );
+
+	std::vector<Track> tracks;
+};
+
+#endif // RENDERINGNAIVE_SCENEANIMATION_H
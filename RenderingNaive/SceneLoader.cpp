@@ -0,0 +1,195 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - SceneLoader
+*
+* Loads scene files into the ray tracer, using binary cache with prebuilt acceleration structure.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "SceneLoader.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "BinaryStream.h"
+#include "MeshLoader.h"
+#include "RayTracer.h"
+#include "SceneModel.h"
+#include "TriangleMesh.h"
+
+
+const uint32_t cache_magic = 0x4e435346; // "FSCN" in little endian.
+const uint32_t cache_version = 4;
+const size_t hash_buffer_size = 1 << 20;
+
+
+
+static bool IsAbsolutePath( const std::string& file_path )
+{
+	return (!file_path.empty() && (file_path[0] == '/' || file_path[0] == '\\')) || (file_path.size() > 1 && file_path[1] == ':');
+}
+
+
+
+static std::string FolderOf( const std::string& file_path )
+{
+	const size_t separator = file_path.find_last_of( "/\\" );
+	return separator == std::string::npos ? std::string() : file_path.substr( 0, separator + 1 );
+}
+
+
+
+// FNV-1a hash of the file contents, chained with the previous hash.
+static bool HashFile( const std::string& file_path, uint64_t& hash )
+{
+	std::ifstream filestream( file_path, std::ifstream::in | std::ifstream::binary );
+	if ( !filestream.is_open() )
+		return false;
+	std::vector<char> buffer( hash_buffer_size );
+	while ( filestream )
+	{
+		filestream.read( buffer.data(), buffer.size() );
+		const std::streamsize count = filestream.gcount();
+		for ( std::streamsize i = 0; i < count; ++i )
+		{
+			hash ^= static_cast<unsigned char>( buffer[i] );
+			hash *= 0x100000001b3ull;
+		}
+	}
+	return true;
+}
+
+
+
+std::string SceneLoader::CachePath( const std::string& file_path )
+{
+	const std::string extension = ".json";
+	if ( file_path.size() > extension.size() && file_path.compare( file_path.size() - extension.size(), extension.size(), extension ) == 0 )
+		return file_path.substr( 0, file_path.size() - extension.size() ) + ".cache";
+	return file_path + ".cache";
+}
+
+
+
+bool SceneLoader::Setup( const SceneModel& sceneModel, const std::string& folder, RayTracer& rayTracer )
+{
+	// Ids of the scene materials in the material table of the ray tracer.
+	std::vector<int> materialIds;
+	for ( const SceneMaterial& material : sceneModel.materials )
+		materialIds.push_back( rayTracer.AddMaterial( Material( material.refractive_index, material.albedo, material.diffuse_color, material.specular_exponent ) ) );
+
+	for ( const SceneSphere& sphere : sceneModel.spheres )
+	{
+		if ( !rayTracer.AddSphere( Sphere( sphere.center, sphere.radius, materialIds.at( sphere.material_id ) ) ) )
+			return false;
+	}
+
+	for ( const SceneQuad& sceneQuad : sceneModel.quads )
+	{
+		Quad quad( sceneQuad.center, sceneQuad.axis_u, sceneQuad.axis_v, sceneQuad.half_size, materialIds.at( sceneQuad.material_id ) );
+		if ( sceneQuad.checker_material_id >= 0 )
+		{
+			quad.checker_material_id = materialIds.at( sceneQuad.checker_material_id );
+			quad.checker_cell_size = sceneQuad.checker_cell_size;
+			quad.checker_offset = sceneQuad.checker_offset;
+		}
+		if ( !rayTracer.AddQuad( quad ) )
+			return false;
+	}
+
+	for ( const SceneBox& box : sceneModel.boxes )
+	{
+		if ( !rayTracer.AddBox( Box( box.min_corner, box.max_corner, materialIds.at( box.material_id ) ) ) )
+			return false;
+	}
+
+	// Every mesh is stored once, however many instances it has.
+	for ( const SceneMesh& sceneMesh : sceneModel.meshes )
+	{
+		TriangleMesh mesh;
+		const std::string meshPath = IsAbsolutePath( sceneMesh.file_path ) ? sceneMesh.file_path : folder + sceneMesh.file_path;
+		if ( !MeshLoader::Load( meshPath, mesh ) )
+			return false;
+		if ( sceneMesh.instances.empty() )
+		{
+			if ( !rayTracer.AddMesh( mesh, materialIds.at( sceneMesh.material_id ) ) )
+				return false;
+			continue;
+		}
+		const int meshId = rayTracer.AddSharedMesh( mesh );
+		if ( meshId < 0 )
+			return false;
+		for ( const SceneInstance& instance : sceneMesh.instances )
+		{
+			const int materialId = materialIds.at( instance.material_id >= 0 ? instance.material_id : sceneMesh.material_id );
+			if ( !rayTracer.AddInstance( Instance( meshId, materialId, instance.position, instance.axis_x, instance.axis_y, instance.axis_z ) ) )
+				return false;
+		}
+	}
+
+	for ( const SceneLight& light : sceneModel.lights )
+		rayTracer.AddLight( Light( light.position, light.intensity, light.radius ) );
+
+	return true;
+}
+
+
+
+bool SceneLoader::Load( const std::string& file_path, RayTracer& rayTracer, const bool useCache )
+{
+	rayTracer.RemoveAllGeometry();
+	rayTracer.RemoveAllLights();
+
+	SceneModel sceneModel;
+	if ( !sceneModel.Deserialize( file_path ) )
+		return false;
+	const std::string folder = FolderOf( file_path );
+
+	// +++++ Hash of the scene and its meshes. +++++
+	uint64_t hash = 0xcbf29ce484222325ull;
+	bool hashValid = HashFile( file_path, hash );
+	for ( const SceneMesh& sceneMesh : sceneModel.meshes )
+		hashValid = hashValid && HashFile( IsAbsolutePath( sceneMesh.file_path ) ? sceneMesh.file_path : folder + sceneMesh.file_path, hash );
+	// ----- Hash of the scene and its meshes. -----
+
+	// +++++ Try the cache. +++++
+	const std::string cachePath = CachePath( file_path );
+	if ( useCache && hashValid )
+	{
+		std::ifstream filestream( cachePath, std::ifstream::in | std::ifstream::binary );
+		uint32_t magic = 0, version = 0;
+		uint64_t cacheHash = 0;
+		if ( filestream.is_open() && ReadBinary( filestream, magic ) && ReadBinary( filestream, version ) && ReadBinary( filestream, cacheHash ) &&
+			magic == cache_magic && version == cache_version && cacheHash == hash )
+		{
+			if ( rayTracer.ReadScene( filestream ) )
+				return true;
+		}
+	}
+	// ----- Try the cache. -----
+
+	if ( !Setup( sceneModel, folder, rayTracer ) )
+	{
+		rayTracer.RemoveAllGeometry();
+		rayTracer.RemoveAllLights();
+		return false;
+	}
+
+	// +++++ Write the cache; the scene is usable even if writing fails. +++++
+	if ( useCache && hashValid )
+	{
+		std::ofstream filestream( cachePath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc );
+		const bool written = filestream.is_open() && WriteBinary( filestream, cache_magic ) && WriteBinary( filestream, cache_version ) && WriteBinary( filestream, hash ) &&
+			rayTracer.WriteScene( filestream );
+		filestream.close();
+		if ( !written )
+			std::remove( cachePath.c_str() );
+	}
+	// ----- Write the cache; the scene is usable even if writing fails. -----
+
+	return true;
+}
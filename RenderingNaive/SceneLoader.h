@@ -0,0 +1,37 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - SceneLoader
+*
+* Loads scene files into the ray tracer, using binary cache with prebuilt acceleration structure.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_SCENELOADER_H
+#define RENDERINGNAIVE_SCENELOADER_H
+
+#include <string>
+
+class RayTracer;
+struct SceneModel;
+
+
+// Cache is stored next to the scene file, with extension ".cache" instead of ".json".
+// It is identified by hash of the scene file and all mesh files, so any change of them invalidates it.
+// Cache is a raw memory dump, it is valid only for the same build on the same machine.
+
+class SceneLoader
+{
+public:
+	// Replaces geometry and lights of the ray tracer with the scene. Cache is used if it is up to date,
+	// otherwise the scene is parsed, acceleration structure is built and cache is written.
+	static bool Load( const std::string& file_path, RayTracer& rayTracer, const bool useCache = true );
+
+	// Adds primitives, meshes and lights of the scene to the ray tracer; mesh paths are relative to the folder.
+	static bool Setup( const SceneModel& sceneModel, const std::string& folder, RayTracer& rayTracer );
+
+	static std::string CachePath( const std::string& file_path );
+};
+
+#endif // RENDERINGNAIVE_SCENELOADER_H
@@ -0,0 +1,218 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - TileScheduler
+*
+* Renders tiles of all views of a light field in one task pool with work stealing.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+const int default_tile_size = 32;
+
+
+// Range of tiles of one thread. The owner takes tiles from the front, thieves take them from the back.
+struct TileQueue
+{
+	std::mutex mutex;
+	int begin = 0;
+	int end = 0;
+};
+
+
+
+TileScheduler::TileScheduler()
+	:tileSize( default_tile_size )
+	,progressReport( true )
+	,viewGrouping( false )
+	,seconds( 0.0f )
+	,numThreads( 1 )
+{
+
+}
+
+
+
+bool TileScheduler::SetTileSize( const int tileSize )
+{
+	if ( tileSize <= 0 )
+		return false;
+	this->tileSize = tileSize;
+	return true;
+}
+
+
+
+void TileScheduler::Render( RayTracer& rayTracer, const std::vector<RenderView>& views )
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point startTime = Clock::now();
+
+	// +++++ Split views into tiles. +++++
+	bool groupViews = viewGrouping && !views.empty();
+	for ( const RenderView& view : views )
+		groupViews = groupViews && view.image->Width() == views[0].image->Width() && view.image->Height() == views[0].image->Height();
+	std::vector<RenderTileTask> tasks;
+	for ( int viewId = 0; viewId < (groupViews ? 1 : static_cast<int>( views.size() )); ++viewId )
+	{
+		const int width = views[viewId].image->Width();
+		const int height = views[viewId].image->Height();
+		for ( int y = 0; y < height; y += tileSize )
+		{
+			for ( int x = 0; x < width; x += tileSize )
+			{
+				RenderTileTask task;
+				task.view_id = groupViews ? -1 : viewId;
+				task.x_begin = x;
+				task.y_begin = y;
+				task.x_end = std::min( x + tileSize, width );
+				task.y_end = std::min( y + tileSize, height );
+				tasks.push_back( task );
+			}
+		}
+	}
+	const int numTasks = static_cast<int>( tasks.size() );
+	tileCosts.assign( numTasks, TileCost() );
+	// ----- Split views into tiles. -----
+
+#ifdef _OPENMP
+	numThreads = omp_get_max_threads();
+#else
+	numThreads = 1;
+#endif
+	std::unique_ptr<TileQueue[]> queues( new TileQueue[numThreads] );
+	for ( int t = 0; t < numThreads; ++t )
+	{
+		queues[t].begin = static_cast<int>( static_cast<long long>( numTasks ) * t / numThreads );
+		queues[t].end = static_cast<int>( static_cast<long long>( numTasks ) * (t+1) / numThreads );
+	}
+	std::atomic<int> numCompleted( 0 );
+
+	rayTracer.UpdateAccelerationStructure();
+#pragma omp parallel num_threads( numThreads )
+	{
+#ifdef _OPENMP
+		const int threadId = omp_get_thread_num();
+#else
+		const int threadId = 0;
+#endif
+		TileQueue& ownQueue = queues[threadId];
+		while ( true )
+		{
+			// +++++ Take the next own tile, or steal half of the remaining tiles of the most loaded thread. +++++
+			int taskId = -1;
+			bool stolen = false;
+			{
+				std::lock_guard<std::mutex> lock( ownQueue.mutex );
+				if ( ownQueue.begin < ownQueue.end )
+					taskId = ownQueue.begin++;
+			}
+			while ( taskId < 0 )
+			{
+				int victimId = -1;
+				int victimSize = 0;
+				for ( int t = 0; t < numThreads; ++t )
+				{
+					if ( t == threadId )
+						continue;
+					std::lock_guard<std::mutex> lock( queues[t].mutex );
+					if ( queues[t].end - queues[t].begin > victimSize )
+					{
+						victimId = t;
+						victimSize = queues[t].end - queues[t].begin;
+					}
+				}
+				if ( victimId < 0 )
+					break;
+				std::lock( queues[victimId].mutex, ownQueue.mutex );
+				std::lock_guard<std::mutex> victimLock( queues[victimId].mutex, std::adopt_lock );
+				std::lock_guard<std::mutex> ownLock( ownQueue.mutex, std::adopt_lock );
+				TileQueue& victimQueue = queues[victimId];
+				const int size = victimQueue.end - victimQueue.begin;
+				if ( size <= 0 )
+					continue; // Meanwhile, the victim has finished its tiles, look for another one.
+				const int stealSize = (size + 1) / 2;
+				ownQueue.begin = victimQueue.end - stealSize;
+				ownQueue.end = victimQueue.end;
+				victimQueue.end -= stealSize;
+				taskId = ownQueue.begin++;
+				stolen = true;
+			}
+			if ( taskId < 0 )
+				break; // All tiles are taken.
+			// ----- Take the next own tile, or steal half of the remaining tiles of the most loaded thread. -----
+
+			const RenderTileTask& task = tasks[taskId];
+			const Clock::time_point tileStartTime = Clock::now();
+			if ( task.view_id < 0 )
+				rayTracer.RenderTileViews( views, task.x_begin, task.y_begin, task.x_end, task.y_end );
+			else
+				rayTracer.RenderTile( views[task.view_id], task.x_begin, task.y_begin, task.x_end, task.y_end );
+
+			TileCost& cost = tileCosts[taskId];
+			cost.view_id = task.view_id;
+			cost.x_begin = task.x_begin;
+			cost.y_begin = task.y_begin;
+			cost.seconds = std::chrono::duration<float>( Clock::now() - tileStartTime ).count();
+			cost.thread_id = threadId;
+			cost.stolen = stolen;
+
+			const int completed = ++numCompleted;
+			if ( progressReport && completed * 10 / numTasks != (completed - 1) * 10 / numTasks )
+			{
+#pragma omp critical
+				std::cout << "Rendered " << completed * 100 / numTasks << "% (" << completed << " of " << numTasks << " tiles)." << std::endl;
+			}
+		}
+	}
+
+	seconds = std::chrono::duration<float>( Clock::now() - startTime ).count();
+}
+
+
+
+float TileScheduler::Utilization() const
+{
+	double busySeconds = 0.0;
+	for ( const TileCost& cost : tileCosts )
+		busySeconds += cost.seconds;
+	return seconds > 0.0f ? static_cast<float>( busySeconds / (static_cast<double>( seconds ) * numThreads) ) : 0.0f;
+}
+
+
+
+void TileScheduler::PrintStatistics() const
+{
+	if ( tileCosts.empty() )
+		return;
+	int numStolen = 0;
+	double sumSeconds = 0.0;
+	size_t maxId = 0;
+	for ( size_t i = 0; i < tileCosts.size(); ++i )
+	{
+		numStolen += tileCosts[i].stolen ? 1 : 0;
+		sumSeconds += tileCosts[i].seconds;
+		if ( tileCosts[i].seconds > tileCosts[maxId].seconds )
+			maxId = i;
+	}
+	const TileCost& maxCost = tileCosts[maxId];
+	std::cout << "Rendered " << tileCosts.size() << " tiles in " << seconds << " s with " << numThreads << " threads, utilization " << Utilization() * 100.0f << "%, "
+		<< numStolen << " tiles stolen." << std::endl;
+	std::cout << "Tile cost: mean " << sumSeconds / tileCosts.size() * 1000.0 << " ms, max " << maxCost.seconds * 1000.0f << " ms ("
+		<< (maxCost.view_id < 0 ? std::string( "all views" ) : "view " + std::to_string( maxCost.view_id )) << ", pixel " << maxCost.x_begin << ", " << maxCost.y_begin << ")." << std::endl;
+}
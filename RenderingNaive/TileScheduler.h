@@ -0,0 +1,75 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - TileScheduler
+*
+* Renders tiles of all views of a light field in one task pool with work stealing.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_TILESCHEDULER_H
+#define RENDERINGNAIVE_TILESCHEDULER_H
+
+#include <vector>
+
+#include "RayTracer.h"
+
+
+struct RenderTileTask
+{
+	int view_id = 0; // -1 for the tile of all views.
+	int x_begin = 0;
+	int y_begin = 0;
+	int x_end = 0;
+	int y_end = 0;
+};
+
+struct TileCost
+{
+	int view_id = 0; // -1 for the tile of all views.
+	int x_begin = 0;
+	int y_begin = 0;
+	float seconds = 0.0f;
+	int thread_id = 0;
+	bool stolen = false; // Rendered by other thread, than the one it was assigned to.
+};
+
+
+
+// Tiles of all views are split into contiguous ranges, one per thread, so every thread renders neighbouring tiles.
+// Thread, which has finished its range, steals tiles from the end of the range of the most loaded thread,
+// so threads stay busy until the last tile of the last view, regardless of how costly particular tiles are.
+
+class TileScheduler
+{
+public:
+	TileScheduler();
+
+	bool SetTileSize( const int tileSize );
+	void SetProgressReport( const bool progressReport ) { this->progressReport = progressReport; } // Prints progress every 10% (on by default).
+	// Every tile covers the same pixels of all views, they are rendered together with RayTracer::RenderTileViews (off by default).
+	// Applies only if all views have the same image size.
+	void SetViewGrouping( const bool viewGrouping ) { this->viewGrouping = viewGrouping; }
+
+	// Renders all views; images of views have to be allocated.
+	void Render( RayTracer& rayTracer, const std::vector<RenderView>& views );
+
+	// Statistics of the last Render call.
+	const std::vector<TileCost>& TileCosts() const { return tileCosts; }
+	float Seconds() const { return seconds; }
+	// Fraction of the thread time spent on rendering tiles.
+	float Utilization() const;
+	void PrintStatistics() const;
+
+private:
+	int tileSize;
+	bool progressReport;
+	bool viewGrouping;
+
+	std::vector<TileCost> tileCosts;
+	float seconds;
+	int numThreads;
+};
+
+#endif // RENDERINGNAIVE_TILESCHEDULER_H
@@ -0,0 +1,144 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - TriangleMesh
+*
+* Indexed triangle mesh and watertight ray-triangle intersection.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "TriangleMesh.h"
+
+#include "BinaryStream.h"
+
+
+void TriangleMesh::Clear()
+{
+	vertices.clear();
+	normals.clear();
+	triangles.clear();
+}
+
+
+
+bool TriangleMesh::IsValid() const
+{
+	if ( !normals.empty() && normals.size() != vertices.size() )
+		return false;
+	const int numVertices = static_cast<int>( vertices.size() );
+	for ( const Vec3i& triangle : triangles )
+	{
+		if ( triangle.x < 0 || triangle.x >= numVertices || triangle.y < 0 || triangle.y >= numVertices || triangle.z < 0 || triangle.z >= numVertices )
+			return false;
+	}
+	return true;
+}
+
+
+
+void TriangleMesh::ComputeVertexNormals()
+{
+	normals.assign( vertices.size(), Vec3f( 0.0f, 0.0f, 0.0f ) );
+	for ( const Vec3i& triangle : triangles )
+	{
+		// Not normalized cross product is proportional to the triangle area.
+		const Vec3f normal = cross( vertices[triangle.y] - vertices[triangle.x], vertices[triangle.z] - vertices[triangle.x] );
+		normals[triangle.x] = normals[triangle.x] + normal;
+		normals[triangle.y] = normals[triangle.y] + normal;
+		normals[triangle.z] = normals[triangle.z] + normal;
+	}
+	for ( Vec3f& normal : normals )
+	{
+		if ( normal*normal > 0.0f )
+			normal.normalize();
+	}
+}
+
+
+
+Aabb TriangleMesh::Bounds() const
+{
+	Aabb bounds;
+	for ( const Vec3f& vertex : vertices )
+		bounds.Grow( vertex );
+	return bounds;
+}
+
+
+
+void TriangleMesh::TrianglesBounds( std::vector<Aabb>& bounds ) const
+{
+	const int numTriangles = static_cast<int>( triangles.size() );
+	bounds.resize( numTriangles );
+#pragma omp parallel for
+	for ( int i = 0; i < numTriangles; ++i )
+	{
+		Aabb triangleBounds;
+		triangleBounds.Grow( vertices[ triangles[i].x ] );
+		triangleBounds.Grow( vertices[ triangles[i].y ] );
+		triangleBounds.Grow( vertices[ triangles[i].z ] );
+		bounds[i] = triangleBounds;
+	}
+}
+
+
+
+Vec3f TriangleMesh::GeometricNormal( const int triangleId ) const
+{
+	const Vec3i& triangle = triangles[triangleId];
+	return cross( vertices[triangle.y] - vertices[triangle.x], vertices[triangle.z] - vertices[triangle.x] ).normalize();
+}
+
+
+
+Vec3f TriangleMesh::ShadingNormal( const int triangleId, const float u, const float v ) const
+{
+	if ( normals.empty() )
+		return GeometricNormal( triangleId );
+	const Vec3i& triangle = triangles[triangleId];
+	Vec3f normal = normals[triangle.x]*(1.0f - u - v) + normals[triangle.y]*u + normals[triangle.z]*v;
+	if ( normal*normal == 0.0f )
+		return GeometricNormal( triangleId );
+	return normal.normalize();
+}
+
+
+
+WatertightRay::WatertightRay( const Vec3f& origin, const Vec3f& direction ) noexcept
+{
+	org[0] = origin.x;
+	org[1] = origin.y;
+	org[2] = origin.z;
+	const float dir[3] = { direction.x, direction.y, direction.z };
+	const float absDir[3] = { std::abs( dir[0] ), std::abs( dir[1] ), std::abs( dir[2] ) };
+	kz = absDir[0] > absDir[1] ? (absDir[0] > absDir[2] ? 0 : 2) : (absDir[1] > absDir[2] ? 1 : 2);
+	kx = (kz + 1) % 3;
+	ky = (kx + 1) % 3;
+	// Keep winding of the triangle in the ray space.
+	if ( dir[kz] < 0.0f )
+		std::swap( kx, ky );
+	sx = dir[kx] / dir[kz];
+	sy = dir[ky] / dir[kz];
+	sz = 1.0f / dir[kz];
+}
+
+
+
+bool TriangleMesh::Write( std::ostream& stream ) const
+{
+	return WriteBinaryVector( stream, vertices ) && WriteBinaryVector( stream, normals ) && WriteBinaryVector( stream, triangles );
+}
+
+
+
+bool TriangleMesh::Read( std::istream& stream )
+{
+	const bool success = ReadBinaryVector( stream, vertices ) && ReadBinaryVector( stream, normals ) && ReadBinaryVector( stream, triangles );
+	if ( !success || !IsValid() )
+	{
+		Clear();
+		return false;
+	}
+	return true;
+}
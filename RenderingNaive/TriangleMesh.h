@@ -0,0 +1,98 @@
+/*
+* LightFieldDisplayModel - RenderingNaive - TriangleMesh
+*
+* Indexed triangle mesh and watertight ray-triangle intersection.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef RENDERINGNAIVE_TRIANGLEMESH_H
+#define RENDERINGNAIVE_TRIANGLEMESH_H
+
+#include "geometry.h"
+
+#include "Bvh.h"
+
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+
+// Vertices are shared between triangles. Normals are optional: if given, there is one normal per vertex,
+// otherwise triangles are shaded with geometric normals (counter-clockwise winding faces outwards).
+struct TriangleMesh
+{
+	std::vector<Vec3f> vertices;
+	std::vector<Vec3f> normals;
+	std::vector<Vec3i> triangles;
+
+	void Clear();
+	bool IsValid() const; // All indices are in range, normals are either absent or given per vertex.
+	void ComputeVertexNormals(); // Area weighted average of adjacent triangle normals.
+	Aabb Bounds() const;
+	void TrianglesBounds( std::vector<Aabb>& bounds ) const;
+	Vec3f GeometricNormal( const int triangleId ) const;
+	Vec3f ShadingNormal( const int triangleId, const float u, const float v ) const; // u and v are barycentrics of the 2nd and 3rd vertices.
+
+	// Binary cache of the mesh.
+	bool Write( std::ostream& stream ) const;
+	bool Read( std::istream& stream );
+};
+
+
+// Per-ray setup of watertight ray-triangle intersection: Woop, Benthin, Wald, "Watertight Ray/Triangle Intersection", JCGT 2013.
+// Shared edges are never missed and never hit twice, regardless of the direction.
+struct WatertightRay
+{
+	WatertightRay( const Vec3f& origin, const Vec3f& direction ) noexcept;
+
+	float org[3];
+	int kx, ky, kz; // Axes permutation, kz is the dominant direction axis.
+	float sx, sy, sz; // Shear to the ray space.
+};
+
+
+// Returns true if triangle is hit closer than distance; updates distance and barycentrics of the 2nd and 3rd vertices.
+inline bool IntersectTriangle( const WatertightRay& ray, const Vec3f& v0, const Vec3f& v1, const Vec3f& v2, float& distance, float& u, float& v )
+{
+	const float* p0 = &v0.x;
+	const float* p1 = &v1.x;
+	const float* p2 = &v2.x;
+	const float ax = p0[ray.kx] - ray.org[ray.kx], ay = p0[ray.ky] - ray.org[ray.ky], az = p0[ray.kz] - ray.org[ray.kz];
+	const float bx = p1[ray.kx] - ray.org[ray.kx], by = p1[ray.ky] - ray.org[ray.ky], bz = p1[ray.kz] - ray.org[ray.kz];
+	const float cx = p2[ray.kx] - ray.org[ray.kx], cy = p2[ray.ky] - ray.org[ray.ky], cz = p2[ray.kz] - ray.org[ray.kz];
+	const float shearAx = ax - ray.sx*az, shearAy = ay - ray.sy*az;
+	const float shearBx = bx - ray.sx*bz, shearBy = by - ray.sy*bz;
+	const float shearCx = cx - ray.sx*cz, shearCy = cy - ray.sy*cz;
+
+	float e0 = shearBx*shearCy - shearBy*shearCx;
+	float e1 = shearCx*shearAy - shearCy*shearAx;
+	float e2 = shearAx*shearBy - shearAy*shearBx;
+	// Edge exactly through the ray: recompute in double precision to decide consistently.
+	if ( e0 == 0.0f || e1 == 0.0f || e2 == 0.0f )
+	{
+		e0 = static_cast<float>( static_cast<double>(shearBx)*shearCy - static_cast<double>(shearBy)*shearCx );
+		e1 = static_cast<float>( static_cast<double>(shearCx)*shearAy - static_cast<double>(shearCy)*shearAx );
+		e2 = static_cast<float>( static_cast<double>(shearAx)*shearBy - static_cast<double>(shearAy)*shearBx );
+	}
+	if ( (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f) && (e0 > 0.0f || e1 > 0.0f || e2 > 0.0f) )
+		return false;
+	const float det = e0 + e1 + e2;
+	if ( det == 0.0f )
+		return false;
+
+	const float t = e0*ray.sz*az + e1*ray.sz*bz + e2*ray.sz*cz;
+	// Compare scaled distance, so the division happens only for accepted hits.
+	if ( det > 0.0f ? (t <= 0.0f || t >= distance*det) : (t >= 0.0f || t <= distance*det) )
+		return false;
+	const float inverseDet = 1.0f / det;
+	distance = t * inverseDet;
+	u = e1 * inverseDet;
+	v = e2 * inverseDet;
+	return true;
+}
+
+#endif // RENDERINGNAIVE_TRIANGLEMESH_H
@@ -8,27 +8,58 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
 
 #include "HoloVizioModel.h"
 #include "MultiViewModel.h"
+#include "SceneModel.h"
 
+#include "AdaptiveSampler.h"
+#include "FrameSequenceRenderer.h"
+#include "LightFieldInterpolation.h"
+#include "MeshLoader.h"
+#include "PrimaryHitCache.h"
+#include "ProgressiveRenderer.h"
+#include "RayStatistics.h"
 #include "RayTracer.h"
+#include "SceneAnimation.h"
+#include "SceneLoader.h"
+#include "TileScheduler.h"
 #include "Image3D.h"
 
 
+const float checkpoint_interval = 60.0f; // Seconds between checkpoints of progressive rendering.
+const int max_dense_views = 1024;
+
+
+// Fallback scene, if there is no scene file.
 void SetupScene( RayTracer& rayTracer )
 {
-	Material      ivory( 1.0f, Vec4f( 0.6f, 0.3f, 0.1f, 0.0f ), Vec3f( 0.4f, 0.4f, 0.3f ), 50.0f );
-	Material      glass( 1.5f, Vec4f( 0.0f, 0.5f, 0.1f, 0.8f ), Vec3f( 0.6f, 0.7f, 0.8f ), 125.0f );
-	Material red_rubber( 1.0f, Vec4f( 0.9f, 0.1f, 0.0f, 0.0f ), Vec3f( 0.3f, 0.1f, 0.1f ), 10.0f );
-	Material     mirror( 1.0f, Vec4f( 0.0f, 10.0f, 0.8f, 0.0f ), Vec3f( 1.0f, 1.0f, 1.0f ), 1425.0f );
+	const int      ivory = rayTracer.AddMaterial( Material( 1.0f, Vec4f( 0.6f, 0.3f, 0.1f, 0.0f ), Vec3f( 0.4f, 0.4f, 0.3f ), 50.0f ) );
+	const int      glass = rayTracer.AddMaterial( Material( 1.5f, Vec4f( 0.0f, 0.5f, 0.1f, 0.8f ), Vec3f( 0.6f, 0.7f, 0.8f ), 125.0f ) );
+	const int red_rubber = rayTracer.AddMaterial( Material( 1.0f, Vec4f( 0.9f, 0.1f, 0.0f, 0.0f ), Vec3f( 0.3f, 0.1f, 0.1f ), 10.0f ) );
+	const int     mirror = rayTracer.AddMaterial( Material( 1.0f, Vec4f( 0.0f, 10.0f, 0.8f, 0.0f ), Vec3f( 1.0f, 1.0f, 1.0f ), 1425.0f ) );
 
 	rayTracer.AddSphere( Sphere( Vec3f( -180.0f, -80.0f, -40.0f ), 80.0f, ivory ) );
 	rayTracer.AddSphere( Sphere( Vec3f( -100.0f, -100.0f, 120.0f ), 80.0f, glass ) );
 	rayTracer.AddSphere( Sphere( Vec3f( 0.0f, -60.0f, -120.0f ), 120.0f, red_rubber ) );
 	rayTracer.AddSphere( Sphere( Vec3f( 300.0f, 120.0f, -200.0f ), 160.0f, mirror ) );
 
+	Quad floor( Vec3f( 0.0f, -200.0f, 0.0f ), Vec3f( 1.0f, 0.0f, 0.0f ), Vec3f( 0.0f, 0.0f, 1.0f ), Vec2f( 1000.0f, 1000.0f ),
+		rayTracer.AddMaterial( Material( 1.0f, Vec4f( 1.0f, 0.0f, 0.0f, 0.0f ), Vec3f( 0.3f, 0.3f, 0.3f ), 0.0f ) ) );
+	floor.checker_material_id = rayTracer.AddMaterial( Material( 1.0f, Vec4f( 1.0f, 0.0f, 0.0f, 0.0f ), Vec3f( 0.3f, 0.2f, 0.1f ), 0.0f ) );
+	floor.checker_cell_size = 200.0f;
+	floor.checker_offset = Vec2f( 1000.0f, 0.0f );
+	rayTracer.AddQuad( floor );
+
 	rayTracer.AddLight( Light( Vec3f( -1000.0f, 1000.0f, 1000.0f ), 1.5f ) );
 	rayTracer.AddLight( Light( Vec3f( 1500.0f, 2500.0f, -1200.0f ), 1.8f ) );
 	rayTracer.AddLight( Light( Vec3f( 1500.0f, 1000.0f, 1500.0f ), 1.7f ) );
@@ -36,14 +67,299 @@ void SetupScene( RayTracer& rayTracer )
 
 
 
+// Renders all views with one sample per pixel, then renders contrast pixels again with adaptive anti-aliasing.
+// Views of coherent rays (e.g., neighbouring projectors) can be rendered together, tile by tile.
+// Statistics builds save counters to "<outputPath>_statistics.json" and heatmaps of work to "<outputPath>_work/".
+// With hitCache, hits of primary rays are kept in "<outputPath>.hits" (see PrimaryHitCache) and reused by the next run.
+void RenderViews( RayTracer& rayTracer, std::vector<RenderView>& views, Image3D& sampleCountImage, const bool viewGrouping, const std::string& outputPath, const bool hitCache )
+{
+	const int numViews = static_cast<int>( views.size() );
+	PrimaryHitCache primaryHitCache;
+	if ( hitCache )
+	{
+		primaryHitCache.Read( outputPath + ".hits" );
+		std::cout << "Reusing primary hits of " << primaryHitCache.Attach( rayTracer, views ) << " of " << numViews << " views." << std::endl;
+	}
+	std::vector<std::vector<float>> viewsWork;
+	if ( RayStatistics::Enabled() )
+	{
+		RayStatistics::Reset();
+		viewsWork.resize( numViews );
+		for ( int viewId = 0; viewId < numViews; ++viewId )
+		{
+			viewsWork[viewId].assign( views[viewId].image->Width() * views[viewId].image->Height(), 0.0f );
+			views[viewId].pixel_work = viewsWork[viewId].data();
+		}
+	}
+
+	TileScheduler tileScheduler;
+	tileScheduler.SetViewGrouping( viewGrouping );
+	tileScheduler.Render( rayTracer, views );
+	tileScheduler.PrintStatistics();
+	std::vector<TileCost> tileCosts = tileScheduler.TileCosts();
+	if ( hitCache )
+	{
+		PrimaryHitCache::Detach( views );
+		if ( !primaryHitCache.Write( outputPath + ".hits" ) )
+			std::cout << "Could not save primary hits to " << outputPath << ".hits." << std::endl;
+	}
+
+	AdaptiveSampler adaptiveSampler;
+	std::vector<std::vector<unsigned char>> viewsStrata( numViews );
+	std::vector<size_t> viewsSamples( numViews );
+#pragma omp parallel for
+	for ( int viewId = 0; viewId < numViews; ++viewId )
+		viewsSamples[viewId] = adaptiveSampler.Plan( *views[viewId].image, viewsStrata[viewId] );
+
+	size_t numPixels = 0, numSamples = 0;
+	sampleCountImage.Resize( views[0].image->Width(), views[0].image->Height(), numViews );
+	for ( int viewId = 0; viewId < numViews; ++viewId )
+	{
+		numPixels += views[viewId].image->Width() * views[viewId].image->Height();
+		numSamples += viewsSamples[viewId];
+		views[viewId].pixel_strata = viewsStrata[viewId].data();
+		AdaptiveSampler::SampleCountImage( viewsStrata[viewId], views[viewId].image->Width(), views[viewId].image->Height(), sampleCountImage.Layer(viewId) );
+	}
+	std::cout << "Anti-aliasing with " << numSamples << " additional samples (" << static_cast<double>( numSamples ) / numPixels << " per pixel)..." << std::endl;
+	tileScheduler.Render( rayTracer, views );
+	tileScheduler.PrintStatistics();
+	tileCosts.insert( tileCosts.end(), tileScheduler.TileCosts().begin(), tileScheduler.TileCosts().end() );
+
+	for ( RenderView& view : views )
+	{
+		view.pixel_strata = nullptr;
+		view.pixel_work = nullptr;
+	}
+
+	// +++++ Save statistics, heatmaps share the scale of the most costly pixel. +++++
+	if ( RayStatistics::Enabled() )
+	{
+		if ( !RayStatistics::Serialize( outputPath + "_statistics.json", RayStatistics::Total(), tileCosts ) )
+			std::cout << "Could not save statistics to " << outputPath << "_statistics.json." << std::endl;
+		float maxWork = 0.0f;
+		for ( const std::vector<float>& work : viewsWork )
+			maxWork = std::max( maxWork, *std::max_element( work.begin(), work.end() ) );
+		Image3D heatmapImage;
+		heatmapImage.Resize( views[0].image->Width(), views[0].image->Height(), numViews );
+		for ( int viewId = 0; viewId < numViews; ++viewId )
+			RayStatistics::HeatmapImage( viewsWork[viewId], views[viewId].image->Width(), views[viewId].image->Height(), maxWork, heatmapImage.Layer(viewId) );
+		heatmapImage.Save( outputPath + "_work/" );
+	}
+	// ----- Save statistics, heatmaps share the scale of the most costly pixel. -----
+}
+
+
+
+// Renders frames of the animation one after another and saves every frame, once it is rendered, to "<outputPath>_frames/<frame>_<view>.exr".
+void RenderFrames( RayTracer& rayTracer, const SceneAnimation& animation, const int numFrames, const std::vector<RenderView>& views, const bool viewGrouping, const Image3D& image3d, const std::string& outputPath )
+{
+	FrameSequenceRenderer frameRenderer;
+	frameRenderer.SetViewGrouping( viewGrouping );
+	float seconds = 0.0f;
+	for ( int frame = 0; frame < numFrames; ++frame )
+	{
+		if ( !frameRenderer.RenderFrame( rayTracer, animation, frame, views ) )
+			std::cout << "Animation does not fit the scene, some objects are not moved." << std::endl;
+		seconds += frameRenderer.Seconds();
+		std::cout << "Frame " << frame << " done in " << frameRenderer.Seconds() << " s, reused " << frameRenderer.ReusedTiles() << " of " << frameRenderer.NumTiles() << " tiles." << std::endl;
+		std::ostringstream prefix;
+		prefix << outputPath << "_frames/" << std::setfill( '0' ) << std::setw( 4 ) << frame << "_";
+		if ( !image3d.Save( prefix.str() ) )
+			std::cout << "Could not save frame " << frame << " to " << outputPath << "_frames/." << std::endl;
+	}
+	std::cout << "Rendered " << numFrames << " frames in " << seconds << " s." << std::endl;
+}
+
+
+
+// Dense light field is parametrized by the screen plane and the observer line of HoloVizio: it is a MultiView model
+// of pinhole cameras along the observer line. Cameras cover all rays of both displays, their spacing is the finest spacing
+// of rays of neighbouring views at the observer line, and they are aligned to multiples of it, so MultiView cameras
+// at the observer line are reproduced exactly. Screen size and pixel pitch are the largest and the finest of both displays.
+// A single row has no vertical parallax, so models with several rows of views, or with cameras off the observer line's height, are rejected.
+bool BuildDenseModel( const HoloVizioModel& holoVizioModel, const MultiViewModel& multiViewModel, MultiViewModel& denseModel )
+{
+	if ( holoVizioModel.NumProjectorsY() > 1 || multiViewModel.NumCamerasY() > 1 )
+		return false;
+	for ( const float cameraY : multiViewModel.cameras_pos_y )
+	{
+		if ( cameraY != 0.0f )
+			return false;
+	}
+
+	const float observerDistance = holoVizioModel.observer_distance;
+	const float screenSizeX = std::max( holoVizioModel.screen_size_x, multiViewModel.screen_size_x );
+	const float screenSizeY = std::max( holoVizioModel.screen_size_y, multiViewModel.screen_size_y );
+	const float pixelPitch = std::min( std::min( holoVizioModel.screen_size_x / holoVizioModel.image_size_x, holoVizioModel.screen_size_y / holoVizioModel.image_size_y ),
+		std::min( multiViewModel.screen_size_x / multiViewModel.image_size_x, multiViewModel.screen_size_y / multiViewModel.image_size_y ) );
+
+	// +++++ Range and spacing of rays of all views at the observer line. +++++
+	std::vector<Vec3f> viewsPos;
+	for ( int projId = 0; projId < holoVizioModel.num_projectors; ++projId )
+		viewsPos.push_back( Vec3f( holoVizioModel.projectors_pos_x[projId], holoVizioModel.projectors_pos_y[projId], holoVizioModel.projectors_pos_z[projId] ) );
+	for ( int cameraId = 0; cameraId < multiViewModel.num_cameras; ++cameraId )
+		viewsPos.push_back( Vec3f( multiViewModel.cameras_pos_x[cameraId], multiViewModel.cameras_pos_y[cameraId], multiViewModel.cameras_pos_z[cameraId] ) );
+
+	// Ray through the screen point x and the view position hits the observer line at x + (view.x - x) * distance / view.z.
+	float xMin = std::numeric_limits<float>::max(), xMax = -std::numeric_limits<float>::max();
+	for ( const Vec3f& viewPos : viewsPos )
+	{
+		for ( const float screenX : { -0.5f*screenSizeX, 0.5f*screenSizeX } )
+		{
+			const float observerX = screenX + (viewPos.x - screenX) * observerDistance / viewPos.z;
+			xMin = std::min( xMin, observerX );
+			xMax = std::max( xMax, observerX );
+		}
+	}
+	// Neighbouring views of the first row of each grid.
+	float spacing = std::numeric_limits<float>::max();
+	for ( int projId = 1; projId < holoVizioModel.NumProjectorsX(); ++projId )
+		spacing = std::min( spacing, std::abs( holoVizioModel.projectors_pos_x[projId] - holoVizioModel.projectors_pos_x[projId-1] ) * observerDistance / std::abs( holoVizioModel.projectors_pos_z[projId] ) );
+	for ( int cameraId = 1; cameraId < multiViewModel.NumCamerasX(); ++cameraId )
+		spacing = std::min( spacing, std::abs( multiViewModel.cameras_pos_x[cameraId] - multiViewModel.cameras_pos_x[cameraId-1] ) * observerDistance / std::abs( multiViewModel.cameras_pos_z[cameraId] ) );
+	// ----- Range and spacing of rays of all views at the observer line. -----
+
+	if ( observerDistance <= 0.0f || !(spacing > 0.0f) || spacing == std::numeric_limits<float>::max() || !(pixelPitch > 0.0f) )
+		return false;
+	const float firstX = std::floor( xMin / spacing ) * spacing;
+	const int numViews = static_cast<int>( std::ceil( xMax / spacing ) - std::floor( xMin / spacing ) ) + 1;
+	if ( numViews > max_dense_views )
+		return false;
+
+	denseModel.Clear();
+	denseModel.name = "DenseLightField";
+	denseModel.num_cameras = numViews;
+	denseModel.num_cameras_x = numViews;
+	denseModel.num_cameras_y = 1;
+	denseModel.image_size_x = static_cast<int>( std::ceil( screenSizeX / pixelPitch - 1e-3f ) );
+	denseModel.image_size_y = static_cast<int>( std::ceil( screenSizeY / pixelPitch - 1e-3f ) );
+	denseModel.screen_size_x = screenSizeX;
+	denseModel.screen_size_y = screenSizeY;
+	for ( int cameraId = 0; cameraId < numViews; ++cameraId )
+	{
+		denseModel.cameras_pos_x.push_back( firstX + spacing * cameraId );
+		denseModel.cameras_pos_y.push_back( 0.0f );
+		denseModel.cameras_pos_z.push_back( observerDistance );
+	}
+	return true;
+}
+
+
+
+// Renders the dense light field once, then resamples views of both displays from it.
+bool RenderDenseLightField( RayTracer& rayTracer, const HoloVizioModel& holoVizioModel, const MultiViewModel& multiViewModel, const bool hitCache )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	MultiViewModel denseModel;
+	if ( !BuildDenseModel( holoVizioModel, multiViewModel, denseModel ) )
+	{
+		std::cout << "Could not build dense light field for HoloVizio and MultiView models (it has horizontal parallax only, for single rows of views at y=0)." << std::endl;
+		return false;
+	}
+
+	// +++++ Render dense light field. +++++
+	std::cout << "Rendering dense light field (" << denseModel.num_cameras << " views of " << denseModel.image_size_x << "x" << denseModel.image_size_y << ")..." << std::endl;
+	Clock::time_point startTime = Clock::now();
+	Image3D denseImage, sampleCountImage;
+	denseImage.Resize( denseModel.image_size_x, denseModel.image_size_y, denseModel.num_cameras );
+	std::vector<RenderView> views( denseModel.num_cameras );
+	for ( int viewId = 0; viewId < denseModel.num_cameras; ++viewId )
+	{
+		views[viewId].image = &denseImage.Layer(viewId);
+		views[viewId].position = Vec3f( denseModel.cameras_pos_x[viewId], denseModel.cameras_pos_y[viewId], denseModel.cameras_pos_z[viewId] );
+		views[viewId].screen_half_size = Vec2f( denseModel.screen_size_x, denseModel.screen_size_y ) * 0.5f;
+	}
+	RenderViews( rayTracer, views, sampleCountImage, true, "../../output/rt_dense", hitCache );
+	std::cout << "Rendering dense light field done in " << std::chrono::duration<float>( Clock::now() - startTime ).count() << " s." << std::endl;
+	// ----- Render dense light field. -----
+
+	// +++++ Resample views of both displays and save. +++++
+	LightFieldInterpolation lfInterpolation( holoVizioModel, denseModel );
+	Image3D image3d;
+	startTime = Clock::now();
+	if ( !lfInterpolation.Convert_MultiView_to_MultiView( denseImage, multiViewModel, image3d ) )
+		return false;
+	std::cout << "Resampling MultiView images done in " << std::chrono::duration<float>( Clock::now() - startTime ).count() << " s." << std::endl;
+	image3d.Save( "../../output/rt_multiview/" );
+
+	startTime = Clock::now();
+	if ( !lfInterpolation.Convert_MultiView_to_HoloVizio( denseImage, image3d ) )
+		return false;
+	std::cout << "Resampling HoloVizio images done in " << std::chrono::duration<float>( Clock::now() - startTime ).count() << " s." << std::endl;
+	image3d.Save( "../../output/rt_holovizio/" );
+	// ----- Resample views of both displays and save. -----
+
+	return true;
+}
+
+
+
 int main( int argc, char** argv )
 {
 	std::cout << "Program started..." << std::endl << std::endl;
 
 	bool success = true;
 
-	// +++++  +++++
-	// -----  -----
+	// +++++ Parse arguments: [mesh file] [--dense] [--wavefront] [--sort-rays <batch size>] [--light-samples <number>] [--progressive <seconds per set of views, 0 for no limit>] [--passes <number>] [--hit-cache] [--frames <number>]. +++++
+	std::string meshPath;
+	bool dense = false;
+	bool wavefront = false;
+	int raySortBatch = 0;
+	int lightSamples = 0;
+	bool progressive = false;
+	bool hitCache = false; // Not used by progressive rendering.
+	int numFrames = 0; // Animation replaces still images of both sets of views, unless the dense light field is rendered.
+	ProgressiveRenderer progressiveRenderer;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const std::string argument = argv[i];
+		if ( argument == "--dense" )
+		{
+			dense = true;
+		}
+		else if ( argument == "--wavefront" )
+		{
+			wavefront = true;
+		}
+		else if ( argument == "--hit-cache" )
+		{
+			hitCache = true;
+		}
+		else if ( argument == "--sort-rays" && i + 1 < argc )
+		{
+			raySortBatch = std::atoi( argv[++i] );
+		}
+		else if ( argument == "--light-samples" && i + 1 < argc )
+		{
+			lightSamples = std::atoi( argv[++i] );
+		}
+		else if ( argument == "--progressive" && i + 1 < argc )
+		{
+			progressive = true;
+			success = success && progressiveRenderer.SetTimeBudget( static_cast<float>( std::atof( argv[++i] ) ) );
+		}
+		else if ( argument == "--passes" && i + 1 < argc )
+		{
+			success = success && progressiveRenderer.SetMaxPasses( std::atoi( argv[++i] ) );
+		}
+		else if ( argument == "--frames" && i + 1 < argc )
+		{
+			numFrames = std::atoi( argv[++i] );
+			success = success && numFrames > 0;
+		}
+		else
+		{
+			meshPath = argument;
+		}
+	}
+
+	if ( !success )
+	{
+		std::cout << "Invalid arguments. I quit." << std::endl;
+		return 1;
+	}
+	// ----- Parse arguments: [mesh file] [--dense] [--wavefront] [--sort-rays <batch size>] [--light-samples <number>] [--progressive <seconds per set of views, 0 for no limit>] [--passes <number>] [--hit-cache] [--frames <number>]. -----
 
 	// +++++ Load HoloVizio and MultiView models. +++++
 	HoloVizioModel holoVizioModel;
@@ -60,61 +376,159 @@ int main( int argc, char** argv )
 	// ----- Load HoloVizio and MultiView models. -----
 
 	// +++++ Get basic info and check if it makes sence. +++++
-	const int width = multiViewModel.screen_size_x;
-	const int height = multiViewModel.screen_size_y;
+	// Images of both models are rendered with their own resolutions and screen sizes.
 	const int num_cameras = multiViewModel.num_cameras;
 	const int num_projectors = holoVizioModel.num_projectors;
 	const float observerDistance = holoVizioModel.observer_distance;
-	const Vec2f screenHalfSize = Vec2f( holoVizioModel.screen_size_x, holoVizioModel.screen_size_y ) * 0.5f;
+	const Vec2f multiViewScreenHalfSize = Vec2f( multiViewModel.screen_size_x, multiViewModel.screen_size_y ) * 0.5f;
+	const Vec2f holoVizioScreenHalfSize = Vec2f( holoVizioModel.screen_size_x, holoVizioModel.screen_size_y ) * 0.5f;
 
-	if ( holoVizioModel.screen_size_x != width || holoVizioModel.screen_size_y != height )
+	if ( multiViewModel.image_size_x == 0 || multiViewModel.image_size_y == 0 || holoVizioModel.image_size_x == 0 || holoVizioModel.image_size_y == 0 )
 	{
-		std::cout << "Image size for HoloVizio and MultiView models must be equal. I quit." << std::endl;
+		std::cout << "Image size for HoloVizio and MultiView models must not be zero. I quit." << std::endl;
 		return 1;
 	}
 	// ----- Get basic info and check if it makes sence. -----
 
 	// +++++ Setup ray tracing. +++++
 	RayTracer rayTracer;
-	SetupScene( rayTracer );
+	rayTracer.SetWavefront( wavefront );
+	if ( !rayTracer.SetRaySortBatch( raySortBatch ) )
+	{
+		std::cout << "Invalid batch size of ray sorting. I quit." << std::endl;
+		return 1;
+	}
+	if ( !rayTracer.SetLightSamples( lightSamples ) )
+	{
+		std::cout << "Invalid number of light samples. I quit." << std::endl;
+		return 1;
+	}
+	{
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point startTime = Clock::now();
+		if ( SceneLoader::Load( "../../data/sample_scene.json", rayTracer ) )
+		{
+			std::cout << "Loaded scene in " << std::chrono::duration<float>( Clock::now() - startTime ).count() * 1000.0f << " ms." << std::endl;
+		}
+		else
+		{
+			std::cout << "Could not load scene file, built-in scene is used." << std::endl;
+			SetupScene( rayTracer );
+		}
+	}
+	// Optional mesh file (OBJ or PLY) in scene coordinates is added to the scene.
+	if ( !meshPath.empty() )
+	{
+		TriangleMesh mesh;
+		if ( !MeshLoader::Load( meshPath, mesh ) )
+		{
+			std::cout << "Could not load mesh " << meshPath << ". I quit." << std::endl;
+			return 1;
+		}
+		std::cout << "Loaded mesh " << meshPath << " (" << mesh.triangles.size() << " triangles)." << std::endl;
+		rayTracer.AddMesh( mesh, rayTracer.AddMaterial( Material( 1.0f, Vec4f( 0.6f, 0.3f, 0.1f, 0.0f ), Vec3f( 0.4f, 0.4f, 0.3f ), 50.0f ) ) );
+	}
 	// ----- Setup ray tracing. -----
 
-	Image3D image3d;
+	// Objects of the scene file move along their keyframes; without the file there is nothing to animate.
+	SceneAnimation animation;
+	if ( numFrames > 0 && !dense )
+	{
+		SceneModel sceneModel;
+		if ( sceneModel.Deserialize( "../../data/sample_scene.json" ) )
+			animation.Setup( sceneModel );
+		if ( animation.IsEmpty() )
+			std::cout << "Scene has no keyframes, all frames are the same." << std::endl;
+		else
+			std::cout << "Scene is animated over " << animation.NumFrames() << " frames." << std::endl;
+	}
+
+	// Dense light field replaces rendering of both sets of views.
+	if ( dense )
+	{
+		success = RenderDenseLightField( rayTracer, holoVizioModel, multiViewModel, hitCache );
+		std::cout << std::endl << "Program ended..." << std::endl;
+		return success ? 0 : 1;
+	}
+
+	Image3D image3d, sampleCountImage;
+	std::vector<RenderView> views;
 
 	// +++++ Render MultiView images and save. +++++
 	std::cout << "Rendering MultiView images (" << num_cameras << " in total)..." << std::endl;
-	image3d.Resize( width, height, num_cameras );
+	image3d.Resize( multiViewModel.image_size_x, multiViewModel.image_size_y, num_cameras );
+	views.assign( num_cameras, RenderView() );
 	for ( int viewId = 0; viewId < num_cameras; ++viewId )
 	{
-		std::cout << "Rendering image " << viewId << " from " << num_cameras << "..." << std::endl;
-		const Vec3f cameraPos(
+		views[viewId].image = &image3d.Layer(viewId);
+		views[viewId].position = Vec3f(
 			multiViewModel.cameras_pos_x[viewId],
 			multiViewModel.cameras_pos_y[viewId],
 			multiViewModel.cameras_pos_z[viewId] );
-		rayTracer.RenderPinhole( image3d.Layer(viewId), cameraPos, screenHalfSize );
+		views[viewId].screen_half_size = multiViewScreenHalfSize;
+	}
+	if ( numFrames > 0 )
+	{
+		RenderFrames( rayTracer, animation, numFrames, views, false, image3d, "../../output/rt_multiview" );
+	}
+	else if ( progressive )
+	{
+		progressiveRenderer.SetCheckpoint( "../../output/rt_multiview.checkpoint", checkpoint_interval );
+		progressiveRenderer.Render( rayTracer, views );
+	}
+	else
+	{
+		RenderViews( rayTracer, views, sampleCountImage, false, "../../output/rt_multiview", hitCache );
 	}
 	std::cout << "Rendering MultiView images done." << std::endl;
-	std::cout << "Saving MultiView images..." << std::endl;
-	image3d.Save( "../../output/rt_multiview/" );
-	std::cout << "Saving MultiView images done." << std::endl;
+	if ( numFrames == 0 )
+	{
+		std::cout << "Saving MultiView images..." << std::endl;
+		image3d.Save( "../../output/rt_multiview/" );
+		if ( !progressive )
+			sampleCountImage.Save( "../../output/rt_multiview_samples/" );
+		std::cout << "Saving MultiView images done." << std::endl;
+	}
 	// ----- Render MultiView images and save. -----
 
 	// +++++ Render HoloVizio images and save. +++++
 	std::cout << "Rendering HoloVizio images (" << num_projectors << " in total)..." << std::endl;
-	image3d.Resize( width, height, num_projectors );
+	image3d.Resize( holoVizioModel.image_size_x, holoVizioModel.image_size_y, num_projectors );
+	views.assign( num_projectors, RenderView() );
 	for ( int projId = 0; projId < num_projectors; ++projId )
 	{
-		std::cout << "Rendering image " << projId << " from " << num_projectors << "..." << std::endl;
-		const Vec3f projectorPos(
+		views[projId].image = &image3d.Layer(projId);
+		views[projId].position = Vec3f(
 			holoVizioModel.projectors_pos_x[projId],
 			holoVizioModel.projectors_pos_y[projId],
 			holoVizioModel.projectors_pos_z[projId] );
-		rayTracer.RenderProjector( image3d.Layer(projId), projectorPos, observerDistance, screenHalfSize );
+		views[projId].screen_half_size = holoVizioScreenHalfSize;
+		views[projId].projector = true;
+		views[projId].observer_distance = observerDistance;
+		views[projId].vertical_parallax = holoVizioModel.NumProjectorsY() > 1;
+	}
+	if ( numFrames > 0 )
+	{
+		RenderFrames( rayTracer, animation, numFrames, views, true, image3d, "../../output/rt_holovizio" );
+	}
+	else if ( progressive )
+	{
+		progressiveRenderer.SetCheckpoint( "../../output/rt_holovizio.checkpoint", checkpoint_interval );
+		progressiveRenderer.Render( rayTracer, views );
+	}
+	else
+	{
+		RenderViews( rayTracer, views, sampleCountImage, true, "../../output/rt_holovizio", hitCache );
 	}
 	std::cout << "Rendering HoloVizio images done." << std::endl;
-	std::cout << "Saving HoloVizio images..." << std::endl;
-	image3d.Save( "../../output/rt_holovizio/" );
-	std::cout << "Saving HoloVizio images done." << std::endl;
+	if ( numFrames == 0 )
+	{
+		std::cout << "Saving HoloVizio images..." << std::endl;
+		image3d.Save( "../../output/rt_holovizio/" );
+		if ( !progressive )
+			sampleCountImage.Save( "../../output/rt_holovizio_samples/" );
+		std::cout << "Saving HoloVizio images done." << std::endl;
+	}
 	// ----- Render HoloVizio images and save. -----
 
 	std::cout << std::endl << "Program ended..." << std::endl;
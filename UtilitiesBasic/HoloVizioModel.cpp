@@ -31,6 +31,8 @@ void HoloVizioModel::Clear()
 {
 	name = std::string();
 	num_projectors = 0;
+	num_projectors_x = 0;
+	num_projectors_y = 0;
 
 	image_size_x = 0;
 	image_size_y = 0;
@@ -59,6 +61,8 @@ bool HoloVizioModel::Serialize( const std::string& file_path )
 	{
 		json["name"] = name;
 		json["num_projectors"] = num_projectors;
+		json["num_projectors_x"] = NumProjectorsX();
+		json["num_projectors_y"] = NumProjectorsY();
 
 		json["image_size_x"] = image_size_x;
 		json["image_size_y"] = image_size_y;
@@ -106,6 +110,12 @@ bool HoloVizioModel::Deserialize( const std::string& file_path )
 
 		name = json["name"].get<std::string>();
 		num_projectors = json["num_projectors"].get<int>();
+		// Grid size is optional, older models describe a single row.
+		num_projectors_x = json.value( "num_projectors_x", num_projectors );
+		num_projectors_y = json.value( "num_projectors_y", 1 );
+		// Grid has to hold exactly all projectors, so that consumers can index projector images by it.
+		if ( num_projectors_x <= 0 || num_projectors_y <= 0 || static_cast<long long>( num_projectors_x )*num_projectors_y != num_projectors )
+			success = false;
 
 		image_size_x = json["image_size_x"].get<int>();
 		image_size_y = json["image_size_y"].get<int>();
@@ -15,13 +15,19 @@
 #include <vector>
 
 // Assumptions:
-//  * projectors are sorted by x-coordinate (increasing);
+//  * projectors form a rectilinear grid of num_projectors_x by num_projectors_y, stored row by row
+//    (i.e., projector id is x_id + y_id*num_projectors_x), single row by default;
+//  * a single row gives horizontal parallax only (seen from the height of the observer, y=0), while rays of a grid of several rows
+//    keep the vertical direction from their projector;
+//  * projectors are sorted by x-coordinate (increasing) in each row, and by y-coordinate (increasing) in each column;
 //  * all projectors are behind the screen (i.e., z<0).
 
 struct HoloVizioModel
 {
 	std::string name;
 	int num_projectors = 0;
+	int num_projectors_x = 0; // Grid size; zero means single row of num_projectors projectors.
+	int num_projectors_y = 0;
 
 	int image_size_x = 0; // In pixels.
 	int image_size_y = 0; // In pixels.
@@ -36,6 +42,9 @@ struct HoloVizioModel
 	std::vector<float> projectors_pos_y;
 	std::vector<float> projectors_pos_z;
 
+	int NumProjectorsX() const { return num_projectors_x > 0 ? num_projectors_x : num_projectors; }
+	int NumProjectorsY() const { return num_projectors_y > 0 ? num_projectors_y : 1; }
+
 	void Clear();
 	bool Serialize( const std::string& file_path );
 	bool Deserialize( const std::string& file_path );
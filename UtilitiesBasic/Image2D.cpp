@@ -11,6 +11,7 @@
 #include "Image2D.h"
 
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include "tinyexr.h"
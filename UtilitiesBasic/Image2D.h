@@ -23,6 +23,10 @@ public:
 	Vec3f& at( const int x, const int y );
 	const Vec3f& at( const int x, const int y ) const;
 
+	// Direct access to the row-major pixel storage (no clamping).
+	Vec3f* Data() { return data.data(); }
+	const Vec3f* Data() const { return data.data(); }
+
 	void Resize( const int width, const int height );
 
 	size_t Width() const { return width; }
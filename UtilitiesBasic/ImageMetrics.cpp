@@ -0,0 +1,341 @@
+/*
+* LightFieldDisplayModel - UtilitiesBasic - ImageMetrics
+*
+* Quality metrics (PSNR, SSIM, absolute errors) for 2D and 3D images.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ImageMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+#include "Image2D.h"
+#include "Image3D.h"
+
+
+const float default_peak_value = 1.0f;
+const float psnr_max = 100.0f; // Reported for identical images.
+
+// SSIM parameters from Wang et al., "Image quality assessment: from error visibility to structural similarity".
+const int ssim_window_radius = 5;
+const float ssim_window_sigma = 1.5f;
+const float ssim_k1 = 0.01f;
+const float ssim_k2 = 0.03f;
+
+
+
+// Separable Gaussian blur with clamped borders.
+static void GaussianBlur( std::vector<float>& plane, const int width, const int height, const std::vector<float>& kernel )
+{
+	const int radius = static_cast<int>( kernel.size() ) / 2;
+	std::vector<float> temp( plane.size() );
+#pragma omp parallel for
+	for ( int y = 0; y < height; ++y )
+	{
+		const float* input = &plane[ static_cast<size_t>(y)*width ];
+		float* output = &temp[ static_cast<size_t>(y)*width ];
+		for ( int x = 0; x < width; ++x )
+		{
+			float sum = 0.0f;
+			for ( int k = -radius; k <= radius; ++k )
+				sum += kernel[k+radius] * input[ std::min<int>( std::max<int>( x+k, 0 ), width-1 ) ];
+			output[x] = sum;
+		}
+	}
+#pragma omp parallel for
+	for ( int y = 0; y < height; ++y )
+	{
+		float* output = &plane[ static_cast<size_t>(y)*width ];
+		std::fill( output, output + width, 0.0f );
+		for ( int k = -radius; k <= radius; ++k )
+		{
+			const float* input = &temp[ static_cast<size_t>( std::min<int>( std::max<int>( y+k, 0 ), height-1 ) )*width ];
+			const float weight = kernel[k+radius];
+			for ( int x = 0; x < width; ++x )
+				output[x] += weight * input[x];
+		}
+	}
+}
+
+
+
+static nlohmann::json ResultToJson( const ImageMetricsResult& result )
+{
+	nlohmann::json json;
+	json["mse"] = result.mse;
+	json["psnr"] = result.psnr;
+	json["ssim"] = result.ssim;
+	json["max_abs_error"] = result.max_abs_error;
+	json["mean_abs_error"] = result.mean_abs_error;
+	return json;
+}
+
+
+
+ImageMetrics::ImageMetrics()
+	:peakValue( default_peak_value )
+{
+	ClearReport();
+}
+
+
+
+ImageMetrics::~ImageMetrics()
+{
+}
+
+
+
+void ImageMetrics::AddRegion( const ImageRegion& region )
+{
+	regions.push_back( region );
+}
+
+
+
+void ImageMetrics::RemoveAllRegions()
+{
+	regions.clear();
+}
+
+
+
+bool ImageMetrics::Compare( const Image2D& testImage, const Image2D& referenceImage, std::vector<ImageMetricsResult>& results, Image2D* errorMap ) const
+{
+	const int width = static_cast<int>( referenceImage.Width() );
+	const int height = static_cast<int>( referenceImage.Height() );
+	const int testWidth = static_cast<int>( testImage.Width() );
+	const int testHeight = static_cast<int>( testImage.Height() );
+	results.clear();
+	if ( width == 0 || height == 0 )
+		return false;
+	if ( testWidth != width || testHeight != height )
+		return false;
+
+	std::vector<float> ssimMap;
+	SsimMap( testImage, referenceImage, ssimMap );
+
+	// Whole image goes first, then the regions.
+	std::vector<ImageRegion> allRegions( 1 );
+	allRegions.insert( allRegions.end(), regions.begin(), regions.end() );
+
+	// Per-row partial sums keep reductions deterministic and independent of OpenMP version.
+	std::vector<double> rowSqrError( height ), rowAbsError( height ), rowSsim( height );
+	std::vector<float> rowMaxError( height );
+	const float* testData = &testImage.Data()[0][0];
+	const float* referenceData = &referenceImage.Data()[0][0];
+	for ( const ImageRegion& region : allRegions )
+	{
+		// Pixels, whose centers are inside the region.
+		const int x_min = std::max<int>( static_cast<int>( std::ceil( region.x_min*width - 0.5f ) ), 0 );
+		const int y_min = std::max<int>( static_cast<int>( std::ceil( region.y_min*height - 0.5f ) ), 0 );
+		const int x_max = std::min<int>( static_cast<int>( std::ceil( region.x_max*width - 0.5f ) ), width );
+		const int y_max = std::min<int>( static_cast<int>( std::ceil( region.y_max*height - 0.5f ) ), height );
+		ImageMetricsResult result;
+		if ( x_min < x_max && y_min < y_max )
+		{
+#pragma omp parallel for
+			for ( int y = y_min; y < y_max; ++y )
+			{
+				const float* test = testData + (static_cast<size_t>(y)*width + x_min)*3;
+				const float* reference = referenceData + (static_cast<size_t>(y)*width + x_min)*3;
+				const int count = (x_max - x_min)*3;
+				// Without fast math compilers keep the order of float sums; simd reductions let them use vector lanes.
+				float sqrError = 0.0f, absError = 0.0f, maxError = 0.0f;
+#pragma omp simd reduction( +:sqrError, absError ) reduction( max:maxError )
+				for ( int i = 0; i < count; ++i )
+				{
+					const float diff = std::abs( test[i] - reference[i] );
+					sqrError += diff*diff;
+					absError += diff;
+					maxError = std::max<float>( maxError, diff );
+				}
+				float ssim = 0.0f;
+				const float* ssimRow = &ssimMap[ static_cast<size_t>(y)*width ];
+#pragma omp simd reduction( +:ssim )
+				for ( int x = x_min; x < x_max; ++x )
+					ssim += ssimRow[x];
+				rowSqrError[y] = sqrError;
+				rowAbsError[y] = absError;
+				rowMaxError[y] = maxError;
+				rowSsim[y] = ssim;
+			}
+			double sqrError = 0.0, absError = 0.0, ssim = 0.0;
+			float maxError = 0.0f;
+			for ( int y = y_min; y < y_max; ++y )
+			{
+				sqrError += rowSqrError[y];
+				absError += rowAbsError[y];
+				ssim += rowSsim[y];
+				maxError = std::max<float>( maxError, rowMaxError[y] );
+			}
+			const double numPixels = static_cast<double>( x_max - x_min ) * (y_max - y_min);
+			const double mse = sqrError / (numPixels*3.0);
+			result.mse = static_cast<float>( mse );
+			result.psnr = mse > 0.0 ? std::min<float>( static_cast<float>( 10.0*std::log10( peakValue*peakValue / mse ) ), psnr_max ) : psnr_max;
+			result.ssim = static_cast<float>( ssim / numPixels );
+			result.max_abs_error = maxError;
+			result.mean_abs_error = static_cast<float>( absError / (numPixels*3.0) );
+		}
+		results.push_back( result );
+	}
+
+	if ( errorMap != nullptr )
+	{
+		errorMap->Resize( width, height );
+		float* errorData = &errorMap->Data()[0][0];
+		const int count = width*height*3;
+#pragma omp parallel for
+		for ( int i = 0; i < count; ++i )
+			errorData[i] = std::abs( testData[i] - referenceData[i] );
+	}
+	return true;
+}
+
+
+
+bool ImageMetrics::Compare( const std::string& name, const Image3D& testImage, const Image3D& referenceImage, Image3D* errorMaps )
+{
+	const int depth = static_cast<int>( referenceImage.Depth() );
+	const int testDepth = static_cast<int>( testImage.Depth() );
+	if ( depth == 0 || testDepth != depth )
+		return false;
+	if ( errorMaps != nullptr )
+		errorMaps->Resize( static_cast<int>( referenceImage.Width() ), static_cast<int>( referenceImage.Height() ), depth );
+
+	nlohmann::json comparison;
+	comparison["name"] = name;
+	comparison["peak_value"] = peakValue;
+	comparison["views"] = nlohmann::json::array();
+
+	bool success = true;
+	std::vector<ImageMetricsResult> results;
+	std::vector<ImageMetricsResult> totals;
+	for ( int viewId = 0; viewId < depth && success; ++viewId )
+	{
+		Image2D* errorMap = errorMaps != nullptr ? &errorMaps->Layer( viewId ) : nullptr;
+		success = Compare( testImage.Layer(viewId), referenceImage.Layer(viewId), results, errorMap );
+		if ( !success )
+			break;
+
+		nlohmann::json view = ResultToJson( results[0] );
+		view["view"] = viewId;
+		for ( size_t regionId = 0; regionId < regions.size(); ++regionId )
+			view["regions"][ regions[regionId].name ] = ResultToJson( results[regionId+1] );
+		comparison["views"].push_back( view );
+
+		// Totals over all views: PSNR of the mean MSE, maximum of maximal errors, mean of the other metrics.
+		totals.resize( results.size() );
+		for ( size_t i = 0; i < results.size(); ++i )
+		{
+			totals[i].mse += results[i].mse / depth;
+			totals[i].ssim += results[i].ssim / depth;
+			totals[i].max_abs_error = std::max<float>( totals[i].max_abs_error, results[i].max_abs_error );
+			totals[i].mean_abs_error += results[i].mean_abs_error / depth;
+		}
+	}
+	if ( !success )
+		return false;
+
+	for ( ImageMetricsResult& total : totals )
+		total.psnr = total.mse > 0.0f ? std::min<float>( 10.0f*std::log10( peakValue*peakValue / total.mse ), psnr_max ) : psnr_max;
+	comparison["total"] = ResultToJson( totals[0] );
+	for ( size_t regionId = 0; regionId < regions.size(); ++regionId )
+		comparison["total"]["regions"][ regions[regionId].name ] = ResultToJson( totals[regionId+1] );
+
+	report["comparisons"].push_back( comparison );
+	return true;
+}
+
+
+
+void ImageMetrics::ClearReport()
+{
+	report = nlohmann::json();
+	report["comparisons"] = nlohmann::json::array();
+}
+
+
+
+bool ImageMetrics::SaveReport( const std::string& file_path ) const
+{
+	std::fstream filestream;
+	bool success = true;
+
+	try
+	{
+		filestream.open( file_path, std::ofstream::out );
+		filestream << std::setw( 4 ) << report << std::endl;
+		success = !filestream.fail();
+	}
+	catch ( ... )
+	{
+		success = false;
+	}
+
+	filestream.close();
+
+	return success;
+}
+
+
+
+void ImageMetrics::SsimMap( const Image2D& testImage, const Image2D& referenceImage, std::vector<float>& ssimMap ) const
+{
+	const int width = static_cast<int>( referenceImage.Width() );
+	const int height = static_cast<int>( referenceImage.Height() );
+	const size_t numPixels = static_cast<size_t>( width ) * height;
+
+	std::vector<float> kernel( 2*ssim_window_radius + 1 );
+	float kernelSum = 0.0f;
+	for ( int k = -ssim_window_radius; k <= ssim_window_radius; ++k )
+	{
+		kernel[k+ssim_window_radius] = std::exp( -static_cast<float>(k*k) / (2.0f*ssim_window_sigma*ssim_window_sigma) );
+		kernelSum += kernel[k+ssim_window_radius];
+	}
+	for ( float& weight : kernel )
+		weight /= kernelSum;
+
+	// Local means and (co)variances of luminance.
+	std::vector<float> muTest( numPixels ), muReference( numPixels );
+	std::vector<float> sqrTest( numPixels ), sqrReference( numPixels ), crossTestReference( numPixels );
+	const Vec3f* testData = testImage.Data();
+	const Vec3f* referenceData = referenceImage.Data();
+	const int count = static_cast<int>( numPixels );
+#pragma omp parallel for
+	for ( int i = 0; i < count; ++i )
+	{
+		const float test = 0.2126f*testData[i].x + 0.7152f*testData[i].y + 0.0722f*testData[i].z;
+		const float reference = 0.2126f*referenceData[i].x + 0.7152f*referenceData[i].y + 0.0722f*referenceData[i].z;
+		muTest[i] = test;
+		muReference[i] = reference;
+		sqrTest[i] = test*test;
+		sqrReference[i] = reference*reference;
+		crossTestReference[i] = test*reference;
+	}
+	GaussianBlur( muTest, width, height, kernel );
+	GaussianBlur( muReference, width, height, kernel );
+	GaussianBlur( sqrTest, width, height, kernel );
+	GaussianBlur( sqrReference, width, height, kernel );
+	GaussianBlur( crossTestReference, width, height, kernel );
+
+	const float c1 = (ssim_k1*peakValue)*(ssim_k1*peakValue);
+	const float c2 = (ssim_k2*peakValue)*(ssim_k2*peakValue);
+	ssimMap.resize( numPixels );
+#pragma omp parallel for
+	for ( int i = 0; i < count; ++i )
+	{
+		const float muT = muTest[i];
+		const float muR = muReference[i];
+		const float sigmaT = sqrTest[i] - muT*muT;
+		const float sigmaR = sqrReference[i] - muR*muR;
+		const float sigmaTR = crossTestReference[i] - muT*muR;
+		ssimMap[i] = ( (2.0f*muT*muR + c1)*(2.0f*sigmaTR + c2) ) / ( (muT*muT + muR*muR + c1)*(sigmaT + sigmaR + c2) );
+	}
+}
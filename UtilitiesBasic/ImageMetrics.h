@@ -0,0 +1,74 @@
+/*
+* LightFieldDisplayModel - UtilitiesBasic - ImageMetrics
+*
+* Quality metrics (PSNR, SSIM, absolute errors) for 2D and 3D images.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef UTILITIESBASIC_IMAGEMETRICS_H
+#define UTILITIESBASIC_IMAGEMETRICS_H
+
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+class Image2D;
+class Image3D;
+
+
+// Rectangular region of the image, [x_min, x_max) x [y_min, y_max) in fractions of the image width and height,
+// so the same region applies to images of any resolution (e.g., of both display models).
+struct ImageRegion
+{
+	std::string name;
+	float x_min = 0.0f;
+	float y_min = 0.0f;
+	float x_max = 1.0f;
+	float y_max = 1.0f;
+};
+
+struct ImageMetricsResult
+{
+	float mse = 0.0f;
+	float psnr = 0.0f; // In dB, capped for identical images.
+	float ssim = 0.0f; // Mean SSIM of luminance.
+	float max_abs_error = 0.0f;
+	float mean_abs_error = 0.0f;
+};
+
+
+// Compares test images with reference ones and collects results into JSON report.
+// Metrics are evaluated for the whole image and for every added region.
+
+class ImageMetrics
+{
+public:
+	ImageMetrics();
+	~ImageMetrics();
+
+	void SetPeakValue( const float peakValue ) { this->peakValue = peakValue; }
+
+	void AddRegion( const ImageRegion& region );
+	void RemoveAllRegions();
+
+	bool Compare( const Image2D& testImage, const Image2D& referenceImage, std::vector<ImageMetricsResult>& results, Image2D* errorMap = nullptr ) const;
+	bool Compare( const std::string& name, const Image3D& testImage, const Image3D& referenceImage, Image3D* errorMaps = nullptr );
+
+	void ClearReport();
+	const nlohmann::json& Report() const { return report; }
+	bool SaveReport( const std::string& file_path ) const;
+
+private:
+	void SsimMap( const Image2D& testImage, const Image2D& referenceImage, std::vector<float>& ssimMap ) const;
+
+private:
+	float peakValue;
+	std::vector<ImageRegion> regions;
+	nlohmann::json report;
+};
+
+#endif // UTILITIESBASIC_IMAGEMETRICS_H
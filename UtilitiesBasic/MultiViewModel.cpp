@@ -31,6 +31,8 @@ void MultiViewModel::Clear()
 {
 	name = std::string();
 	num_cameras = 0;
+	num_cameras_x = 0;
+	num_cameras_y = 0;
 
 	image_size_x = 0;
 	image_size_y = 0;
@@ -56,6 +58,8 @@ bool MultiViewModel::Serialize( const std::string& file_path )
 	{
 		json["name"] = name;
 		json["num_cameras"] = num_cameras;
+		json["num_cameras_x"] = NumCamerasX();
+		json["num_cameras_y"] = NumCamerasY();
 
 		json["image_size_x"] = image_size_x;
 		json["image_size_y"] = image_size_y;
@@ -100,6 +104,12 @@ bool MultiViewModel::Deserialize( const std::string& file_path )
 
 		name = json["name"].get<std::string>();
 		num_cameras = json["num_cameras"].get<int>();
+		// Grid size is optional, older models describe a single row.
+		num_cameras_x = json.value( "num_cameras_x", num_cameras );
+		num_cameras_y = json.value( "num_cameras_y", 1 );
+		// Grid has to hold exactly all cameras, so that consumers can index camera images by it.
+		if ( num_cameras_x <= 0 || num_cameras_y <= 0 || static_cast<long long>( num_cameras_x )*num_cameras_y != num_cameras )
+			success = false;
 
 		image_size_x = json["image_size_x"].get<int>();
 		image_size_y = json["image_size_y"].get<int>();
@@ -15,13 +15,17 @@
 #include <vector>
 
 // Assumptions:
-//  * cameras are sorted by x-coordinate (increasing);
+//  * cameras form a rectilinear grid of num_cameras_x by num_cameras_y, stored row by row
+//    (i.e., camera id is x_id + y_id*num_cameras_x), single row by default;
+//  * cameras are sorted by x-coordinate (increasing) in each row, and by y-coordinate (increasing) in each column;
 //  * all cameras are in front of screen (i.e., z>0).
 
 struct MultiViewModel
 {
 	std::string name;
 	int num_cameras = 0;
+	int num_cameras_x = 0; // Grid size; zero means single row of num_cameras cameras.
+	int num_cameras_y = 0;
 
 	int image_size_x = 0; // In pixels.
 	int image_size_y = 0; // In pixels.
@@ -33,6 +37,9 @@ struct MultiViewModel
 	std::vector<float> cameras_pos_y; // In millimeters.
 	std::vector<float> cameras_pos_z; // In millimeters.
 
+	int NumCamerasX() const { return num_cameras_x > 0 ? num_cameras_x : num_cameras; }
+	int NumCamerasY() const { return num_cameras_y > 0 ? num_cameras_y : 1; }
+
 	void Clear();
 	bool Serialize( const std::string& file_path );
 	bool Deserialize( const std::string& file_path );
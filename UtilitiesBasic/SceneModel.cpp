@@ -0,0 +1,345 @@
+/*
+* LightFieldDisplayModel - UtilitiesBasic - SceneModel
+*
+* Descriptor for the rendered scene: materials, primitives, lights and meshes.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "SceneModel.h"
+#include "json.hpp"
+
+#include <fstream>
+#include <iomanip>
+
+
+static nlohmann::json vec3_to_json( const Vec3f& v )
+{
+	return nlohmann::json::array( { v.x, v.y, v.z } );
+}
+
+static Vec3f json_to_vec3( const nlohmann::json& input )
+{
+	return Vec3f( input.at( 0 ).get<float>(), input.at( 1 ).get<float>(), input.at( 2 ).get<float>() );
+}
+
+static nlohmann::json vec2_to_json( const Vec2f& v )
+{
+	return nlohmann::json::array( { v.x, v.y } );
+}
+
+static Vec2f json_to_vec2( const nlohmann::json& input )
+{
+	return Vec2f( input.at( 0 ).get<float>(), input.at( 1 ).get<float>() );
+}
+
+// Keyframes are written only for animated objects, so files of static scenes do not change.
+static void keyframes_to_json( const std::vector<SceneKeyframe>& keyframes, nlohmann::json& item )
+{
+	for ( const SceneKeyframe& keyframe : keyframes )
+	{
+		nlohmann::json keyframeItem;
+		keyframeItem["frame"] = keyframe.frame;
+		keyframeItem["offset"] = vec3_to_json( keyframe.offset );
+		item["keyframes"].push_back( keyframeItem );
+	}
+}
+
+// Returns false if frames are not increasing.
+static bool json_to_keyframes( const nlohmann::json& item, std::vector<SceneKeyframe>& keyframes )
+{
+	keyframes.clear();
+	if ( item.count( "keyframes" ) == 0 )
+		return true;
+	bool increasing = true;
+	for ( const nlohmann::json& keyframeItem : item["keyframes"] )
+	{
+		SceneKeyframe keyframe;
+		keyframe.frame = keyframeItem["frame"].get<int>();
+		keyframe.offset = json_to_vec3( keyframeItem["offset"] );
+		increasing = increasing && (keyframes.empty() || keyframe.frame > keyframes.back().frame);
+		keyframes.push_back( keyframe );
+	}
+	return increasing;
+}
+
+
+
+int SceneModel::FindMaterial( const std::string& material_name ) const
+{
+	for ( size_t i = 0; i < materials.size(); ++i )
+	{
+		if ( materials[i].name == material_name )
+			return static_cast<int>( i );
+	}
+	return -1;
+}
+
+
+
+void SceneModel::Clear()
+{
+	name = std::string();
+	materials.clear();
+	spheres.clear();
+	quads.clear();
+	boxes.clear();
+	lights.clear();
+	meshes.clear();
+}
+
+
+
+bool SceneModel::Serialize( const std::string& file_path )
+{
+	std::fstream filestream;
+	nlohmann::json json;
+
+	bool success = true;
+
+	try
+	{
+		json["name"] = name;
+
+		json["materials"] = nlohmann::json::array();
+		for ( const SceneMaterial& material : materials )
+		{
+			nlohmann::json item;
+			item["name"] = material.name;
+			item["refractive_index"] = material.refractive_index;
+			item["albedo"] = nlohmann::json::array( { material.albedo.x, material.albedo.y, material.albedo.z, material.albedo.w } );
+			item["diffuse_color"] = vec3_to_json( material.diffuse_color );
+			item["specular_exponent"] = material.specular_exponent;
+			json["materials"].push_back( item );
+		}
+
+		json["spheres"] = nlohmann::json::array();
+		for ( const SceneSphere& sphere : spheres )
+		{
+			nlohmann::json item;
+			item["center"] = vec3_to_json( sphere.center );
+			item["radius"] = sphere.radius;
+			item["material"] = materials.at( sphere.material_id ).name;
+			keyframes_to_json( sphere.keyframes, item );
+			json["spheres"].push_back( item );
+		}
+
+		json["quads"] = nlohmann::json::array();
+		for ( const SceneQuad& quad : quads )
+		{
+			nlohmann::json item;
+			item["center"] = vec3_to_json( quad.center );
+			item["axis_u"] = vec3_to_json( quad.axis_u );
+			item["axis_v"] = vec3_to_json( quad.axis_v );
+			item["half_size"] = vec2_to_json( quad.half_size );
+			item["material"] = materials.at( quad.material_id ).name;
+			if ( quad.checker_material_id >= 0 )
+			{
+				item["checker"]["material"] = materials.at( quad.checker_material_id ).name;
+				item["checker"]["cell_size"] = quad.checker_cell_size;
+				item["checker"]["offset"] = vec2_to_json( quad.checker_offset );
+			}
+			keyframes_to_json( quad.keyframes, item );
+			json["quads"].push_back( item );
+		}
+
+		json["boxes"] = nlohmann::json::array();
+		for ( const SceneBox& box : boxes )
+		{
+			nlohmann::json item;
+			item["min_corner"] = vec3_to_json( box.min_corner );
+			item["max_corner"] = vec3_to_json( box.max_corner );
+			item["material"] = materials.at( box.material_id ).name;
+			keyframes_to_json( box.keyframes, item );
+			json["boxes"].push_back( item );
+		}
+
+		json["lights"] = nlohmann::json::array();
+		for ( const SceneLight& light : lights )
+		{
+			nlohmann::json item;
+			item["position"] = vec3_to_json( light.position );
+			item["intensity"] = light.intensity;
+			if ( light.radius > 0.0f )
+				item["radius"] = light.radius;
+			keyframes_to_json( light.keyframes, item );
+			json["lights"].push_back( item );
+		}
+
+		json["meshes"] = nlohmann::json::array();
+		for ( const SceneMesh& mesh : meshes )
+		{
+			nlohmann::json item;
+			item["file_path"] = mesh.file_path;
+			item["material"] = materials.at( mesh.material_id ).name;
+			for ( const SceneInstance& instance : mesh.instances )
+			{
+				nlohmann::json instanceItem;
+				instanceItem["position"] = vec3_to_json( instance.position );
+				instanceItem["axis_x"] = vec3_to_json( instance.axis_x );
+				instanceItem["axis_y"] = vec3_to_json( instance.axis_y );
+				instanceItem["axis_z"] = vec3_to_json( instance.axis_z );
+				if ( instance.material_id >= 0 )
+					instanceItem["material"] = materials.at( instance.material_id ).name;
+				keyframes_to_json( instance.keyframes, instanceItem );
+				item["instances"].push_back( instanceItem );
+			}
+			json["meshes"].push_back( item );
+		}
+
+		filestream.open( file_path, std::ofstream::out );
+		filestream << std::setw( 4 ) << json << std::endl;
+		filestream.close();
+	}
+	catch ( ... )
+	{
+		success = false;
+	}
+
+	filestream.close();
+
+	return success;
+}
+
+
+
+bool SceneModel::Deserialize( const std::string& file_path )
+{
+	std::fstream filestream;
+	nlohmann::json json;
+
+	bool success = true;
+
+	try
+	{
+		filestream.open( file_path, std::ofstream::in );
+		filestream >> json;
+		filestream.close();
+
+		Clear();
+
+		name = json.value( "name", std::string() );
+
+		for ( const nlohmann::json& item : json["materials"] )
+		{
+			SceneMaterial material;
+			material.name = item["name"].get<std::string>();
+			material.refractive_index = item.value( "refractive_index", 1.0f );
+			const nlohmann::json& albedo = item["albedo"];
+			material.albedo = Vec4f( albedo.at( 0 ).get<float>(), albedo.at( 1 ).get<float>(), albedo.at( 2 ).get<float>(), albedo.at( 3 ).get<float>() );
+			material.diffuse_color = json_to_vec3( item["diffuse_color"] );
+			material.specular_exponent = item.value( "specular_exponent", 0.0f );
+			success = success && FindMaterial( material.name ) < 0;
+			materials.push_back( material );
+		}
+
+		// Sections of primitives, lights and meshes are optional.
+		if ( json.count( "spheres" ) > 0 )
+		{
+			for ( const nlohmann::json& item : json["spheres"] )
+			{
+				SceneSphere sphere;
+				sphere.center = json_to_vec3( item["center"] );
+				sphere.radius = item["radius"].get<float>();
+				sphere.material_id = FindMaterial( item["material"].get<std::string>() );
+				success = success && sphere.material_id >= 0 && sphere.radius > 0.0f && json_to_keyframes( item, sphere.keyframes );
+				spheres.push_back( sphere );
+			}
+		}
+
+		if ( json.count( "quads" ) > 0 )
+		{
+			for ( const nlohmann::json& item : json["quads"] )
+			{
+				SceneQuad quad;
+				quad.center = json_to_vec3( item["center"] );
+				quad.axis_u = json_to_vec3( item["axis_u"] );
+				quad.axis_v = json_to_vec3( item["axis_v"] );
+				quad.half_size = json_to_vec2( item["half_size"] );
+				quad.material_id = FindMaterial( item["material"].get<std::string>() );
+				success = success && quad.material_id >= 0 && quad.half_size.x > 0.0f && quad.half_size.y > 0.0f;
+				if ( item.count( "checker" ) > 0 )
+				{
+					const nlohmann::json& checker = item["checker"];
+					quad.checker_material_id = FindMaterial( checker["material"].get<std::string>() );
+					quad.checker_cell_size = checker["cell_size"].get<float>();
+					quad.checker_offset = checker.count( "offset" ) > 0 ? json_to_vec2( checker["offset"] ) : Vec2f( 0.0f, 0.0f );
+					success = success && quad.checker_material_id >= 0 && quad.checker_cell_size > 0.0f;
+				}
+				success = success && json_to_keyframes( item, quad.keyframes );
+				quads.push_back( quad );
+			}
+		}
+
+		if ( json.count( "boxes" ) > 0 )
+		{
+			for ( const nlohmann::json& item : json["boxes"] )
+			{
+				SceneBox box;
+				box.min_corner = json_to_vec3( item["min_corner"] );
+				box.max_corner = json_to_vec3( item["max_corner"] );
+				box.material_id = FindMaterial( item["material"].get<std::string>() );
+				success = success && box.material_id >= 0 && json_to_keyframes( item, box.keyframes );
+				boxes.push_back( box );
+			}
+		}
+
+		if ( json.count( "lights" ) > 0 )
+		{
+			for ( const nlohmann::json& item : json["lights"] )
+			{
+				SceneLight light;
+				light.position = json_to_vec3( item["position"] );
+				light.intensity = item["intensity"].get<float>();
+				light.radius = item.value( "radius", 0.0f );
+				success = success && light.radius >= 0.0f && json_to_keyframes( item, light.keyframes );
+				lights.push_back( light );
+			}
+		}
+
+		if ( json.count( "meshes" ) > 0 )
+		{
+			for ( const nlohmann::json& item : json["meshes"] )
+			{
+				SceneMesh mesh;
+				mesh.file_path = item["file_path"].get<std::string>();
+				mesh.material_id = FindMaterial( item["material"].get<std::string>() );
+				success = success && mesh.material_id >= 0;
+				if ( item.count( "instances" ) > 0 )
+				{
+					// Omitted axes and position are those of the identity placement.
+					for ( const nlohmann::json& instanceItem : item["instances"] )
+					{
+						SceneInstance instance;
+						if ( instanceItem.count( "position" ) > 0 )
+							instance.position = json_to_vec3( instanceItem["position"] );
+						if ( instanceItem.count( "axis_x" ) > 0 )
+							instance.axis_x = json_to_vec3( instanceItem["axis_x"] );
+						if ( instanceItem.count( "axis_y" ) > 0 )
+							instance.axis_y = json_to_vec3( instanceItem["axis_y"] );
+						if ( instanceItem.count( "axis_z" ) > 0 )
+							instance.axis_z = json_to_vec3( instanceItem["axis_z"] );
+						if ( instanceItem.count( "material" ) > 0 )
+						{
+							instance.material_id = FindMaterial( instanceItem["material"].get<std::string>() );
+							success = success && instance.material_id >= 0;
+						}
+						success = success && json_to_keyframes( instanceItem, instance.keyframes );
+						mesh.instances.push_back( instance );
+					}
+				}
+				meshes.push_back( mesh );
+			}
+		}
+	}
+	catch ( ... )
+	{
+		success = false;
+	}
+
+	filestream.close();
+
+	return success;
+}
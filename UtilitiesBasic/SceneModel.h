@@ -0,0 +1,117 @@
+/*
+* LightFieldDisplayModel - UtilitiesBasic - SceneModel
+*
+* Descriptor for the rendered scene: materials, primitives, lights and meshes.
+*
+* Copyright (C) 2019 by Oleksii Doronin
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#ifndef UTILITIESBASIC_SCENEMODEL_H
+#define UTILITIESBASIC_SCENEMODEL_H
+
+#include <string>
+#include <vector>
+
+#include "geometry.h"
+
+// Assumptions:
+//  * materials have unique names, primitives, meshes and instances refer to materials by name in the file;
+//  * mesh file paths (OBJ or PLY) are relative to the folder of the scene file, unless they are absolute;
+//  * coordinates are in millimeters, in the same space as the display models;
+//  * keyframes of an object are in increasing order of frames.
+
+// Animation: the object is moved by the offset from its place at the frame. Between keyframes offsets are interpolated linearly,
+// before the first and after the last keyframe they are those of the first and the last keyframe.
+struct SceneKeyframe
+{
+	int frame = 0;
+	Vec3f offset = Vec3f( 0.0f, 0.0f, 0.0f );
+};
+
+struct SceneMaterial
+{
+	std::string name;
+	float refractive_index = 1.0f;
+	Vec4f albedo = Vec4f( 1.0f, 0.0f, 0.0f, 0.0f ); // Weights of diffuse, specular, reflected and refracted light.
+	Vec3f diffuse_color = Vec3f( 0.0f, 0.0f, 0.0f );
+	float specular_exponent = 0.0f;
+};
+
+struct SceneSphere
+{
+	Vec3f center = Vec3f( 0.0f, 0.0f, 0.0f );
+	float radius = 0.0f;
+	int material_id = 0;
+	std::vector<SceneKeyframe> keyframes; // No keyframes mean a static object.
+};
+
+// Rectangle with half sizes along two orthogonal unit axes; optionally a checkerboard of its material and the checker material,
+// see Quad in the ray tracer for the layout of cells.
+struct SceneQuad
+{
+	Vec3f center = Vec3f( 0.0f, 0.0f, 0.0f );
+	Vec3f axis_u = Vec3f( 1.0f, 0.0f, 0.0f );
+	Vec3f axis_v = Vec3f( 0.0f, 0.0f, 1.0f );
+	Vec2f half_size = Vec2f( 0.0f, 0.0f );
+	int material_id = 0;
+	int checker_material_id = -1; // -1 means no checkerboard.
+	float checker_cell_size = 1.0f;
+	Vec2f checker_offset = Vec2f( 0.0f, 0.0f ); // In cells.
+	std::vector<SceneKeyframe> keyframes;
+};
+
+struct SceneBox
+{
+	Vec3f min_corner = Vec3f( 0.0f, 0.0f, 0.0f );
+	Vec3f max_corner = Vec3f( 0.0f, 0.0f, 0.0f );
+	int material_id = 0;
+	std::vector<SceneKeyframe> keyframes;
+};
+
+struct SceneLight
+{
+	Vec3f position = Vec3f( 0.0f, 0.0f, 0.0f );
+	float intensity = 0.0f;
+	float radius = 0.0f; // Radius of influence, 0 means unlimited.
+	std::vector<SceneKeyframe> keyframes;
+};
+
+// Placement of a mesh: point p of the mesh file is at position + axis_x*p.x + axis_y*p.y + axis_z*p.z.
+struct SceneInstance
+{
+	Vec3f position = Vec3f( 0.0f, 0.0f, 0.0f );
+	Vec3f axis_x = Vec3f( 1.0f, 0.0f, 0.0f );
+	Vec3f axis_y = Vec3f( 0.0f, 1.0f, 0.0f );
+	Vec3f axis_z = Vec3f( 0.0f, 0.0f, 1.0f );
+	int material_id = -1; // -1 means the material of the mesh.
+	std::vector<SceneKeyframe> keyframes;
+};
+
+// Mesh is loaded once and shared by all its instances; without instances, it is placed as is.
+struct SceneMesh
+{
+	std::string file_path;
+	int material_id = 0;
+	std::vector<SceneInstance> instances;
+};
+
+struct SceneModel
+{
+	std::string name;
+	std::vector<SceneMaterial> materials;
+	std::vector<SceneSphere> spheres;
+	std::vector<SceneQuad> quads;
+	std::vector<SceneBox> boxes;
+	std::vector<SceneLight> lights;
+	std::vector<SceneMesh> meshes;
+
+	int FindMaterial( const std::string& material_name ) const; // Returns -1 if there is no such material.
+
+	void Clear();
+	bool Serialize( const std::string& file_path );
+	bool Deserialize( const std::string& file_path );
+};
+
+#endif // UTILITIESBASIC_SCENEMODEL_H